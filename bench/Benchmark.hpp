@@ -0,0 +1,362 @@
+#ifndef CPP_UTILITIES_BENCH_BENCHMARK_HPP
+#define CPP_UTILITIES_BENCH_BENCHMARK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define CPP_UTILITIES_BENCH_HAS_PTHREAD 1
+#endif
+
+/**
+ * \file Benchmark.hpp
+ * \brief Small harness shared by the benchmark targets under `bench/`.
+ * \details
+ *   Provides command-line options, latency statistics, a multi-threaded
+ *   runner starting all threads at once, lock adapters for the locks compared
+ *   and a minimal JSON writer, so that every target reports in the same shape.
+ *
+ *   Common options:
+ *     - `--threads 1,8,16,50`  Thread counts of the contended runs.
+ *     - `--reads 90,100`       Percentages of read operations.
+ *     - `--ops N`              Operations per thread of a contended run.
+ *     - `--samples N`          Batches measured for single-thread latency.
+ *     - `--json FILE`          Also write results as JSON, `-` for stdout.
+ */
+
+namespace Bench {
+/** \brief Command-line options common to all benchmarks. */
+struct Options
+{
+    std::vector<unsigned> threads{1, 8, 16, 50};
+    std::vector<unsigned> reads{90, 100};
+    std::uint64_t ops = 100 * 1000;
+    std::uint64_t samples = 200;
+    std::string json;
+
+    static std::vector<unsigned> parse_list(const char* s)
+    {
+        std::vector<unsigned> result;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) {
+                result.push_back(static_cast<unsigned>(std::strtoul(item.c_str(), nullptr, 10)));
+            }
+        }
+        return result;
+    }
+
+    static Options parse(int argc, char** argv)
+    { return parse(argc, argv, Options()); }
+
+    static Options parse(int argc, char** argv, Options options)
+    {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            const char* key = argv[i];
+            const char* value = argv[i + 1];
+            if (std::strcmp(key, "--threads") == 0) {
+                options.threads = parse_list(value);
+            } else if (std::strcmp(key, "--reads") == 0) {
+                options.reads = parse_list(value);
+            } else if (std::strcmp(key, "--ops") == 0) {
+                options.ops = std::strtoull(value, nullptr, 10);
+            } else if (std::strcmp(key, "--samples") == 0) {
+                options.samples = std::strtoull(value, nullptr, 10);
+            } else if (std::strcmp(key, "--json") == 0) {
+                options.json = value;
+            } else {
+                std::cerr << "unknown option " << key << std::endl;
+                std::exit(1);
+            }
+        }
+        return options;
+    }
+};
+
+/** \brief Monotonic timestamp in nanoseconds. */
+inline std::uint64_t now()
+{
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/** \brief Prevents the compiler from optimizing `value` away. */
+template<typename T>
+inline void keep(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/** \brief Cheap per-thread pseudo random numbers. */
+struct XorShift
+{
+    explicit XorShift(std::uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    std::uint64_t operator()()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    std::uint64_t state;
+};
+
+/** \brief min / avg / max / sigma of a set of samples. */
+struct Stats
+{
+    double min = 0;
+    double avg = 0;
+    double max = 0;
+    double sigma = 0;
+    std::size_t count = 0;
+
+    static Stats of(const std::vector<double>& samples)
+    {
+        Stats s;
+        s.count = samples.size();
+        if (samples.empty()) {
+            return s;
+        }
+        s.min = *std::min_element(samples.begin(), samples.end());
+        s.max = *std::max_element(samples.begin(), samples.end());
+        double sum = 0;
+        for (double v : samples) {
+            sum += v;
+        }
+        s.avg = sum / samples.size();
+        double squares = 0;
+        for (double v : samples) {
+            squares += (v - s.avg) * (v - s.avg);
+        }
+        s.sigma = std::sqrt(squares / samples.size());
+        return s;
+    }
+};
+
+/**
+ * \brief Runs `fn(index)` on `n` threads released at the same instant.
+ * \return Wall time in nanoseconds from release until all threads finished.
+ */
+template<typename F>
+inline std::uint64_t run_threads(unsigned n, F fn)
+{
+    std::atomic<unsigned> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back([&, i] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            fn(i);
+        });
+    }
+    while (ready.load() != n) {
+        std::this_thread::yield();
+    }
+    const std::uint64_t start = now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return now() - start;
+}
+
+/**
+ * \brief Measures single-thread latency of `op`.
+ * \return Nanoseconds per call of each of `samples` batches of `batch` calls.
+ */
+template<typename F>
+inline Stats measure(std::uint64_t samples, std::uint64_t batch, F op)
+{
+    for (std::uint64_t i = 0; i < batch; ++i) {
+        op();
+    }
+    std::vector<double> values;
+    values.reserve(samples);
+    for (std::uint64_t s = 0; s < samples; ++s) {
+        const std::uint64_t start = now();
+        for (std::uint64_t i = 0; i < batch; ++i) {
+            op();
+        }
+        values.push_back(double(now() - start) / batch);
+    }
+    return Stats::of(values);
+}
+
+/** \brief `std::mutex` used as a read-write lock, readers exclude each other. */
+class ExclusiveMutex
+{
+public:
+    void lock() { mutex.lock(); }
+    void unlock() { mutex.unlock(); }
+    bool try_lock() { return mutex.try_lock(); }
+    void lock_shared() { mutex.lock(); }
+    void unlock_shared() { mutex.unlock(); }
+    bool try_lock_shared() { return mutex.try_lock(); }
+
+private:
+    std::mutex mutex;
+};
+
+#ifdef CPP_UTILITIES_BENCH_HAS_PTHREAD
+/** \brief `pthread_rwlock_t` with the SharedMutex interface. */
+class PthreadRWLock
+{
+public:
+    PthreadRWLock() { pthread_rwlock_init(&rwlock, nullptr); }
+    ~PthreadRWLock() { pthread_rwlock_destroy(&rwlock); }
+    PthreadRWLock(const PthreadRWLock&) = delete;
+    PthreadRWLock& operator=(const PthreadRWLock&) = delete;
+
+    void lock() { pthread_rwlock_wrlock(&rwlock); }
+    void unlock() { pthread_rwlock_unlock(&rwlock); }
+    bool try_lock() { return pthread_rwlock_trywrlock(&rwlock) == 0; }
+    void lock_shared() { pthread_rwlock_rdlock(&rwlock); }
+    void unlock_shared() { pthread_rwlock_unlock(&rwlock); }
+    bool try_lock_shared() { return pthread_rwlock_tryrdlock(&rwlock) == 0; }
+
+private:
+    pthread_rwlock_t rwlock;
+};
+#endif
+
+/**
+ * \brief Minimal streaming JSON writer.
+ * \details
+ *   Commas are inserted automatically, keys are written by key().
+ */
+class Json
+{
+public:
+    explicit Json(std::ostream& os) : os(os) { os << std::setprecision(6); }
+
+    Json& begin_object() { value_prefix(); os << '{'; first.push_back(true); return *this; }
+    Json& end_object() { first.pop_back(); os << '}'; return *this; }
+    Json& begin_array() { value_prefix(); os << '['; first.push_back(true); return *this; }
+    Json& end_array() { first.pop_back(); os << ']'; return *this; }
+
+    Json& key(const std::string& k)
+    {
+        separator();
+        string(k);
+        os << ':';
+        pendingKey = true;
+        return *this;
+    }
+
+    Json& value(const std::string& v) { value_prefix(); string(v); return *this; }
+    Json& value(const char* v) { return value(std::string(v)); }
+    Json& value(double v) { value_prefix(); os << (std::isfinite(v) ? v : 0.0); return *this; }
+    Json& value(std::uint64_t v) { value_prefix(); os << v; return *this; }
+    Json& value(unsigned v) { value_prefix(); os << v; return *this; }
+
+    Json& stats(const std::string& k, const Stats& s)
+    {
+        key(k).begin_object();
+        key("min").value(s.min);
+        key("avg").value(s.avg);
+        key("max").value(s.max);
+        key("sigma").value(s.sigma);
+        key("count").value(static_cast<std::uint64_t>(s.count));
+        return end_object();
+    }
+
+private:
+    void separator()
+    {
+        if (!first.empty()) {
+            if (!first.back()) {
+                os << ',';
+            }
+            first.back() = false;
+        }
+    }
+
+    void value_prefix()
+    {
+        if (pendingKey) {
+            pendingKey = false;
+        } else {
+            separator();
+        }
+    }
+
+    void string(const std::string& s)
+    {
+        os << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                os << '\\';
+            }
+            os << c;
+        }
+        os << '"';
+    }
+
+    std::ostream& os;
+    std::vector<bool> first;
+    bool pendingKey = false;
+};
+
+/**
+ * \brief Writes the JSON produced by `fn(Json&)` to the `--json` target.
+ */
+template<typename F>
+inline void write_json(const Options& options, F fn)
+{
+    if (options.json.empty()) {
+        return;
+    }
+    if (options.json == "-") {
+        Json json(std::cout);
+        fn(json);
+        std::cout << std::endl;
+        return;
+    }
+    std::ofstream file(options.json);
+    Json json(file);
+    fn(json);
+    file << '\n';
+    std::cerr << "results written to " << options.json << std::endl;
+}
+
+/** \brief Stream for human-readable tables, `std::cerr` if JSON goes to stdout. */
+inline std::ostream& out(const Options& options)
+{ return options.json == "-" ? std::cerr : std::cout; }
+
+/** \brief Formats one row of min / avg / max / sigma for tables. */
+inline std::string row(const Stats& s)
+{
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(1)
+       << std::setw(10) << s.min << std::setw(10) << s.avg
+       << std::setw(10) << s.max << std::setw(10) << s.sigma;
+    return os.str();
+}
+} // namespace Bench
+
+#endif  // CPP_UTILITIES_BENCH_BENCHMARK_HPP
@@ -0,0 +1,208 @@
+#include <shared_mutex>
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+#include <Utilities/MemorySafety/RWSpinLock64.hpp>
+#include <Utilities/MemorySafety/RWTicketSpinLock.hpp>
+#include <Utilities/MemorySafety/CohortRWLock.hpp>
+#include "Benchmark.hpp"
+
+/*
+ * Reproduces the tables quoted in RWSpinLock.hpp on the local hardware:
+ *   - single-thread latency of one lock / unlock pair per mode;
+ *   - throughput and per-operation latency of N threads doing a read / write
+ *     mix on one lock, with a tiny critical section.
+ */
+
+UTILITIES_USING_NAMESPACE;
+
+namespace {
+struct Data
+{
+    std::uint64_t values[8] = {};
+};
+
+struct Result
+{
+    std::string lock;
+    unsigned threads;
+    unsigned reads;
+    std::uint64_t ops;
+    double seconds;
+    Bench::Stats read;
+    Bench::Stats write;
+};
+
+struct Latency
+{
+    std::string lock;
+    std::string op;
+    Bench::Stats stats;
+};
+
+std::vector<Latency> latencies;
+std::vector<Result> results;
+
+template<typename Lock>
+void single_thread(const char* name, const Bench::Options& options)
+{
+    Lock lock;
+    Data data;
+    latencies.push_back({name, "exclusive", Bench::measure(options.samples, 1000, [&] {
+        lock.lock();
+        ++data.values[0];
+        lock.unlock();
+    })});
+    latencies.push_back({name, "shared", Bench::measure(options.samples, 1000, [&] {
+        lock.lock_shared();
+        Bench::keep(data.values[0]);
+        lock.unlock_shared();
+    })});
+    for (std::size_t i = latencies.size() - 2; i < latencies.size(); ++i) {
+        Bench::out(options) << std::left << std::setw(20) << latencies[i].lock
+                            << std::setw(10) << latencies[i].op << std::right
+                            << Bench::row(latencies[i].stats) << std::endl;
+    }
+}
+
+template<typename Lock>
+void contended(const char* name, unsigned threads, unsigned reads, const Bench::Options& options)
+{
+    // Sample one operation out of 16 to keep clock reads out of the mix.
+    enum { SampleEvery = 16 };
+    Lock lock;
+    Data data;
+    std::vector<std::vector<double>> readSamples(threads);
+    std::vector<std::vector<double>> writeSamples(threads);
+    const std::uint64_t elapsed = Bench::run_threads(threads, [&](unsigned index) {
+        Bench::XorShift random(index + 1);
+        std::vector<double>& readMine = readSamples[index];
+        std::vector<double>& writeMine = writeSamples[index];
+        readMine.reserve(options.ops / SampleEvery + 1);
+        for (std::uint64_t i = 0; i < options.ops; ++i) {
+            const bool read = random() % 100 < reads;
+            const bool sampled = i % SampleEvery == 0;
+            const std::uint64_t start = sampled ? Bench::now() : 0;
+            if (read) {
+                lock.lock_shared();
+                std::uint64_t sum = 0;
+                for (std::uint64_t v : data.values) {
+                    sum += v;
+                }
+                Bench::keep(sum);
+                lock.unlock_shared();
+            } else {
+                lock.lock();
+                for (std::uint64_t& v : data.values) {
+                    ++v;
+                }
+                lock.unlock();
+            }
+            if (sampled) {
+                (read ? readMine : writeMine).push_back(double(Bench::now() - start));
+            }
+        }
+    });
+    const auto merge = [](const std::vector<std::vector<double>>& samples) {
+        std::vector<double> all;
+        for (const auto& s : samples) {
+            all.insert(all.end(), s.begin(), s.end());
+        }
+        return Bench::Stats::of(all);
+    };
+    Result result{name, threads, reads, options.ops * threads, elapsed / 1e9,
+                  merge(readSamples), merge(writeSamples)};
+    for (int write = 0; write < 2; ++write) {
+        const Bench::Stats& stats = write ? result.write : result.read;
+        if (stats.count == 0) {
+            continue;
+        }
+        Bench::out(options) << std::left << std::setw(20) << name << std::right
+                            << std::setw(8) << threads << std::setw(7) << reads << '%'
+                            << std::setw(7) << (write ? "write" : "read")
+                            << std::setw(14) << std::fixed << std::setprecision(0)
+                            << result.ops / result.seconds
+                            << Bench::row(stats) << std::endl;
+    }
+    results.push_back(result);
+}
+
+template<typename Lock>
+void run(const char* name, const Bench::Options& options, bool singleThread)
+{
+    if (singleThread) {
+        single_thread<Lock>(name, options);
+        return;
+    }
+    for (unsigned reads : options.reads) {
+        for (unsigned threads : options.threads) {
+            contended<Lock>(name, threads, reads, options);
+        }
+    }
+}
+
+void run_all(const Bench::Options& options, bool singleThread)
+{
+    run<Memory::RWSpinLock>("RWSpinLock", options, singleThread);
+    run<Memory::FutexRWSpinLock>("FutexRWSpinLock", options, singleThread);
+    run<Memory::BackoffRWSpinLock>("BackoffRWSpinLock", options, singleThread);
+    run<Memory::WriterPreferringRWSpinLock>("WriterPreferring", options, singleThread);
+    run<Memory::RWSpinLock64>("RWSpinLock64", options, singleThread);
+    run<Memory::RWTicketSpinLock32>("RWTicketSpinLock32", options, singleThread);
+    run<Memory::RWTicketSpinLock64>("RWTicketSpinLock64", options, singleThread);
+    run<Memory::CohortRWLock<>>("CohortRWLock", options, singleThread);
+    run<std::shared_mutex>("std::shared_mutex", options, singleThread);
+#ifdef CPP_UTILITIES_BENCH_HAS_PTHREAD
+    run<Bench::PthreadRWLock>("pthread_rwlock_t", options, singleThread);
+#endif
+    run<Bench::ExclusiveMutex>("std::mutex", options, singleThread);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Bench::Options options = Bench::Options::parse(argc, argv);
+    std::ostream& out = Bench::out(options);
+
+    out << "single-thread latency (ns per lock/unlock)\n"
+        << std::left << std::setw(20) << "lock" << std::setw(10) << "mode" << std::right
+        << std::setw(10) << "min" << std::setw(10) << "avg"
+        << std::setw(10) << "max" << std::setw(10) << "sigma" << std::endl;
+    run_all(options, true);
+
+    out << "\ncontended read/write mix (" << options.ops << " ops per thread, latency in ns)\n"
+        << std::left << std::setw(20) << "lock" << std::right << std::setw(8) << "threads"
+        << std::setw(8) << "reads" << std::setw(7) << "op" << std::setw(14) << "ops/s"
+        << std::setw(10) << "min" << std::setw(10) << "avg"
+        << std::setw(10) << "max" << std::setw(10) << "sigma" << std::endl;
+    run_all(options, false);
+
+    Bench::write_json(options, [&](Bench::Json& json) {
+        json.begin_object();
+        json.key("benchmark").value("RWSpinLock");
+        json.key("hardware_concurrency").value(std::thread::hardware_concurrency());
+        json.key("latency").begin_array();
+        for (const Latency& l : latencies) {
+            json.begin_object();
+            json.key("lock").value(l.lock);
+            json.key("mode").value(l.op);
+            json.stats("ns", l.stats);
+            json.end_object();
+        }
+        json.end_array();
+        json.key("contention").begin_array();
+        for (const Result& r : results) {
+            json.begin_object();
+            json.key("lock").value(r.lock);
+            json.key("threads").value(r.threads);
+            json.key("read_percent").value(r.reads);
+            json.key("ops").value(r.ops);
+            json.key("seconds").value(r.seconds);
+            json.key("ops_per_second").value(r.ops / r.seconds);
+            json.stats("read_latency_ns", r.read);
+            json.stats("write_latency_ns", r.write);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    });
+    return 0;
+}
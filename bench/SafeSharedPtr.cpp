@@ -0,0 +1,355 @@
+#include <shared_mutex>
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+#include <Utilities/MemorySafety/SafeSharedPtr.hpp>
+#include <Utilities/MemorySafety/LockHolder.hpp>
+#include <Utilities/MemorySafety/LocalSafeSharedPtr.hpp>
+#include <Utilities/MemorySafety/DistributedSharedMutex.hpp>
+#include <Utilities/MemorySafety/CombiningMutex.hpp>
+#include <Utilities/MemorySafety/DeferredWriteMutex.hpp>
+#include <Utilities/MemorySafety/ObjectPool.hpp>
+#include "Benchmark.hpp"
+
+/*
+ * Cost of Memory::SafeSharedPtr with each lock policy, against a plain
+ * `std::shared_ptr` guarded by one external `std::shared_mutex`:
+ *   - single-thread: construction, make_shared, copy, locked read / write,
+ *     weak lock(), and make_pooled from a warm ObjectPool;
+ *   - contended read / write access from 1 to 64 threads;
+ *   - handle copies from 1 to 64 threads, SafeSharedPtr against
+ *     LocalSafeSharedPtr.
+ * CombiningSafeSharedPtr writes through combine(), DeferredSafeSharedPtr
+ * through post_write(), the others through the write lock.
+ */
+
+UTILITIES_USING_NAMESPACE;
+
+namespace {
+struct Payload
+{
+    std::uint64_t value = 0;
+};
+
+template<typename Ptr>
+struct Access;
+
+template<typename T, typename M, typename R, typename W>
+struct Access<Memory::SafeSharedPtr<T, M, R, W>>
+{
+    using Ptr = Memory::SafeSharedPtr<T, M, R, W>;
+    using Weak = Memory::SafeWeakPtr<T, M, R, W>;
+
+    static Ptr create() { return Ptr(new T); }
+    static Ptr make() { return Memory::make_shared<T, M, R, W>(); }
+    static std::uint64_t read(const Ptr& p) { return p->value; }
+    static void write(Ptr& p) { ++p->value; }
+};
+
+template<typename T, typename L, std::size_t N, typename R, typename W>
+struct Access<Memory::SafeSharedPtr<T, Memory::CombiningMutex<L, N>, R, W>>
+{
+    using Ptr = Memory::SafeSharedPtr<T, Memory::CombiningMutex<L, N>, R, W>;
+    using Weak = Memory::SafeWeakPtr<T, Memory::CombiningMutex<L, N>, R, W>;
+
+    static Ptr create() { return Ptr(new T); }
+    static Ptr make() { return Memory::make_shared<T, Memory::CombiningMutex<L, N>, R, W>(); }
+    static std::uint64_t read(const Ptr& p) { return p->value; }
+    static void write(Ptr& p) { p.combine([](T& t) { ++t.value; }); }
+};
+
+template<typename T, typename L, typename R, typename W>
+struct Access<Memory::SafeSharedPtr<T, Memory::DeferredWriteMutex<L>, R, W>>
+{
+    using Ptr = Memory::SafeSharedPtr<T, Memory::DeferredWriteMutex<L>, R, W>;
+    using Weak = Memory::SafeWeakPtr<T, Memory::DeferredWriteMutex<L>, R, W>;
+
+    static Ptr create() { return Ptr(new T); }
+    static Ptr make() { return Memory::make_shared<T, Memory::DeferredWriteMutex<L>, R, W>(); }
+    static std::uint64_t read(const Ptr& p) { return p->value; }
+    static void write(Ptr& p) { p.post_write([](T& t) { ++t.value; }); }
+};
+
+std::shared_mutex externalMutex;
+
+template<typename T>
+struct Access<std::shared_ptr<T>>
+{
+    using Ptr = std::shared_ptr<T>;
+    using Weak = std::weak_ptr<T>;
+
+    static Ptr create() { return Ptr(new T); }
+    static Ptr make() { return std::make_shared<T>(); }
+
+    static std::uint64_t read(const Ptr& p)
+    {
+        std::shared_lock<std::shared_mutex> lock(externalMutex);
+        return p->value;
+    }
+
+    static void write(Ptr& p)
+    {
+        std::unique_lock<std::shared_mutex> lock(externalMutex);
+        ++p->value;
+    }
+};
+
+struct Latency
+{
+    std::string policy;
+    std::string op;
+    Bench::Stats stats;
+};
+
+struct Result
+{
+    std::string policy;
+    unsigned threads;
+    unsigned reads;
+    std::uint64_t ops;
+    double seconds;
+    Bench::Stats read;
+    Bench::Stats write;
+};
+
+struct CopyResult
+{
+    std::string handle;
+    unsigned threads;
+    std::uint64_t ops;
+    double seconds;
+};
+
+std::vector<Latency> latencies;
+std::vector<Result> results;
+std::vector<CopyResult> copies;
+
+template<typename Ptr>
+void single_thread(const char* name, const Bench::Options& options)
+{
+    using A = Access<Ptr>;
+    const std::size_t first = latencies.size();
+    Ptr ptr = A::create();
+    typename A::Weak weak(ptr);
+
+    latencies.push_back({name, "construct", Bench::measure(options.samples, 1000, [] {
+        Ptr p = A::create();
+        Bench::keep(p);
+    })});
+    latencies.push_back({name, "make_shared", Bench::measure(options.samples, 1000, [] {
+        Ptr p = A::make();
+        Bench::keep(p);
+    })});
+    latencies.push_back({name, "copy", Bench::measure(options.samples, 1000, [&] {
+        Ptr p = ptr;
+        Bench::keep(p);
+    })});
+    latencies.push_back({name, "read", Bench::measure(options.samples, 1000, [&] {
+        Bench::keep(A::read(ptr));
+    })});
+    latencies.push_back({name, "write", Bench::measure(options.samples, 1000, [&] {
+        A::write(ptr);
+    })});
+    latencies.push_back({name, "weak lock", Bench::measure(options.samples, 1000, [&] {
+        Ptr p = weak.lock();
+        Bench::keep(p);
+    })});
+    for (std::size_t i = first; i < latencies.size(); ++i) {
+        Bench::out(options) << std::left << std::setw(20) << latencies[i].policy
+                            << std::setw(12) << latencies[i].op << std::right
+                            << Bench::row(latencies[i].stats) << std::endl;
+    }
+}
+
+// Create / destroy cycle through a warm pool, against make_shared above.
+void pooled(const Bench::Options& options)
+{
+    using Lock = Memory::RWSpinLock;
+    Memory::ObjectPool<Payload, Lock, Lock::ReadHolder, Lock::WriteHolder> pool;
+    latencies.push_back({"RWSpinLock", "make_pooled", Bench::measure(options.samples, 1000, [&pool] {
+        auto p = Memory::make_pooled<Payload>(pool);
+        Bench::keep(p);
+    })});
+    const Latency& l = latencies.back();
+    Bench::out(options) << std::left << std::setw(20) << l.policy << std::setw(12) << l.op << std::right
+                        << Bench::row(l.stats) << std::endl;
+}
+
+template<typename Ptr>
+void contended(const char* name, unsigned threads, unsigned reads, const Bench::Options& options)
+{
+    // Sample one operation out of 16 to keep clock reads out of the mix.
+    enum { SampleEvery = 16 };
+    using A = Access<Ptr>;
+    const Ptr shared = A::create();
+    std::vector<std::vector<double>> readSamples(threads);
+    std::vector<std::vector<double>> writeSamples(threads);
+    const std::uint64_t elapsed = Bench::run_threads(threads, [&](unsigned index) {
+        Ptr ptr = shared;
+        Bench::XorShift random(index + 1);
+        std::vector<double>& readMine = readSamples[index];
+        std::vector<double>& writeMine = writeSamples[index];
+        readMine.reserve(options.ops / SampleEvery + 1);
+        for (std::uint64_t i = 0; i < options.ops; ++i) {
+            const bool read = random() % 100 < reads;
+            const bool sampled = i % SampleEvery == 0;
+            const std::uint64_t start = sampled ? Bench::now() : 0;
+            if (read) {
+                Bench::keep(A::read(ptr));
+            } else {
+                A::write(ptr);
+            }
+            if (sampled) {
+                (read ? readMine : writeMine).push_back(double(Bench::now() - start));
+            }
+        }
+    });
+    const auto merge = [](const std::vector<std::vector<double>>& samples) {
+        std::vector<double> all;
+        for (const auto& s : samples) {
+            all.insert(all.end(), s.begin(), s.end());
+        }
+        return Bench::Stats::of(all);
+    };
+    Result result{name, threads, reads, options.ops * threads, elapsed / 1e9,
+                  merge(readSamples), merge(writeSamples)};
+    for (int write = 0; write < 2; ++write) {
+        const Bench::Stats& stats = write ? result.write : result.read;
+        if (stats.count == 0) {
+            continue;
+        }
+        Bench::out(options) << std::left << std::setw(20) << name << std::right
+                            << std::setw(8) << threads << std::setw(7) << reads << '%'
+                            << std::setw(7) << (write ? "write" : "read")
+                            << std::setw(14) << std::fixed << std::setprecision(0)
+                            << result.ops / result.seconds
+                            << Bench::row(stats) << std::endl;
+    }
+    results.push_back(result);
+}
+
+template<typename Ptr>
+void run(const char* name, const Bench::Options& options, bool singleThread)
+{
+    if (singleThread) {
+        single_thread<Ptr>(name, options);
+        return;
+    }
+    for (unsigned reads : options.reads) {
+        for (unsigned threads : options.threads) {
+            contended<Ptr>(name, threads, reads, options);
+        }
+    }
+}
+
+// Every thread copies a handle of the same object and drops the copy.
+template<typename Handle>
+void copy_scaling(const char* name, unsigned threads, const Bench::Options& options)
+{
+    const Memory::SafeSharedPtr<Payload> shared(new Payload);
+    const std::uint64_t elapsed = Bench::run_threads(threads, [&](unsigned) {
+        const Handle mine(shared);
+        for (std::uint64_t i = 0; i < options.ops; ++i) {
+            Handle copy = mine;
+            Bench::keep(copy);
+        }
+    });
+    CopyResult result{name, threads, options.ops * threads, elapsed / 1e9};
+    Bench::out(options) << std::left << std::setw(20) << name << std::right
+                        << std::setw(8) << threads << std::setw(14) << std::fixed
+                        << std::setprecision(0) << result.ops / result.seconds << std::endl;
+    copies.push_back(result);
+}
+
+template<typename M>
+using HolderPtr = Memory::SafeSharedPtr<Payload, M, Memory::SharedHolder<M>, Memory::UniqueHolder<M>>;
+
+void run_all(const Bench::Options& options, bool singleThread)
+{
+    run<std::shared_ptr<Payload>>("shared_ptr+external", options, singleThread);
+    run<Memory::SafeSharedPtr<Payload>>("std::shared_mutex", options, singleThread);
+    run<Memory::SafeSharedPtr<Payload,
+                              Memory::RWSpinLock,
+                              Memory::RWSpinLock::ReadHolder,
+                              Memory::RWSpinLock::WriteHolder>>("RWSpinLock", options, singleThread);
+    if (singleThread) {
+        pooled(options);
+    }
+    run<Memory::DistributedSafeSharedPtr<Payload>>("DistributedShared", options, singleThread);
+    run<Memory::CombiningSafeSharedPtr<Payload>>("Combining", options, singleThread);
+    run<Memory::DeferredSafeSharedPtr<Payload>>("Deferred", options, singleThread);
+#ifdef CPP_UTILITIES_BENCH_HAS_PTHREAD
+    run<HolderPtr<Bench::PthreadRWLock>>("pthread_rwlock_t", options, singleThread);
+#endif
+    run<HolderPtr<Bench::ExclusiveMutex>>("std::mutex", options, singleThread);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Bench::Options defaults;
+    defaults.threads = {1, 2, 4, 8, 16, 32, 64};
+    const Bench::Options options = Bench::Options::parse(argc, argv, defaults);
+    std::ostream& out = Bench::out(options);
+
+    out << "single-thread cost (ns per operation)\n"
+        << std::left << std::setw(20) << "policy" << std::setw(12) << "operation" << std::right
+        << std::setw(10) << "min" << std::setw(10) << "avg"
+        << std::setw(10) << "max" << std::setw(10) << "sigma" << std::endl;
+    run_all(options, true);
+
+    out << "\ncontended access (" << options.ops << " ops per thread, latency in ns)\n"
+        << std::left << std::setw(20) << "policy" << std::right << std::setw(8) << "threads"
+        << std::setw(8) << "reads" << std::setw(7) << "op" << std::setw(14) << "ops/s"
+        << std::setw(10) << "min" << std::setw(10) << "avg"
+        << std::setw(10) << "max" << std::setw(10) << "sigma" << std::endl;
+    run_all(options, false);
+
+    out << "\nhandle copies (" << options.ops << " copies per thread)\n"
+        << std::left << std::setw(20) << "handle" << std::right << std::setw(8) << "threads"
+        << std::setw(14) << "copies/s" << std::endl;
+    for (unsigned threads : options.threads) {
+        copy_scaling<Memory::SafeSharedPtr<Payload>>("SafeSharedPtr", threads, options);
+        copy_scaling<Memory::LocalSafeSharedPtr<Payload>>("LocalSafeSharedPtr", threads, options);
+    }
+
+    Bench::write_json(options, [&](Bench::Json& json) {
+        json.begin_object();
+        json.key("benchmark").value("SafeSharedPtr");
+        json.key("hardware_concurrency").value(std::thread::hardware_concurrency());
+        json.key("single_thread").begin_array();
+        for (const Latency& l : latencies) {
+            json.begin_object();
+            json.key("policy").value(l.policy);
+            json.key("operation").value(l.op);
+            json.stats("ns", l.stats);
+            json.end_object();
+        }
+        json.end_array();
+        json.key("contention").begin_array();
+        for (const Result& r : results) {
+            json.begin_object();
+            json.key("policy").value(r.policy);
+            json.key("threads").value(r.threads);
+            json.key("read_percent").value(r.reads);
+            json.key("ops").value(r.ops);
+            json.key("seconds").value(r.seconds);
+            json.key("ops_per_second").value(r.ops / r.seconds);
+            json.stats("read_latency_ns", r.read);
+            json.stats("write_latency_ns", r.write);
+            json.end_object();
+        }
+        json.end_array();
+        json.key("copies").begin_array();
+        for (const CopyResult& c : copies) {
+            json.begin_object();
+            json.key("handle").value(c.handle);
+            json.key("threads").value(c.threads);
+            json.key("ops").value(c.ops);
+            json.key("seconds").value(c.seconds);
+            json.key("ops_per_second").value(c.ops / c.seconds);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    });
+    return 0;
+}
@@ -27,10 +27,48 @@
  *     generating approximiate fraction from decimals.
  * - MemorySafety/
  *   - \ref RWSpinLock.hpp A extremely high-performance read-write-spinlock
- *     imported from folly library.
+ *     imported from folly library, with a futex-parking variant.
  *   - \ref SafeSharedPtr.hpp Classes wrapped from `std::shared_ptr` /
  *     `std::weak_ptr` and `std::enable_shared_from_this` to provide
  *     thread-safety while operating the underlying pointer.
+ *   - \ref AtomicSafeSharedPtr.hpp Lock-free atomic load, store and
+ *     compare-exchange of a `SafeSharedPtr` handle itself.
+ *   - \ref Reclamation.hpp Deferred memory reclamation with hazard pointers
+ *     and epoch-based reclamation for lock-free readers.
+ *   - \ref LockHolder.hpp Generic RAII read / write guards for any
+ *     read-write lock.
+ *   - \ref LockProfiler.hpp Opt-in contention profiling of locks, with text
+ *     dump and Chrome trace-event export.
+ *   - \ref AsyncSharedMutex.hpp Read-write lock awaitable from C++20
+ *     coroutines, with suspended waiters resumed by the unlocker.
+ *   - \ref LocalSafeSharedPtr.hpp Thread-confined handle of a
+ *     `SafeSharedPtr` whose copies are counted without atomic operations.
+ *   - \ref CompactSafeWeakPtr.hpp Single-allocation `SafeSharedPtr` with its
+ *     lock, and the compact weak handle observing it.
+ *   - \ref StripedSafeArray.hpp Shared array guarded by interleaved lock
+ *     stripes, with per-element and range locking.
+ *   - \ref StripedLockPolicy.hpp Lock policy of `SafeSharedPtr` mapping
+ *     objects to a fixed table of locks, without per-object allocation.
+ *   - \ref DistributedSharedMutex.hpp Read-write lock counting readers in
+ *     per-thread slots, scaling reads with the cores.
+ *   - \ref RWTicketSpinLock.hpp Fair read-write spin lock serving writers
+ *     in ticket order, not starved by readers.
+ *   - \ref CacheLinePadded.hpp Wrapper giving a lock a cache line of its
+ *     own, against false sharing.
+ *   - \ref MicroRWLock.hpp One-byte read-write lock, lock packed in the
+ *     bits of a caller's word or in the low bits of a pointer.
+ *   - \ref RWSpinLock64.hpp Read-write spin lock on a 64-bit word, with
+ *     counts of waiting writers and upgraders and a state snapshot.
+ *   - \ref SeqLock.hpp Sequence lock with optimistic readers that never
+ *     write shared memory, and a `load()` / `store()` payload holder.
+ *   - \ref CombiningMutex.hpp Flat-combining read-write lock running the
+ *     small writes of many threads in one lock hold.
+ *   - \ref CohortRWLock.hpp Cohort read-write lock handing the write lock
+ *     over within a NUMA node first, with a configurable CPU topology.
+ *   - \ref DeferredWriteMutex.hpp Read-write lock queueing fire-and-forget
+ *     writes without waiting, applied in batches by the next lock holder.
+ *   - \ref ObjectPool.hpp Pool recycling the memory of SafeSharedPtr objects,
+ *     lock and control block included, through make_pooled().
  * - Containers/
  *   - \ref SequencialMap.hpp Key-value container behaves like std::map, but
  *          extended with random-access operations and traverses in the
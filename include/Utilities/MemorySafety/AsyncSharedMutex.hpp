@@ -0,0 +1,396 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_ASYNCSHAREDMUTEX_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_ASYNCSHAREDMUTEX_HPP
+
+#include "../Common.h"
+
+/**
+ * \file AsyncSharedMutex.hpp
+ * \brief Read-write lock awaitable from C++20 coroutines.
+ * \details
+ *   Memory::AsyncSharedMutex can be acquired with `co_await` without blocking
+ *   the thread: a coroutine finding the lock busy is queued and suspended, and
+ *   the thread releasing the lock resumes it inline, on the releaser's thread
+ *   (and so on the releaser's executor).\n
+ *   A resumed coroutine releasing the lock in turn resumes its successor
+ *   inline too, up to a few nested resumptions: beyond them the successor is
+ *   queued to the thread, and resumed once the current coroutine suspends or
+ *   returns, or blocks in lock() / lock_shared(), so a long chain of waiters
+ *   does not grow the stack.\n
+ *   Waiters are served in FIFO order, so a waiting writer holds back readers
+ *   arriving after it; consecutive readers at the head of the queue are
+ *   granted together.
+ *
+ *   The usual synchronous `lock()` / `lock_shared()` are provided as well, so
+ *   the lock works as a policy of Memory::SafeSharedPtr where both kinds of
+ *   access are mixed, see Memory::AsyncSafeSharedPtr and
+ *   SafeSharedPtr::async_read() / SafeSharedPtr::async_write().
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::AsyncSafeSharedPtr<Cache> cache(new Cache);
+ *   Task handle(Request request)
+ *   {
+ *       {
+ *           const auto& reader = co_await cache.async_read();
+ *           if (auto hit = reader->find(request.key)) {
+ *               co_return reply(*hit);
+ *           }
+ *       }
+ *       auto&& writer = co_await cache.async_write();
+ *       writer->insert(request.key, co_await compute(request));
+ *   }
+ *   ```
+ *
+ * \note Everything in this file requires C++20.
+ */
+
+#if __cplusplus >= 202002L
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include "LockHolder.hpp"
+#include "SafeSharedPtr.hpp"
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write lock acquired by `co_await` without blocking the thread,
+ *        see AsyncSharedMutex.hpp for details.
+ */
+class AsyncSharedMutex
+{
+    struct Waiter
+    {
+        Waiter* next = nullptr;
+        bool exclusive = false;
+        std::coroutine_handle<> handle;
+        std::atomic<bool>* granted = nullptr;
+    };
+
+public:
+    /**
+     * \brief Awaitable acquiring the lock, `co_await` returns once held.
+     * \tparam Exclusive `true` for write lock, `false` for read lock.
+     */
+    template<bool Exclusive>
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(AsyncSharedMutex& m) noexcept
+            : mutex(m)
+        {}
+
+        bool await_ready() noexcept
+        { return Exclusive ? mutex.try_lock() : mutex.try_lock_shared(); }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            waiter.exclusive = Exclusive;
+            waiter.handle = handle;
+            return !mutex.acquire_or_enqueue(waiter);
+        }
+
+        void await_resume() const noexcept
+        {}
+
+    protected:
+        AsyncSharedMutex& mutex;
+        Waiter waiter;
+    };
+
+    /**
+     * \brief Same as Awaiter, `co_await` returns a SharedHolder /
+     *        UniqueHolder owning the lock.
+     * \tparam Exclusive `true` for write lock, `false` for read lock.
+     */
+    template<bool Exclusive>
+    class ScopedAwaiter : public Awaiter<Exclusive>
+    {
+    public:
+        /** \brief RAII guard returned. */
+        using holder_type = std::conditional_t<Exclusive,
+                                               UniqueHolder<AsyncSharedMutex>,
+                                               SharedHolder<AsyncSharedMutex>>;
+
+        using Awaiter<Exclusive>::Awaiter;
+
+        holder_type await_resume() const noexcept
+        { return holder_type(this->mutex, std::adopt_lock); }
+    };
+
+    AsyncSharedMutex() noexcept = default;
+    AsyncSharedMutex(const AsyncSharedMutex&) = delete;
+    AsyncSharedMutex& operator=(const AsyncSharedMutex&) = delete;
+
+    /** \warning The lock must be released and nobody waiting. */
+    ~AsyncSharedMutex()
+    { assert(!head && !writer && readers == 0); }
+
+    /** \brief Returns an awaitable acquiring the write lock. */
+    Awaiter<true> lock_async() noexcept
+    { return Awaiter<true>(*this); }
+
+    /** \brief Returns an awaitable acquiring the read lock. */
+    Awaiter<false> lock_shared_async() noexcept
+    { return Awaiter<false>(*this); }
+
+    /** \brief Returns an awaitable acquiring the write lock into a UniqueHolder. */
+    ScopedAwaiter<true> scoped_lock_async() noexcept
+    { return ScopedAwaiter<true>(*this); }
+
+    /** \brief Returns an awaitable acquiring the read lock into a SharedHolder. */
+    ScopedAwaiter<false> scoped_lock_shared_async() noexcept
+    { return ScopedAwaiter<false>(*this); }
+
+    /** \brief Acquires the write lock if free and nobody is waiting. */
+    bool try_lock() noexcept
+    {
+        Guard guard(*this);
+        if (writer || readers != 0 || head) {
+            return false;
+        }
+        writer = true;
+        return true;
+    }
+
+    /** \brief Acquires a read lock if no writer holds or waits for the lock. */
+    bool try_lock_shared() noexcept
+    {
+        Guard guard(*this);
+        if (writer || head) {
+            return false;
+        }
+        ++readers;
+        return true;
+    }
+
+    /**
+     * \brief Acquires the write lock, blocking the thread.
+     * \details Queued in the same FIFO order as coroutines.
+     */
+    void lock()
+    { wait(true); }
+
+    /**
+     * \brief Acquires a read lock, blocking the thread.
+     * \details Queued in the same FIFO order as coroutines.
+     */
+    void lock_shared()
+    { wait(false); }
+
+    /** \brief Releases the write lock, resuming the next waiters on this thread. */
+    void unlock()
+    {
+        Waiter* ready;
+        {
+            Guard guard(*this);
+            writer = false;
+            ready = grant();
+        }
+        wake(ready);
+    }
+
+    /** \brief Releases a read lock, resuming the next waiters on this thread if last. */
+    void unlock_shared()
+    {
+        Waiter* ready = nullptr;
+        {
+            Guard guard(*this);
+            if (--readers == 0) {
+                ready = grant();
+            }
+        }
+        wake(ready);
+    }
+
+private:
+    /** Internal guard of the waiter queue, held for a few instructions only. */
+    class Guard
+    {
+    public:
+        explicit Guard(AsyncSharedMutex& m) noexcept
+            : mutex(m)
+        {
+            while (mutex.guard.exchange(true, std::memory_order_acquire)) {
+                while (mutex.guard.load(std::memory_order_relaxed)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        ~Guard()
+        { mutex.guard.store(false, std::memory_order_release); }
+
+    private:
+        AsyncSharedMutex& mutex;
+    };
+
+    /** Takes the lock for `w` if possible, otherwise queues `w`. */
+    bool acquire_or_enqueue(Waiter& w) noexcept
+    {
+        Guard guard(*this);
+        if (!head && !writer && (w.exclusive ? readers == 0 : true)) {
+            if (w.exclusive) {
+                writer = true;
+            } else {
+                ++readers;
+            }
+            return true;
+        }
+        w.next = nullptr;
+        if (tail) {
+            tail->next = &w;
+        } else {
+            head = &w;
+        }
+        tail = &w;
+        return false;
+    }
+
+    /** Hands the free lock to the head of the queue, returns those granted. */
+    Waiter* grant() noexcept
+    {
+        if (!head) {
+            return nullptr;
+        }
+        Waiter* first = head;
+        if (first->exclusive) {
+            writer = true;
+            head = first->next;
+            first->next = nullptr;
+        } else {
+            Waiter* last = first;
+            ++readers;
+            while (last->next && !last->next->exclusive) {
+                last = last->next;
+                ++readers;
+            }
+            head = last->next;
+            last->next = nullptr;
+        }
+        if (!head) {
+            tail = nullptr;
+        }
+        return first;
+    }
+
+    /** Nested resumptions on a thread beyond which granted coroutines are queued. */
+    enum : std::size_t { MaxDepth = 16 };
+
+    /** Coroutines granted the lock on this thread, waiting to be resumed. */
+    struct Ready
+    {
+        Waiter* head = nullptr;
+        Waiter* tail = nullptr;
+        std::size_t depth = 0;
+    };
+
+    static Ready& ready() noexcept
+    {
+        static thread_local Ready queue;
+        return queue;
+    }
+
+    /**
+     * Resumes the waiters granted. Coroutines are resumed inline up to
+     * MaxDepth nested resumptions, and beyond it queued to the thread, for
+     * the enclosing call to resume once the current coroutine suspends or
+     * returns. A resumed coroutine may free its node.
+     */
+    static void wake(Waiter* w)
+    {
+        Ready& queue = ready();
+        while (w) {
+            Waiter* next = w->next;
+            if (w->handle) {
+                w->next = nullptr;
+                (queue.tail ? queue.tail->next : queue.head) = w;
+                queue.tail = w;
+            } else {
+                w->granted->store(true, std::memory_order_release);
+            }
+            w = next;
+        }
+        if (queue.depth < MaxDepth) {
+            resume_ready(queue);
+        }
+    }
+
+    /** Resumes the coroutines queued to the thread, in order. */
+    static void resume_ready(Ready& queue)
+    {
+        struct Nested
+        {
+            explicit Nested(Ready& q) noexcept
+                : queue(q)
+            { ++queue.depth; }
+
+            ~Nested()
+            { --queue.depth; }
+
+            Ready& queue;
+        } nested(queue);
+        while (Waiter* first = queue.head) {
+            queue.head = first->next;
+            if (!queue.head) {
+                queue.tail = nullptr;
+            }
+            first->handle.resume();
+        }
+    }
+
+    void wait(bool exclusive)
+    {
+        // Coroutines queued to this thread may hold the lock, and only this
+        // thread resumes them: let them release it before queueing behind.
+        Ready& queue = ready();
+        if (queue.head) {
+            resume_ready(queue);
+        }
+        std::atomic<bool> granted(false);
+        Waiter w;
+        w.exclusive = exclusive;
+        w.granted = &granted;
+        if (acquire_or_enqueue(w)) {
+            return;
+        }
+        while (!granted.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<bool> guard{false};
+    bool writer = false;
+    std::size_t readers = 0;
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+};
+
+/**
+ * \brief SafeSharedPtr locked by AsyncSharedMutex, accessible with
+ *        SafeSharedPtr::async_read() / SafeSharedPtr::async_write() from
+ *        coroutines besides the usual blocking accessors.
+ */
+template<typename T>
+using AsyncSafeSharedPtr = SafeSharedPtr<T,
+                                         AsyncSharedMutex,
+                                         SharedHolder<AsyncSharedMutex>,
+                                         UniqueHolder<AsyncSharedMutex>>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // __cplusplus >= 202002L
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_ASYNCSHAREDMUTEX_HPP
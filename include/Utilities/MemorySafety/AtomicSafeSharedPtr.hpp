@@ -0,0 +1,354 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_ATOMICSAFESHAREDPTR_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_ATOMICSAFESHAREDPTR_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include "../Common.h"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file AtomicSafeSharedPtr.hpp
+ * \brief Lock-free atomic holder of a Memory::SafeSharedPtr handle.
+ * \details
+ *   Memory::SafeSharedPtr guards the object it points to, but the handle itself
+ *   is two `std::shared_ptr` members and is no more thread-safe than a plain
+ *   `std::shared_ptr`: assigning to one handle while another thread reads it
+ *   is a data race.\n
+ *   Memory::AtomicSafeSharedPtr provides `load()`, `store()`, `exchange()` and
+ *   `compare_exchange_*()` on such a handle, replacing both the object pointer
+ *   and its lock as a single atomic step.
+ *
+ *   -------------------------------------------------------------------
+ *
+ *   **Split reference count**
+ *
+ *   The current handle is boxed into a heap node, and the address of the node
+ *   is packed together with a small "local" reference count into one 64-bit
+ *   word (48 bits of address and 16 bits of count on 64-bit platforms, 32 bits
+ *   of each on 32-bit platforms).\n
+ *   A reader increments the local count with one CAS, copies the handle out of
+ *   the node, and then decrements the local count again. A writer swaps in a
+ *   new node and transfers the local count it swapped out into the "internal"
+ *   count of the old node, so that readers still working on the old node find
+ *   their references there and the last one deletes it.\n
+ *   Every operation is lock-free as long as `std::atomic<uint64_t>` is, see
+ *   AtomicSafeSharedPtr::is_lock_free().
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Atomic holder of a `SafeSharedPtr`, like
+ *        `std::atomic<std::shared_ptr<T>>` of C++20, see
+ *        AtomicSafeSharedPtr.hpp for details.
+ * \tparam T            Type of the object managed by SafeSharedPtr.
+ * \tparam mutex_t      Type of the mutex used, default is shared_mutex_t.
+ * \tparam read_lock_t  Type of the read-lock used, default is shared_lock_t.
+ * \tparam write_lock_t Type of the write-lock used, default is unique_lock_t.
+ * \details
+ *   **Sample Code**\n
+ *   ```cpp
+ *   Memory::AtomicSafeSharedPtr<Config> current(Memory::make_shared<Config>());
+ *   // reader threads
+ *   Memory::SafeSharedPtr<Config> config = current.load();
+ *   std::cout << config->name() << std::endl;
+ *   // writer thread
+ *   current.store(Memory::make_shared<Config>(loadConfig()));
+ *   ```
+ * \note
+ *   At most 65535 (on 64-bit platforms) operations may be inside `load()` on
+ *   the same holder at any instant, further callers spin until one of them
+ *   leaves.
+ * \sa SafeSharedPtr
+ */
+template<typename T,
+         typename mutex_t = shared_mutex_t,
+         typename read_lock_t = shared_lock_t,
+         typename write_lock_t = unique_lock_t>
+class AtomicSafeSharedPtr
+{
+public:
+    /** \brief Type of the handle held. */
+    using value_type = SafeSharedPtr<T, mutex_t, read_lock_t, write_lock_t>;
+
+    /**
+     * \brief Default constructor, holds an empty `SafeSharedPtr`.
+     */
+    AtomicSafeSharedPtr() noexcept
+        : word(0)
+    {}
+
+    /**
+     * \brief Constructs holding `desired`.
+     * \param desired The initial handle.
+     * \exception std::bad_alloc If the node could not be allocated.
+     */
+    AtomicSafeSharedPtr(value_type desired)
+        : word(pack(create(std::move(desired))))
+    {}
+
+    AtomicSafeSharedPtr(const AtomicSafeSharedPtr&) = delete;
+    AtomicSafeSharedPtr& operator=(const AtomicSafeSharedPtr&) = delete;
+
+    /**
+     * \brief Destructor, releases the held handle.
+     * \warning No other thread may operate on `*this` concurrently.
+     */
+    ~AtomicSafeSharedPtr()
+    { delete node(word.load(std::memory_order_acquire)); }
+
+    /**
+     * \brief Checks whether operations on this object are lock-free.
+     * \return `true` if the underlying 64-bit word is lock-free.
+     */
+    bool is_lock_free() const noexcept
+    { return word.is_lock_free(); }
+
+    /**
+     * \brief Atomically obtains a copy of the held handle.
+     * \return A `SafeSharedPtr` sharing ownership and lock with the held one.
+     */
+    value_type load() const
+    {
+        const word_t current = acquire();
+        Node* n = node(current);
+        if (!n) {
+            return value_type();
+        }
+        value_type result(n->value);
+        release(n);
+        return result;
+    }
+
+    /**
+     * \brief Equivalent to load().
+     */
+    operator value_type() const
+    { return load(); }
+
+    /**
+     * \brief Atomically replaces the held handle with `desired`.
+     * \param desired The handle to store.
+     * \exception std::bad_alloc If the node could not be allocated.
+     */
+    void store(value_type desired)
+    { exchange(std::move(desired)); }
+
+    /**
+     * \brief Equivalent to store(desired).
+     * \param desired The handle to store.
+     * \return `*this`.
+     */
+    AtomicSafeSharedPtr& operator=(value_type desired)
+    {
+        store(std::move(desired));
+        return *this;
+    }
+
+    /**
+     * \brief Atomically replaces the held handle with `desired`.
+     * \param desired The handle to store.
+     * \return The handle held immediately before the call.
+     * \exception std::bad_alloc If the node could not be allocated.
+     */
+    value_type exchange(value_type desired)
+    {
+        Node* fresh = create(std::move(desired));
+        return retire(word.exchange(pack(fresh), std::memory_order_acq_rel));
+    }
+
+    /**
+     * \brief Atomically compares the held handle with `expected`, and replaces
+     *        it with `desired` if they are equivalent.
+     * \param expected  The handle expected to be held, receives the held one
+     *                  on failure.
+     * \param desired   The handle to store on success.
+     * \return `true` if the handle was replaced.
+     * \details
+     *   Two handles are equivalent if they store the same pointer, share
+     *   ownership, and (unless both are empty) share the same lock.
+     * \exception std::bad_alloc If the node could not be allocated.
+     */
+    bool compare_exchange_strong(value_type& expected, value_type desired)
+    {
+        Node* fresh = nullptr;
+        for (;;) {
+            Node* n = node(acquire());
+            if (!equivalent(n, expected)) {
+                expected = n ? n->value : value_type();
+                release(n);
+                delete fresh;
+                return false;
+            }
+            if (!fresh) {
+                fresh = create(std::move(desired));
+            }
+            word_t current = word.load(std::memory_order_relaxed);
+            while (node(current) == n) {
+                if (word.compare_exchange_weak(current, pack(fresh),
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed)) {
+                    // our own local reference is consumed by the swap
+                    transfer(n, count(current) - 1);
+                    return true;
+                }
+            }
+            release(n);
+        }
+    }
+
+    /**
+     * \brief Same as compare_exchange_strong(), never fails spuriously.
+     * \param expected  The handle expected to be held, receives the held one
+     *                  on failure.
+     * \param desired   The handle to store on success.
+     * \return `true` if the handle was replaced.
+     */
+    bool compare_exchange_weak(value_type& expected, value_type desired)
+    { return compare_exchange_strong(expected, std::move(desired)); }
+
+private:
+    using word_t = std::uint64_t;
+
+    struct Node
+    {
+        explicit Node(value_type&& v)
+            : value(std::move(v)), count(0)
+        {}
+
+        value_type value;
+        std::atomic<std::int_fast64_t> count;
+    };
+
+    enum : unsigned { CountShift = sizeof(void*) >= 8 ? 48 : 32 };
+    static constexpr word_t CountOne = word_t(1) << CountShift;
+    static constexpr word_t PointerMask = CountOne - 1;
+    static constexpr word_t MaxCount = ~word_t(0) >> CountShift;
+
+    static Node* create(value_type&& v)
+    {
+        if (!v.ptr && v.ptr.use_count() == 0) {
+            return nullptr;
+        }
+        return new Node(std::move(v));
+    }
+
+    static word_t pack(Node* n) noexcept
+    {
+        const word_t bits = static_cast<word_t>(reinterpret_cast<std::uintptr_t>(n));
+        assert((bits & ~PointerMask) == 0 && "pointer does not fit the packed word");
+        return bits;
+    }
+
+    static Node* node(word_t w) noexcept
+    { return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(w & PointerMask)); }
+
+    static std::int_fast64_t count(word_t w) noexcept
+    { return static_cast<std::int_fast64_t>(w >> CountShift); }
+
+    static bool equivalent(const Node* n, const value_type& v) noexcept
+    {
+        if (!n) {
+            return !v.ptr && v.ptr.use_count() == 0;
+        }
+        const value_type& held = n->value;
+        return held.ptr == v.ptr
+               && !held.ptr.owner_before(v.ptr)
+               && !v.ptr.owner_before(held.ptr)
+               && (held.mutex == v.mutex || held.ptr.use_count() == 0);
+    }
+
+    /**
+     * Takes a local reference on the current node. The empty handle has no
+     * node to keep alive and is not counted, its word is always 0: a count
+     * left on it by a reader overtaken by stores would never be taken back.
+     */
+    word_t acquire() const
+    {
+        word_t current = word.load(std::memory_order_relaxed);
+        for (;;) {
+            if (!node(current)) {
+                return current;
+            }
+            if ((current >> CountShift) == MaxCount) {
+                std::this_thread::yield();
+                current = word.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (word.compare_exchange_weak(current, current + CountOne,
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                return current + CountOne;
+            }
+        }
+    }
+
+    /** Drops a reference taken by acquire(). */
+    void release(Node* n) const
+    {
+        if (!n) {
+            return;
+        }
+        word_t current = word.load(std::memory_order_relaxed);
+        while (node(current) == n) {
+            if (word.compare_exchange_weak(current, current - CountOne,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // The node was swapped out and our reference moved into its counter.
+        if (n->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete n;
+        }
+    }
+
+    /** Hands the local references of a swapped out node to its counter. */
+    static void transfer(Node* n, std::int_fast64_t local)
+    {
+        if (n && n->count.fetch_add(local, std::memory_order_acq_rel) + local == 0) {
+            delete n;
+        }
+    }
+
+    /** Takes back the handle of a node just swapped out by exchange(). */
+    static value_type retire(word_t old)
+    {
+        Node* n = node(old);
+        if (!n) {
+            return value_type();
+        }
+        const std::int_fast64_t local = count(old);
+        if (local == 0) {
+            value_type result(std::move(n->value));
+            delete n;
+            return result;
+        }
+        value_type result(n->value);
+        transfer(n, local);
+        return result;
+    }
+
+    mutable std::atomic<word_t> word;
+};
+
+template<typename T, typename M, typename R, typename W>
+constexpr typename AtomicSafeSharedPtr<T, M, R, W>::word_t AtomicSafeSharedPtr<T, M, R, W>::CountOne;
+template<typename T, typename M, typename R, typename W>
+constexpr typename AtomicSafeSharedPtr<T, M, R, W>::word_t AtomicSafeSharedPtr<T, M, R, W>::PointerMask;
+template<typename T, typename M, typename R, typename W>
+constexpr typename AtomicSafeSharedPtr<T, M, R, W>::word_t AtomicSafeSharedPtr<T, M, R, W>::MaxCount;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_ATOMICSAFESHAREDPTR_HPP
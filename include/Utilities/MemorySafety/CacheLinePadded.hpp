@@ -0,0 +1,96 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_CACHELINEPADDED_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_CACHELINEPADDED_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+
+/**
+ * \file CacheLinePadded.hpp
+ * \brief Wrapper giving a lock a cache line of its own.
+ * \details
+ *   Memory::RWSpinLock is a single 4-byte word: locks stored in an array, or
+ *   next to hot data, share cache lines, and a thread spinning on one lock
+ *   slows down every thread using its neighbours (false sharing).
+ *
+ *   Memory::CacheLinePadded derives from the lock and is aligned to
+ *   Memory::cache_line_size, so it starts a line and fills it. It is still a
+ *   lock: it is accepted by the holders of the lock and as `mutex_t` of
+ *   Memory::SafeSharedPtr.
+ *
+ *   The opposite trade-off, several locks per line for density, is served by
+ *   MicroRWLock.hpp.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   // One line per bucket, threads of different buckets do not interfere.
+ *   Memory::CacheLinePadded<Memory::RWSpinLock> buckets[16];
+ *   Memory::RWSpinLock::WriteHolder writer(buckets[hash % 16]);
+ *   ```
+ *
+ * \note
+ *   Over-aligned objects allocated with `new` or a standard container are
+ *   only aligned from C++17 on, older standards align those on the stack and
+ *   in static storage only.
+ */
+
+/**
+ * \brief Size of cache lines assumed by the padded types of MemorySafety.
+ * \details
+ *   The value of `std::hardware_destructive_interference_size` on x86-64 and
+ *   most ARM64 targets. The standard constant varies with compiler flags such
+ *   as `-mtune`, which makes it unfit for layouts shared between translation
+ *   units, so this one is fixed, and may be defined before including the
+ *   header, e.g. to 128 for POWER or Apple M-series.
+ */
+#ifndef UTILITIES_CACHE_LINE_SIZE
+#define UTILITIES_CACHE_LINE_SIZE 64
+#endif
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/** \brief Size of cache lines, see UTILITIES_CACHE_LINE_SIZE. */
+constexpr std::size_t cache_line_size = UTILITIES_CACHE_LINE_SIZE;
+
+/**
+ * \brief A `Lock` alone on its cache line, see CacheLinePadded.hpp for
+ *        details.
+ * \tparam Lock Type of the lock, any class type.
+ */
+template<typename Lock>
+class alignas(cache_line_size) CacheLinePadded : public Lock
+{
+    static_assert(std::is_class<Lock>::value, "CacheLinePadded derives from Lock, which must be a class");
+
+public:
+    /** \brief Type of the padded lock. */
+    using lock_type = Lock;
+
+    CacheLinePadded() = default;
+
+    /** \brief Constructs the lock with `arg, args...`. */
+    template<typename Arg, typename... Args>
+    explicit CacheLinePadded(Arg&& arg, Args&&... args)
+        : Lock(std::forward<Arg>(arg), std::forward<Args>(args)...)
+    {}
+
+    /** \brief The padded lock. */
+    Lock& get() noexcept
+    { return *this; }
+
+    /** \overload */
+    const Lock& get() const noexcept
+    { return *this; }
+};
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_CACHELINEPADDED_HPP
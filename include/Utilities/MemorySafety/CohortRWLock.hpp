@@ -0,0 +1,430 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_COHORTRWLOCK_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_COHORTRWLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+#include "SafeSharedPtr.hpp"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+/**
+ * \file CohortRWLock.hpp
+ * \brief Read-write lock handing the write lock over within a group of CPUs
+ *        (NUMA node) before letting other groups have it.
+ * \details
+ *   On multi-socket machines, a lock passed to a thread of the other socket
+ *   takes its cache line, and the data it guards, across the interconnect,
+ *   which costs several times a handover within the socket.
+ *
+ *   Memory::CohortRWLock is a lock cohort in the sense of Dice, Marathe and
+ *   Shavit ("Lock Cohorting", PPoPP 2012):
+ *     - writers first take the local lock of their group, then the global
+ *       lock;
+ *     - a writer leaving while another writer of its group waits passes the
+ *       global lock along with the local one, so the next writer skips the
+ *       global lock and its data stays on the socket;
+ *     - after `Handoffs` handovers in a row, the global lock is released
+ *       anyway, so other groups, and readers, get their turn.
+ *
+ *   Readers count themselves in a counter of their group, one cache line per
+ *   group, and wait while the global lock is held: writers are preferred, up
+ *   to the handover bound.
+ *
+ *   Groups are given by a Memory::CohortTopology, mapping each CPU to its
+ *   group: read from `/sys/devices/system/node` by default, or given
+ *   explicitly, e.g. to test the handovers on a single-socket machine.
+ *   Locks refer to their topology instead of copying it, so the mapping is
+ *   not repeated in every object. Memory::CohortSafeSharedPtr is the
+ *   SafeSharedPtr policy using it, its locks use CohortTopology::system().
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   // Optional, before creating locks: CPUs 0-7 form group 0, 8-15 group 1.
+ *   std::vector<size_t> groups(16);
+ *   std::fill(groups.begin() + 8, groups.end(), 1);
+ *   Memory::CohortTopology::system() = Memory::CohortTopology(groups);
+ *
+ *   Memory::CohortSafeSharedPtr<Table> table(new Table);
+ *   table->insert(key, value);
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Mapping of CPUs to groups for CohortRWLock, see CohortRWLock.hpp for
+ *        details.
+ * \details CPUs beyond the mapping, or unknown, belong to group 0.
+ */
+class CohortTopology
+{
+public:
+    /** \brief One group holding all CPUs. */
+    CohortTopology()
+        : count(1)
+    {}
+
+    /**
+     * \brief Explicit mapping.
+     * \param groupOfCpu Group of each CPU, indexed by CPU number.
+     */
+    explicit CohortTopology(std::vector<std::size_t> groupOfCpu);
+
+    /**
+     * \brief Mapping of the NUMA nodes of the machine.
+     * \param root Directory listing the nodes, with an `online` list and one
+     *             `node<N>/cpulist` per node.
+     * \return One group per node with CPUs, nodes without any (memory-only
+     *         nodes such as CXL or HBM) are skipped. A single group if
+     *         `root` is missing or unreadable.
+     */
+    static CohortTopology from_sysfs(const std::string& root = "/sys/devices/system/node");
+
+    /**
+     * \brief Topology used by default-constructed locks, read with
+     *        from_sysfs() at first use.
+     * \details May be assigned at start-up, before locks are created and
+     *          while no other thread uses it.
+     */
+    static CohortTopology& system();
+
+    /**
+     * \brief Parses a Linux CPU list such as `0-3,8,10-11`.
+     * \return Whether `list` was well-formed, `values` is only appended to
+     *         then.
+     */
+    static bool parse_cpulist(const std::string& list, std::vector<std::size_t>& values);
+
+    /** \brief Number of groups. */
+    std::size_t groups() const noexcept
+    { return count; }
+
+    /** \brief Group of `cpu`. */
+    std::size_t group_of(std::size_t cpu) const noexcept
+    { return cpu < map.size() ? map[cpu] : 0; }
+
+    /** \brief Group of the CPU the calling thread currently runs on. */
+    std::size_t current_group() const noexcept
+    {
+        if (count == 1) {
+            return 0;
+        }
+#if defined(__linux__)
+        const int cpu = sched_getcpu();
+        return cpu < 0 ? 0 : group_of(std::size_t(cpu));
+#else
+        return 0;
+#endif
+    }
+
+private:
+    std::vector<std::size_t> map;
+    std::size_t count;
+};
+
+inline CohortTopology::CohortTopology(std::vector<std::size_t> groupOfCpu)
+    : map(std::move(groupOfCpu)), count(1)
+{
+    for (std::size_t group : map) {
+        if (group >= count) {
+            count = group + 1;
+        }
+    }
+}
+
+inline CohortTopology CohortTopology::from_sysfs(const std::string& root)
+{
+    // An empty list is valid, for nodes without CPUs.
+    const auto read = [](const std::string& path, std::vector<std::size_t>& values) {
+        std::ifstream file(path);
+        std::string line;
+        return file && (!std::getline(file, line) || line.empty() || parse_cpulist(line, values));
+    };
+    std::vector<std::size_t> nodes;
+    if (!read(root + "/online", nodes) || nodes.size() < 2) {
+        return CohortTopology();
+    }
+    std::vector<std::size_t> map;
+    std::size_t group = 0;
+    for (std::size_t node : nodes) {
+        std::vector<std::size_t> cpus;
+        if (!read(root + "/node" + std::to_string(node) + "/cpulist", cpus)) {
+            return CohortTopology();
+        }
+        if (cpus.empty()) {
+            continue;
+        }
+        for (std::size_t cpu : cpus) {
+            if (cpu >= map.size()) {
+                map.resize(cpu + 1, 0);
+            }
+            map[cpu] = group;
+        }
+        ++group;
+    }
+    if (group < 2) {
+        return CohortTopology();
+    }
+    return CohortTopology(std::move(map));
+}
+
+inline CohortTopology& CohortTopology::system()
+{
+    static CohortTopology topology = from_sysfs();
+    return topology;
+}
+
+inline bool CohortTopology::parse_cpulist(const std::string& list, std::vector<std::size_t>& values)
+{
+    std::vector<std::size_t> parsed;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        std::size_t first = 0;
+        std::size_t last = 0;
+        char dash = 0;
+        std::istringstream bounds(range);
+        if (!(bounds >> first)) {
+            return false;
+        }
+        last = first;
+        if (bounds >> dash && (dash != '-' || !(bounds >> last) || last < first)) {
+            return false;
+        }
+        for (std::size_t value = first; value <= last; ++value) {
+            parsed.push_back(value);
+        }
+    }
+    if (parsed.empty()) {
+        return false;
+    }
+    values.insert(values.end(), parsed.begin(), parsed.end());
+    return true;
+}
+
+/**
+ * \brief Read-write lock preferring to hand the write lock over within a
+ *        group of CPUs, see CohortRWLock.hpp for details.
+ * \tparam MaxGroups Number of groups allocated, each taking two cache lines.
+ *                   Groups beyond it share them in round-robin.
+ * \tparam Handoffs  Maximum number of consecutive handovers within a group.
+ */
+template<std::size_t MaxGroups = 8, unsigned Handoffs = 64>
+class CohortRWLock
+{
+    static_assert(MaxGroups > 0, "CohortRWLock needs at least one group");
+
+public:
+    /** \brief RAII guard of a read lock. */
+    using ReadHolder = SharedHolder<CohortRWLock>;
+    /** \brief RAII guard of the write lock. */
+    using WriteHolder = UniqueHolder<CohortRWLock>;
+
+    /** \brief Lock over CohortTopology::system(). */
+    CohortRWLock()
+        : CohortRWLock(CohortTopology::system())
+    {}
+
+    /**
+     * \brief Lock over `cohorts`, shared with other locks rather than
+     *        copied, and which must outlive the lock.
+     */
+    explicit CohortRWLock(const CohortTopology& cohorts)
+        : topology(&cohorts), global(false), owner(0)
+    {
+        for (auto& group : groups) {
+            group.readers.store(0, std::memory_order_relaxed);
+            group.local.store(false, std::memory_order_relaxed);
+            group.waiting.store(0, std::memory_order_relaxed);
+            group.inherited = false;
+            group.handoffs = 0;
+        }
+    }
+
+    CohortRWLock(CohortTopology&&) = delete;
+    CohortRWLock(const CohortRWLock&) = delete;
+    CohortRWLock& operator=(const CohortRWLock&) = delete;
+
+    /** \brief Acquires the write lock. */
+    void lock()
+    { acquire(group()); }
+
+    /** \brief Acquires the write lock if free. */
+    bool try_lock()
+    { return try_acquire(group()); }
+
+    /**
+     * \brief Releases the write lock, handing it over to a writer of the same
+     *        group if one waits.
+     */
+    void unlock()
+    {
+        Group& mine = groups[owner];
+        if (mine.waiting.load(std::memory_order_relaxed) != 0 && mine.handoffs < Handoffs) {
+            ++mine.handoffs;
+            mine.inherited = true;
+        } else {
+            mine.handoffs = 0;
+            mine.inherited = false;
+            global.store(false, std::memory_order_release);
+        }
+        mine.local.store(false, std::memory_order_release);
+    }
+
+    /** \brief Acquires a read lock, waits while a writer holds the lock. */
+    void lock_shared()
+    {
+        std::uint_fast32_t count = 0;
+        while (!try_lock_shared()) {
+            while (global.load(std::memory_order_relaxed)) {
+                backoff(count);
+            }
+        }
+    }
+
+    /** \brief Acquires a read lock if no writer holds the lock. */
+    bool try_lock_shared()
+    {
+        std::atomic<std::intptr_t>& readers = groups[group()].readers;
+        // Pairs with the global store then counter loads of the writer.
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        if (!global.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        readers.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * \brief Releases a read lock.
+     * \details The thread may have moved to another group since acquiring,
+     *          writers only consider the sum of the counters.
+     */
+    void unlock_shared()
+    { groups[group()].readers.fetch_sub(1, std::memory_order_release); }
+
+    /** \brief Topology of the lock. */
+    const CohortTopology& cohorts() const noexcept
+    { return *topology; }
+
+private:
+    enum : std::uint_fast32_t { SpinLimit = 1000 };
+
+    struct alignas(cache_line_size) Group
+    {
+        std::atomic<std::intptr_t> readers;
+        // Writer side, on a line of its own.
+        alignas(cache_line_size) std::atomic<bool> local;
+        std::atomic<std::uint32_t> waiting;
+        // Guarded by `local`.
+        bool inherited;
+        unsigned handoffs;
+    };
+
+    static void backoff(std::uint_fast32_t& count)
+    {
+        cpu_relax();
+        if (++count > SpinLimit) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::size_t group() const noexcept
+    { return topology->current_group() % MaxGroups; }
+
+    void acquire(std::size_t index)
+    {
+        Group& mine = groups[index];
+        std::uint_fast32_t count = 0;
+        mine.waiting.fetch_add(1, std::memory_order_relaxed);
+        while (mine.local.exchange(true, std::memory_order_acquire)) {
+            while (mine.local.load(std::memory_order_relaxed)) {
+                backoff(count);
+            }
+        }
+        mine.waiting.fetch_sub(1, std::memory_order_relaxed);
+        if (!mine.inherited) {
+            bool expected = false;
+            while (!global.compare_exchange_weak(expected, true, std::memory_order_seq_cst)) {
+                expected = false;
+                backoff(count);
+            }
+            while (readers() != 0) {
+                backoff(count);
+            }
+        }
+        owner = index;
+    }
+
+    bool try_acquire(std::size_t index)
+    {
+        Group& mine = groups[index];
+        if (mine.local.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+        if (!mine.inherited) {
+            bool expected = false;
+            if (!global.compare_exchange_strong(expected, true, std::memory_order_seq_cst)) {
+                mine.local.store(false, std::memory_order_release);
+                return false;
+            }
+            if (readers() != 0) {
+                global.store(false, std::memory_order_release);
+                mine.local.store(false, std::memory_order_release);
+                return false;
+            }
+        }
+        owner = index;
+        return true;
+    }
+
+    /** Readers inside, readers leaving on another group may make one negative. */
+    std::intptr_t readers() const noexcept
+    {
+        std::intptr_t sum = 0;
+        for (const auto& group : groups) {
+            sum += group.readers.load(std::memory_order_seq_cst);
+        }
+        return sum;
+    }
+
+    const CohortTopology* topology;
+    alignas(cache_line_size) std::atomic<bool> global;
+    // Group of the writer, guarded by the write lock.
+    std::size_t owner;
+    Group groups[MaxGroups];
+};
+
+/**
+ * \brief SafeSharedPtr locked by CohortRWLock, for objects written from
+ *        several NUMA nodes.
+ */
+template<typename T, std::size_t MaxGroups = 8>
+using CohortSafeSharedPtr = SafeSharedPtr<T,
+                                          CohortRWLock<MaxGroups>,
+                                          SharedHolder<CohortRWLock<MaxGroups>>,
+                                          UniqueHolder<CohortRWLock<MaxGroups>>>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_COHORTRWLOCK_HPP
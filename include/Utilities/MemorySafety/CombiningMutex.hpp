@@ -0,0 +1,327 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_COMBININGMUTEX_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_COMBININGMUTEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file CombiningMutex.hpp
+ * \brief Read-write lock whose writers hand their operations to a single
+ *        combining thread (flat combining).
+ * \details
+ *   When many threads make small writes to the same object, e.g. appending to
+ *   a shared vector, each of them takes the write lock in turn, and the lock
+ *   word and the object move from core to core at every write.
+ *
+ *   Memory::CombiningMutex implements the flat combining of Hendler, Incze,
+ *   Shavit and Tzafrir. Instead of locking, combine() publishes the operation
+ *   in a slot of the calling thread, each slot on its own cache line, then:
+ *     - the thread acquiring the lock becomes the combiner, runs all the
+ *       operations published so far in one lock hold, and marks them done;
+ *     - the other threads spin on their own operation until it is done, and
+ *       get its result, or its exception, back. They only read a flag while
+ *       a combiner runs, and try the lock once it is cleared
+ *       (test-and-test-and-set), leaving the lock's cache line to the
+ *       combiner.
+ *
+ *   Lock and object stay in the cache of the combiner for the whole batch.
+ *   Usual lock() / lock_shared() accesses are still available, combining
+ *   only applies to combine().
+ *
+ *   Memory::CombiningSafeSharedPtr is the SafeSharedPtr policy using it,
+ *   operations are given to SafeSharedPtr::combine().
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::CombiningSafeSharedPtr<std::vector<Event>> log(new std::vector<Event>);
+ *   // Any number of threads
+ *   size_t index = log.combine([&](std::vector<Event>& events) {
+ *       events.push_back(event);
+ *       return events.size() - 1;
+ *   });
+ *   ```
+ *
+ * \note
+ *   The operation may run on another thread: it must not rely on
+ *   thread-local state, and must not call combine() on the same lock.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write lock combining the operations of its writers, see
+ *        CombiningMutex.hpp for details.
+ * \tparam Lock  Read-write lock taken by the combiner and by the usual
+ *               accesses.
+ * \tparam Slots Number of publication slots, each taking one cache line.
+ *               Threads beyond it share slots in round-robin, and lock
+ *               directly while their slot is in use.
+ */
+template<typename Lock = RWSpinLock, std::size_t Slots = 32>
+class CombiningMutex
+{
+    static_assert(Slots > 0, "CombiningMutex needs at least one slot");
+
+public:
+    CombiningMutex() noexcept
+    {
+        combiner.active.store(false, std::memory_order_relaxed);
+        for (auto& slot : slots) {
+            slot.request.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    CombiningMutex(const CombiningMutex&) = delete;
+    CombiningMutex& operator=(const CombiningMutex&) = delete;
+
+    /**
+     * \brief Runs `fn()` under the write lock, batched with the operations of
+     *        other threads.
+     * \return The result of `fn()`, an exception thrown by `fn` is rethrown
+     *         here.
+     * \details
+     *   `fn` may be run by another thread, while the calling thread waits for
+     *   it. Must not be called with the lock held by the calling thread.
+     */
+    template<typename Fn>
+    auto combine(Fn&& fn) -> decltype(fn())
+    {
+        using Result = decltype(fn());
+        Task<Fn, Result> task(fn);
+        Request* expected = nullptr;
+        if (!slots[slot()].request.compare_exchange_strong(expected, &task, std::memory_order_release,
+                                                          std::memory_order_relaxed)) {
+            // Slot in use by a thread sharing it, lock on our own.
+            lock_.lock();
+            combiner.active.store(true, std::memory_order_relaxed);
+            apply(task);
+            drain();
+            combiner.active.store(false, std::memory_order_relaxed);
+            lock_.unlock();
+            return task.result();
+        }
+        std::uint_fast32_t count = 0;
+        while (!task.done.load(std::memory_order_acquire)) {
+            if (!combiner.active.load(std::memory_order_relaxed) && lock_.try_lock()) {
+                combiner.active.store(true, std::memory_order_relaxed);
+                drain();
+                combiner.active.store(false, std::memory_order_relaxed);
+                lock_.unlock();
+            } else {
+                backoff(count);
+            }
+        }
+        return task.result();
+    }
+
+    void lock()
+    { lock_.lock(); }
+
+    bool try_lock()
+    { return lock_.try_lock(); }
+
+    void unlock()
+    { lock_.unlock(); }
+
+    void lock_shared()
+    { lock_.lock_shared(); }
+
+    bool try_lock_shared()
+    { return lock_.try_lock_shared(); }
+
+    void unlock_shared()
+    { lock_.unlock_shared(); }
+
+    /** \brief Number of publication slots. */
+    static constexpr std::size_t slot_count() noexcept
+    { return Slots; }
+
+private:
+    enum : std::uint_fast32_t { SpinLimit = 1000, MaxPasses = 4 };
+
+    struct Request
+    {
+        explicit Request(void (*call)(Request&)) noexcept
+            : call(call), done(false)
+        {}
+
+        void (*call)(Request&);
+        std::atomic<bool> done;
+        std::exception_ptr error;
+    };
+
+    /** Result of the operation, stored by the combiner. */
+    template<typename R, typename = void>
+    struct Outcome
+    {
+        Outcome() noexcept
+            : ready(false)
+        {}
+
+        ~Outcome()
+        {
+            if (ready) {
+                value()->~R();
+            }
+        }
+
+        template<typename Fn>
+        void run(Fn& fn)
+        {
+            new (storage) R(fn());
+            ready = true;
+        }
+
+        R take()
+        { return std::move(*value()); }
+
+        R* value() noexcept
+        { return reinterpret_cast<R*>(storage); }
+
+        alignas(R) unsigned char storage[sizeof(R)];
+        bool ready;
+    };
+
+    template<typename R>
+    struct Outcome<R, typename std::enable_if<std::is_reference<R>::value>::type>
+    {
+        template<typename Fn>
+        void run(Fn& fn)
+        { pointer = &fn(); }
+
+        R take() noexcept
+        { return static_cast<R>(*pointer); }
+
+        typename std::remove_reference<R>::type* pointer = nullptr;
+    };
+
+    template<typename R>
+    struct Outcome<R, typename std::enable_if<std::is_void<R>::value>::type>
+    {
+        template<typename Fn>
+        void run(Fn& fn)
+        { fn(); }
+
+        void take() noexcept
+        {}
+    };
+
+    template<typename Fn, typename R>
+    struct Task : Request
+    {
+        explicit Task(Fn& fn) noexcept
+            : Request(&Task::invoke), fn(fn)
+        {}
+
+        static void invoke(Request& request)
+        {
+            Task& task = static_cast<Task&>(request);
+            task.outcome.run(task.fn);
+        }
+
+        R result()
+        {
+            if (this->error) {
+                std::rethrow_exception(this->error);
+            }
+            return outcome.take();
+        }
+
+        Fn& fn;
+        Outcome<R> outcome;
+    };
+
+    struct Slot
+    {
+        std::atomic<Request*> request;
+    };
+
+    /** Whether a combiner holds the lock, read by the waiters instead of it. */
+    struct Combiner
+    {
+        std::atomic<bool> active;
+    };
+
+    /** Slot of the calling thread, given in round-robin at first use. */
+    static std::size_t slot() noexcept
+    {
+        static std::atomic<std::size_t> next(0);
+        static thread_local const std::size_t mine = next.fetch_add(1, std::memory_order_relaxed) % Slots;
+        return mine;
+    }
+
+    static void backoff(std::uint_fast32_t& count)
+    {
+        cpu_relax();
+        if (++count > SpinLimit) {
+            std::this_thread::yield();
+        }
+    }
+
+    static void apply(Request& request) noexcept
+    {
+        try {
+            request.call(request);
+        } catch (...) {
+            request.error = std::current_exception();
+        }
+    }
+
+    /** Runs the published operations, with the write lock held. */
+    void drain() noexcept
+    {
+        for (std::uint_fast32_t pass = 0; pass < MaxPasses; ++pass) {
+            bool found = false;
+            for (auto& slot : slots) {
+                Request* request = slot.request.load(std::memory_order_acquire);
+                if (!request) {
+                    continue;
+                }
+                found = true;
+                apply(*request);
+                // Freed before done, so the owner may publish again at once.
+                slot.request.store(nullptr, std::memory_order_relaxed);
+                request->done.store(true, std::memory_order_release);
+            }
+            if (!found) {
+                break;
+            }
+        }
+    }
+
+    CacheLinePadded<Lock> lock_;
+    CacheLinePadded<Combiner> combiner;
+    CacheLinePadded<Slot> slots[Slots];
+};
+
+/**
+ * \brief SafeSharedPtr locked by CombiningMutex, for objects receiving many
+ *        small writes, given to SafeSharedPtr::combine().
+ */
+template<typename T, typename Lock = RWSpinLock, std::size_t Slots = 32>
+using CombiningSafeSharedPtr = SafeSharedPtr<T,
+                                             CombiningMutex<Lock, Slots>,
+                                             SharedHolder<CombiningMutex<Lock, Slots>>,
+                                             UniqueHolder<CombiningMutex<Lock, Slots>>>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_COMBININGMUTEX_HPP
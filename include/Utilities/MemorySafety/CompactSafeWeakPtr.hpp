@@ -0,0 +1,280 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_COMPACTSAFEWEAKPTR_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_COMPACTSAFEWEAKPTR_HPP
+
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file CompactSafeWeakPtr.hpp
+ * \brief Single control block allocation of an object with its lock, and the
+ *        compact weak handle it allows.
+ * \details
+ *   A Memory::SafeSharedPtr created by Memory::make_shared() owns two control
+ *   blocks, one for the object and one for its lock, and Memory::SafeWeakPtr
+ *   observes both: `lock()` has to promote two weak references, each with its
+ *   own compare-and-swap loop.
+ *
+ *   Memory::make_compact() allocates the lock next to the object in a single
+ *   control block, shared by both members of the SafeSharedPtr through the
+ *   aliasing constructor of `std::shared_ptr`. The lock therefore lives
+ *   exactly as long as the object, and Memory::CompactSafeWeakPtr only needs
+ *   one weak reference plus the address of the lock:
+ *     - `sizeof` is one `std::weak_ptr` and one pointer, against two
+ *       `std::weak_ptr` for SafeWeakPtr;
+ *     - `lock()` promotes the weak reference with a single compare-and-swap
+ *       loop, then takes one atomic increment for the lock's alias, which
+ *       cannot fail, and cannot observe a lock gone while the object is
+ *       alive. Both members of SafeSharedPtr own a reference, so the second
+ *       increment remains.
+ *
+ *   Such objects are otherwise ordinary SafeSharedPtr, usable with
+ *   SafeWeakPtr, AtomicSafeSharedPtr and every other class of this module.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   auto observer = Memory::make_compact<Observer>();
+ *   std::vector<Memory::CompactSafeWeakPtr<Observer>> registry{observer};
+ *   for (auto& weak : registry) {
+ *       if (auto strong = weak.lock()) {
+ *           strong->notify(event);
+ *       }
+ *   }
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Weak handle of a SafeSharedPtr created by make_compact(), see
+ *        CompactSafeWeakPtr.hpp for details.
+ * \tparam T            Type of the object managed by SafeSharedPtr.
+ * \tparam mutex_t      Type of the mutex used, default is shared_mutex_t.
+ * \tparam read_lock_t  Type of the read-lock used, default is shared_lock_t.
+ * \tparam write_lock_t Type of the write-lock used, default is unique_lock_t.
+ * \sa SafeWeakPtr, make_compact
+ */
+template<typename T,
+         typename mutex_t = shared_mutex_t,
+         typename read_lock_t = shared_lock_t,
+         typename write_lock_t = unique_lock_t>
+class CompactSafeWeakPtr
+{
+public:
+    /** \brief Type alias for template mutex_t. */
+    using SharedMutex = mutex_t;
+    /** \brief Type of the strong handle. */
+    using value_type = SafeSharedPtr<T, mutex_t, read_lock_t, write_lock_t>;
+    /** \brief Same element_type of SafeSharedPtr. */
+    using element_type = typename value_type::element_type;
+
+    /**
+     * \brief Default constructor, observes nothing.
+     */
+    constexpr CompactSafeWeakPtr() noexcept
+        : mutex(nullptr)
+    {}
+
+    /**
+     * \brief Observes the object managed by `other`.
+     * \param other Pointer created by make_compact(), or copied from one.
+     * \exception std::invalid_argument
+     *   If `other` manages an object whose lock has its own control block,
+     *   i.e. not created by make_compact().
+     */
+    CompactSafeWeakPtr(const value_type& other)
+        : ptr(other.ptr),
+          mutex(other.ptr ? other.mutex.get() : nullptr)
+    {
+        if (other.ptr && !value_type::compact(other.mutex, other.ptr)) {
+            throw std::invalid_argument("CompactSafeWeakPtr requires a pointer created by make_compact()");
+        }
+    }
+
+    /**
+     * \brief Replaces the observed object with the one managed by `other`.
+     * \param other Pointer created by make_compact(), or copied from one.
+     * \return `*this`.
+     * \exception std::invalid_argument Same as the constructor.
+     */
+    CompactSafeWeakPtr& operator=(const value_type& other)
+    {
+        CompactSafeWeakPtr(other).swap(*this);
+        return *this;
+    }
+
+    /**
+     * \brief Stops observing, `*this` becomes empty.
+     */
+    void reset() noexcept
+    { CompactSafeWeakPtr().swap(*this); }
+
+    /**
+     * \brief Exchanges the contents of `*this` and `other`.
+     * \param other Another weak pointer to exchange the contents with.
+     */
+    void swap(CompactSafeWeakPtr& other) noexcept
+    {
+        ptr.swap(other.ptr);
+        std::swap(mutex, other.mutex);
+    }
+
+    /**
+     * \brief Returns the number of SafeSharedPtr sharing the object, see
+     *        SafeWeakPtr::use_count().
+     */
+    long use_count() const noexcept
+    { return ptr.use_count() / 2; }
+
+    /**
+     * \brief Checks whether the object was already deleted, see
+     *        SafeWeakPtr::expired().
+     */
+    bool expired() const noexcept
+    { return ptr.expired(); }
+
+    /**
+     * \brief Creates a `SafeSharedPtr` that manages the observed object.
+     * \return A `SafeSharedPtr` sharing ownership of the object and its lock,
+     *         or an empty one if the object was deleted.
+     * \details
+     *   Promotes the single weak reference atomically, the lock needs no
+     *   promotion of its own as it shares the control block, only an atomic
+     *   increment of the reference count.
+     */
+    value_type lock() const noexcept
+    {
+        std::shared_ptr<T> p = ptr.lock();
+        if (!p) {
+            return value_type();
+        }
+        std::shared_ptr<SharedMutex> m(p, mutex);
+        return value_type(std::move(m), std::move(p));
+    }
+
+    /**
+     * \brief Provides owner-based ordering, see SafeWeakPtr::owner_before().
+     */
+    template<typename Y, typename M, typename R, typename W>
+    bool owner_before(const CompactSafeWeakPtr<Y, M, R, W>& other) const
+    { return ptr.owner_before(other.ptr); }
+
+    /** \overload */
+    template<typename Y, typename M, typename R, typename W>
+    bool owner_before(const SafeSharedPtr<Y, M, R, W>& other) const
+    { return ptr.owner_before(other.ptr); }
+
+private:
+    template<typename Y, typename M, typename R, typename W>
+    friend class CompactSafeWeakPtr;
+
+    /** Control block content of make_compact(). */
+    using Block = CompactBlock<T, SharedMutex>;
+
+    template<typename Y, typename M, typename R, typename W, typename... Args>
+    friend SafeSharedPtr<Y, M, R, W> make_compact(Args&&... args);
+    template<typename Y, typename M, typename R, typename W, typename Alloc, typename... Args>
+    friend SafeSharedPtr<Y, M, R, W> allocate_compact(const Alloc& alloc, Args&&... args);
+
+    template<typename... Args>
+    static value_type create(Args&&... args)
+    { return adopt(std::make_shared<Block>(std::forward<Args>(args)...)); }
+
+    template<typename Alloc, typename... Args>
+    static value_type allocate(const Alloc& alloc, Args&&... args)
+    { return adopt(std::allocate_shared<Block>(alloc, std::forward<Args>(args)...)); }
+
+    static value_type adopt(std::shared_ptr<Block> block)
+    {
+        std::shared_ptr<SharedMutex> m(block, &block->mutex);
+        T* value = &block->value;
+#if __cplusplus >= 202002L
+        // Takes over the reference of `block` instead of adding one.
+        std::shared_ptr<T> p(std::move(block), value);
+#else
+        std::shared_ptr<T> p(block, value);
+#endif
+        return value_type(std::move(m), std::move(p));
+    }
+
+    std::weak_ptr<T> ptr;
+    SharedMutex* mutex;
+};
+
+/**
+ * \relates CompactSafeWeakPtr
+ * \brief Creates an object and its lock in a single control block.
+ * \tparam T            Type of object to be created, not an array, nor
+ *                      derived from EnableSafeSharedFromThis or
+ *                      EnableEmbeddedSafeSharedFromThis.
+ * \tparam SharedMutex  Type of the mutex used, default is shared_mutex_t.
+ * \tparam SharedLock   Type of the read-lock used, default is shared_lock_t.
+ * \tparam UniqueLock   Type of the write-lock used, default is unique_lock_t.
+ * \param args Arguments forwarded to the constructor of `T`.
+ * \return The new pointer, observable by CompactSafeWeakPtr.
+ * \details
+ *   Same as make_shared(), with one allocation instead of two.
+ */
+template<typename T,
+         typename SharedMutex = shared_mutex_t,
+         typename SharedLock = shared_lock_t,
+         typename UniqueLock = unique_lock_t,
+         typename... Args>
+inline SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> make_compact(Args&&... args)
+{
+    static_assert(!std::is_array<T>::value, "make_compact() does not support arrays");
+    static_assert(!std::is_base_of<EnableSafeSharedFromThis<T, SharedMutex, SharedLock, UniqueLock>, T>::value,
+                  "the lock of EnableSafeSharedFromThis is owned by the object, use make_shared()");
+    static_assert(!std::is_base_of<EnableEmbeddedSafeSharedFromThis<T, SharedMutex, SharedLock, UniqueLock>, T>::value,
+                  "EnableEmbeddedSafeSharedFromThis is compact already, use make_shared()");
+    return CompactSafeWeakPtr<T, SharedMutex, SharedLock, UniqueLock>::create(std::forward<Args>(args)...);
+}
+
+/**
+ * \relates CompactSafeWeakPtr
+ * \brief Creates an object and its lock in a single control block allocated
+ *        with `alloc`.
+ * \tparam T            Type of object to be created, same requirements as
+ *                      make_compact().
+ * \tparam SharedMutex  Type of the mutex used, default is shared_mutex_t.
+ * \tparam SharedLock   Type of the read-lock used, default is shared_lock_t.
+ * \tparam UniqueLock   Type of the write-lock used, default is unique_lock_t.
+ * \tparam Alloc        Type of the allocator.
+ * \param alloc Allocator of the control block, rebound to its internal type.
+ * \param args  Arguments forwarded to the constructor of `T`.
+ * \return The new pointer, observable by CompactSafeWeakPtr.
+ * \details
+ *   Same as make_compact(), with the allocation of allocate_shared(): object
+ *   and lock are destroyed with the last SafeSharedPtr, the memory is given
+ *   back to `alloc` with the last weak handle.
+ * \sa ObjectPool
+ */
+template<typename T,
+         typename SharedMutex = shared_mutex_t,
+         typename SharedLock = shared_lock_t,
+         typename UniqueLock = unique_lock_t,
+         typename Alloc,
+         typename... Args>
+inline SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> allocate_compact(const Alloc& alloc, Args&&... args)
+{
+    static_assert(!std::is_array<T>::value, "allocate_compact() does not support arrays");
+    static_assert(!std::is_base_of<EnableSafeSharedFromThis<T, SharedMutex, SharedLock, UniqueLock>, T>::value,
+                  "the lock of EnableSafeSharedFromThis is owned by the object, use allocate_shared()");
+    static_assert(!std::is_base_of<EnableEmbeddedSafeSharedFromThis<T, SharedMutex, SharedLock, UniqueLock>, T>::value,
+                  "EnableEmbeddedSafeSharedFromThis is compact already, use allocate_shared()");
+    return CompactSafeWeakPtr<T, SharedMutex, SharedLock, UniqueLock>::allocate(alloc, std::forward<Args>(args)...);
+}
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_COMPACTSAFEWEAKPTR_HPP
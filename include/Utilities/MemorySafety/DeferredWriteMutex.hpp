@@ -0,0 +1,226 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_DEFERREDWRITEMUTEX_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_DEFERREDWRITEMUTEX_HPP
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file DeferredWriteMutex.hpp
+ * \brief Read-write lock accepting fire-and-forget writes, queued without
+ *        waiting and applied in batches by the next lock holder.
+ * \details
+ *   Many writes do not need a result, such as bumping statistics or
+ *   appending to a log, yet their thread still waits for the write lock.
+ *
+ *   Memory::DeferredWriteMutex lets them post() the write instead: it is
+ *   pushed into a lock-free multi-producer queue, and the thread returns at
+ *   once. The queue is drained, in posting order:
+ *     - by the poster itself if the lock happens to be free, never waiting
+ *       for it;
+ *     - by the next thread acquiring the write lock, before its own access;
+ *     - by readers finding the queue non-empty, which drain it under the
+ *       write lock before reading, so a read sees every write posted before
+ *       it started;
+ *     - by flush(), and by the destructor for writes still pending.
+ *
+ *   Memory::DeferredSafeSharedPtr is the SafeSharedPtr policy using it, writes
+ *   are given to SafeSharedPtr::post_write().
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::DeferredSafeSharedPtr<Stats> stats(new Stats);
+ *   // Hot paths, never wait for the lock
+ *   stats.post_write([](Stats& s) { ++s.requests; });
+ *   // Readers see all the writes posted so far
+ *   auto total = stats->requests;
+ *   ```
+ *
+ * \note
+ *   Posted writes run on whichever thread drains them and must not throw,
+ *   `std::terminate` is called otherwise. Each post allocates one queue node.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write lock with a queue of deferred writes, see
+ *        DeferredWriteMutex.hpp for details.
+ * \tparam Lock Read-write lock guarding the object.
+ */
+template<typename Lock = RWSpinLock>
+class DeferredWriteMutex
+{
+public:
+    DeferredWriteMutex() noexcept
+        : queue(nullptr)
+    {}
+
+    /** \brief Applies the writes still pending. */
+    ~DeferredWriteMutex()
+    { run(queue.exchange(nullptr, std::memory_order_acquire)); }
+
+    DeferredWriteMutex(const DeferredWriteMutex&) = delete;
+    DeferredWriteMutex& operator=(const DeferredWriteMutex&) = delete;
+
+    /**
+     * \brief Queues `fn()` to run under the write lock, without waiting.
+     * \details Runs the queue at once if the lock is free.
+     */
+    template<typename Fn>
+    void post(Fn&& fn)
+    {
+        Node* node = new Task<typename std::decay<Fn>::type>(std::forward<Fn>(fn));
+        node->next = queue.load(std::memory_order_relaxed);
+        while (!queue.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        if (lock_.try_lock()) {
+            drain();
+            lock_.unlock();
+        }
+    }
+
+    /** \brief Runs the writes posted so far, waiting for the write lock. */
+    void flush()
+    {
+        if (pending()) {
+            lock_.lock();
+            drain();
+            lock_.unlock();
+        }
+    }
+
+    /** \brief Whether posted writes are waiting to run. */
+    bool pending() const noexcept
+    { return queue.load(std::memory_order_acquire) != nullptr; }
+
+    /** \brief Acquires the write lock, then runs the posted writes. */
+    void lock()
+    {
+        lock_.lock();
+        drain();
+    }
+
+    /** \brief Acquires the write lock if free, then runs the posted writes. */
+    bool try_lock()
+    {
+        if (!lock_.try_lock()) {
+            return false;
+        }
+        drain();
+        return true;
+    }
+
+    void unlock()
+    { lock_.unlock(); }
+
+    /** \brief Runs the posted writes if any, then acquires a read lock. */
+    void lock_shared()
+    {
+        flush();
+        lock_.lock_shared();
+    }
+
+    /**
+     * \brief Acquires a read lock if free, fails if writes are posted and
+     *        the write lock is busy.
+     */
+    bool try_lock_shared()
+    {
+        if (pending()) {
+            if (!try_lock()) {
+                return false;
+            }
+            unlock();
+        }
+        return lock_.try_lock_shared();
+    }
+
+    void unlock_shared()
+    { lock_.unlock_shared(); }
+
+private:
+    struct Node
+    {
+        explicit Node(void (*call)(Node*)) noexcept
+            : call(call), next(nullptr)
+        {}
+
+        /** Runs the write and deletes the node. */
+        void (*call)(Node*);
+        Node* next;
+    };
+
+    template<typename Fn>
+    struct Task : Node
+    {
+        template<typename F>
+        explicit Task(F&& f)
+            : Node(&Task::invoke), fn(std::forward<F>(f))
+        {}
+
+        static void invoke(Node* node)
+        {
+            Task* self = static_cast<Task*>(node);
+            self->fn();
+            delete self;
+        }
+
+        Fn fn;
+    };
+
+    /** Runs the writes posted so far, with the write lock held. */
+    void drain() noexcept
+    {
+        if (pending()) {
+            run(queue.exchange(nullptr, std::memory_order_acquire));
+        }
+    }
+
+    static void run(Node* list) noexcept
+    {
+        // Pushed last first, reversed to run in posting order.
+        Node* ordered = nullptr;
+        while (list) {
+            Node* next = list->next;
+            list->next = ordered;
+            ordered = list;
+            list = next;
+        }
+        while (ordered) {
+            Node* next = ordered->next;
+            ordered->call(ordered);
+            ordered = next;
+        }
+    }
+
+    Lock lock_;
+    std::atomic<Node*> queue;
+};
+
+/**
+ * \brief SafeSharedPtr locked by DeferredWriteMutex, for objects receiving
+ *        writes whose result is not needed, given to
+ *        SafeSharedPtr::post_write().
+ */
+template<typename T, typename Lock = RWSpinLock>
+using DeferredSafeSharedPtr = SafeSharedPtr<T,
+                                            DeferredWriteMutex<Lock>,
+                                            SharedHolder<DeferredWriteMutex<Lock>>,
+                                            UniqueHolder<DeferredWriteMutex<Lock>>>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_DEFERREDWRITEMUTEX_HPP
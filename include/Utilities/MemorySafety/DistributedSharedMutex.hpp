@@ -0,0 +1,211 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_DISTRIBUTEDSHAREDMUTEX_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_DISTRIBUTEDSHAREDMUTEX_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "LockHolder.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file DistributedSharedMutex.hpp
+ * \brief Read-write lock whose readers count themselves in per-thread slots.
+ * \details
+ *   Every reader of RWSpinLock or `std::shared_mutex` updates the same word,
+ *   so with many cores reading the cache line holding it bounces between
+ *   them, and read throughput stops growing with the number of threads.
+ *
+ *   Memory::DistributedSharedMutex spreads the reader count over `Slots`
+ *   counters, one per cache line, in the style of the Linux brlock and of the
+ *   deferred readers of folly's SharedMutex. Each thread is given one slot,
+ *   so readers of different slots never touch the same line:
+ *     - a reader increments its slot, then checks the writer flag, and
+ *       backs off if a writer is present;
+ *     - a writer raises the flag, then waits for the sum of all slots to
+ *       drop to zero.
+ *
+ *   Reading costs one atomic increment on a line private to the thread, while
+ *   writing costs a scan of all slots: use it for objects read much more often
+ *   than written. Writers are preferred, new readers wait while a writer is
+ *   present.
+ *
+ *   Memory::DistributedSafeSharedPtr is the SafeSharedPtr policy using it.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::DistributedSafeSharedPtr<Config> config(new Config);
+ *   // Any number of threads, scales with the cores
+ *   auto timeout = config->timeout;
+ *   // Rare updates
+ *   config->reload(file);
+ *   ```
+ *
+ * \note
+ *   The slots are aligned to Memory::cache_line_size. Over-aligned objects
+ *   allocated with `new` or `std::make_shared`, as SafeSharedPtr does for its
+ *   lock, are only aligned from C++17 on. Older standards align them on the
+ *   stack and in static storage only, and slots may then share lines.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write lock with per-thread reader slots, see
+ *        DistributedSharedMutex.hpp for details.
+ * \tparam Slots Number of reader slots, each taking one cache line. Threads
+ *               beyond it share slots in round-robin.
+ */
+template<std::size_t Slots = 32>
+class DistributedSharedMutex
+{
+    static_assert(Slots > 0, "DistributedSharedMutex needs at least one slot");
+
+public:
+    DistributedSharedMutex() noexcept
+        : writer(false)
+    {
+        for (auto& slot : slots) {
+            slot.readers.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    DistributedSharedMutex(const DistributedSharedMutex&) = delete;
+    DistributedSharedMutex& operator=(const DistributedSharedMutex&) = delete;
+
+    /** \brief Acquires the write lock, waits for current readers to leave. */
+    void lock()
+    {
+        std::uint_fast32_t count = 0;
+        while (!acquire_writer()) {
+            backoff(count);
+        }
+        count = 0;
+        while (readers() != 0) {
+            backoff(count);
+        }
+    }
+
+    /** \brief Tries to acquire the write lock without waiting. */
+    bool try_lock()
+    {
+        if (!acquire_writer()) {
+            return false;
+        }
+        if (readers() != 0) {
+            writer.store(false, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief Releases the write lock. */
+    void unlock()
+    { writer.store(false, std::memory_order_release); }
+
+    /** \brief Acquires a read lock, waits while a writer is present. */
+    void lock_shared()
+    {
+        std::uint_fast32_t count = 0;
+        while (!try_lock_shared()) {
+            while (writer.load(std::memory_order_relaxed)) {
+                backoff(count);
+            }
+        }
+    }
+
+    /**
+     * \brief Tries to acquire a read lock without waiting.
+     * \details Costs one atomic increment on the slot of the thread.
+     */
+    bool try_lock_shared()
+    {
+        std::atomic<std::intptr_t>& mine = slots[slot()].readers;
+        // Pairs with the flag store then slot loads of the writer: one of
+        // both sides always sees the other.
+        mine.fetch_add(1, std::memory_order_seq_cst);
+        if (!writer.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        mine.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    /**
+     * \brief Releases a read lock.
+     * \details
+     *   The lock may be released by another thread than the one which
+     *   acquired it, writers only consider the sum of the slots.
+     */
+    void unlock_shared()
+    { slots[slot()].readers.fetch_sub(1, std::memory_order_release); }
+
+    /** \brief Number of reader slots. */
+    static constexpr std::size_t slot_count() noexcept
+    { return Slots; }
+
+private:
+    enum : std::uint_fast32_t { SpinLimit = 1000 };
+
+    struct alignas(cache_line_size) Slot
+    {
+        std::atomic<std::intptr_t> readers;
+    };
+
+    /** Slot of the calling thread, given in round-robin at first use. */
+    static std::size_t slot() noexcept
+    {
+        static std::atomic<std::size_t> next(0);
+        static thread_local const std::size_t mine = next.fetch_add(1, std::memory_order_relaxed) % Slots;
+        return mine;
+    }
+
+    static void backoff(std::uint_fast32_t& count)
+    {
+        if (++count > SpinLimit) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool acquire_writer() noexcept
+    {
+        bool expected = false;
+        return writer.compare_exchange_strong(expected, true, std::memory_order_seq_cst);
+    }
+
+    /** Readers inside, readers leaving on another slot may make one negative. */
+    std::intptr_t readers() const noexcept
+    {
+        std::intptr_t sum = 0;
+        for (const auto& s : slots) {
+            sum += s.readers.load(std::memory_order_seq_cst);
+        }
+        return sum;
+    }
+
+    alignas(cache_line_size) std::atomic<bool> writer;
+    Slot slots[Slots];
+};
+
+/**
+ * \brief SafeSharedPtr locked by DistributedSharedMutex, for read-mostly
+ *        objects read from many cores.
+ */
+template<typename T, std::size_t Slots = 32>
+using DistributedSafeSharedPtr = SafeSharedPtr<T,
+                                               DistributedSharedMutex<Slots>,
+                                               SharedHolder<DistributedSharedMutex<Slots>>,
+                                               UniqueHolder<DistributedSharedMutex<Slots>>>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_DISTRIBUTEDSHAREDMUTEX_HPP
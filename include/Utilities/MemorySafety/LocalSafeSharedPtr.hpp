@@ -0,0 +1,282 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_LOCALSAFESHAREDPTR_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_LOCALSAFESHAREDPTR_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include "../Common.h"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file LocalSafeSharedPtr.hpp
+ * \brief Thread-confined handle of a Memory::SafeSharedPtr with non-atomic
+ *        reference counting.
+ * \details
+ *   Copying a Memory::SafeSharedPtr increments two atomic reference counts, of
+ *   the object and of its lock. When handles are copied a lot, e.g. passed by
+ *   value between stages of a pipeline, those cache lines bounce between the
+ *   cores touching the object, and copying gets slower as cores are added.
+ *
+ *   Memory::LocalSafeSharedPtr is the biased counterpart: the thread owning
+ *   it holds **one** SafeSharedPtr reference, and counts its own copies with
+ *   a plain integer. Copies, moves and destruction of local handles never
+ *   touch a shared cache line; only creating the first local handle and
+ *   destroying the last one adjust the atomic counts.\n
+ *   Other threads keep using the atomic path: to_shared() returns an ordinary
+ *   SafeSharedPtr to hand over, and the receiving thread may wrap it into its
+ *   own LocalSafeSharedPtr again.
+ *
+ *   Access to the object is unchanged, with the same read / write locking as
+ *   the SafeSharedPtr it was created from.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::LocalSafeSharedPtr<Frame> frame(Memory::make_shared<Frame>());
+ *   for (auto& stage : stages) {
+ *       stage(frame);                  // copied by value, no atomic operation
+ *   }
+ *   output.push(frame.to_shared());    // crosses threads as a SafeSharedPtr
+ *   ```
+ *
+ * \warning A LocalSafeSharedPtr and all its copies must only be copied,
+ *          assigned and destroyed by the thread which created it, checked by
+ *          assertion in debug builds. The object itself may still be shared
+ *          with any thread through to_shared().
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Thread-confined handle of a `SafeSharedPtr` whose copies are counted
+ *        without atomic operations, see LocalSafeSharedPtr.hpp for details.
+ * \tparam T            Type of the object managed by SafeSharedPtr.
+ * \tparam mutex_t      Type of the mutex used, default is shared_mutex_t.
+ * \tparam read_lock_t  Type of the read-lock used, default is shared_lock_t.
+ * \tparam write_lock_t Type of the write-lock used, default is unique_lock_t.
+ * \sa SafeSharedPtr
+ */
+template<typename T,
+         typename mutex_t = shared_mutex_t,
+         typename read_lock_t = shared_lock_t,
+         typename write_lock_t = unique_lock_t>
+class LocalSafeSharedPtr
+{
+public:
+    /** \brief Type of the handle shared across threads. */
+    using value_type = SafeSharedPtr<T, mutex_t, read_lock_t, write_lock_t>;
+    /** \brief Type of the managed object. */
+    using element_type = typename value_type::element_type;
+
+    /**
+     * \brief Default constructor, holds nothing.
+     */
+    constexpr LocalSafeSharedPtr() noexcept
+        : node(nullptr)
+    {}
+
+    /**
+     * \brief Takes over a `SafeSharedPtr` reference for the current thread.
+     * \param shared The handle to take, empty handles give an empty object.
+     * \exception std::bad_alloc If the local counter could not be allocated.
+     */
+    explicit LocalSafeSharedPtr(value_type shared)
+        : node(shared ? new Node(std::move(shared)) : nullptr)
+    {}
+
+    /**
+     * \brief Copy constructor, shares the object with a non-atomic increment.
+     * \param other Another local handle of the same thread.
+     */
+    LocalSafeSharedPtr(const LocalSafeSharedPtr& other) noexcept
+        : node(other.node)
+    { acquire(); }
+
+    /**
+     * \brief Move constructor, `other` is left empty.
+     * \param other Another local handle of the same thread.
+     */
+    LocalSafeSharedPtr(LocalSafeSharedPtr&& other) noexcept
+        : node(other.node)
+    { other.node = nullptr; }
+
+    /**
+     * \brief Destructor, releases the shared reference with the last copy.
+     */
+    ~LocalSafeSharedPtr()
+    { release(); }
+
+    /**
+     * \brief Copy assignment, shares the object of `other`.
+     * \param other Another local handle of the same thread.
+     * \return `*this`
+     */
+    LocalSafeSharedPtr& operator=(const LocalSafeSharedPtr& other) noexcept
+    {
+        LocalSafeSharedPtr(other).swap(*this);
+        return *this;
+    }
+
+    /**
+     * \brief Move assignment, `other` is left empty.
+     * \param other Another local handle of the same thread.
+     * \return `*this`
+     */
+    LocalSafeSharedPtr& operator=(LocalSafeSharedPtr&& other) noexcept
+    {
+        LocalSafeSharedPtr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    /**
+     * \brief Releases the object, `*this` becomes empty.
+     */
+    void reset() noexcept
+    { LocalSafeSharedPtr().swap(*this); }
+
+    /**
+     * \brief Exchanges the contents of `*this` and `other`.
+     * \param other Another local handle of the same thread.
+     */
+    void swap(LocalSafeSharedPtr& other) noexcept
+    { std::swap(node, other.node); }
+
+    /**
+     * \brief Returns a `SafeSharedPtr` sharing the object, to be handed over
+     *        to other threads.
+     * \return An ordinary handle, costs the usual atomic increments.
+     */
+    value_type to_shared() const
+    { return node ? node->shared : value_type(); }
+
+    /**
+     * \brief Returns the `SafeSharedPtr` held, to use its API without copying
+     *        it.
+     * \warning Must not be called on an empty object.
+     */
+    value_type& shared() noexcept
+    {
+        assert(node);
+        return node->shared;
+    }
+
+    /** \overload */
+    const value_type& shared() const noexcept
+    {
+        assert(node);
+        return node->shared;
+    }
+
+    /**
+     * \brief Returns the stored pointer without locking.
+     * \return The stored pointer, `nullptr` if empty.
+     */
+    element_type* get() const noexcept
+    { return node ? node->shared.get() : nullptr; }
+
+    /**
+     * \brief Accesses the object with **write lock**, forwarded to
+     *        SafeSharedPtr::operator->().
+     * \details Use `*ptr.shared()` for the equivalent of operator*, whose
+     *          helper cannot be forwarded by value before C++17.
+     */
+    value_type& operator->() noexcept
+    { return shared(); }
+
+    /**
+     * \brief Accesses the object with **read lock**, forwarded to
+     *        SafeSharedPtr::operator->().
+     */
+    const value_type& operator->() const noexcept
+    { return shared(); }
+
+    /**
+     * \brief Returns the number of local handles sharing the object on this
+     *        thread.
+     * \return Local copies, `0` if empty.
+     */
+    std::size_t local_count() const noexcept
+    { return node ? node->count : 0; }
+
+    /**
+     * \brief Returns the number of `SafeSharedPtr` references to the object,
+     *        counting all local copies of this thread as one.
+     * \return `SafeSharedPtr::use_count()`, `0` if empty.
+     */
+    long use_count() const noexcept
+    { return node ? node->shared.use_count() : 0; }
+
+    /**
+     * \brief Checks whether an object is managed.
+     */
+    explicit operator bool() const noexcept
+    { return node != nullptr; }
+
+private:
+    struct Node
+    {
+        explicit Node(value_type&& s)
+            : shared(std::move(s)),
+              count(1),
+              owner(std::this_thread::get_id())
+        {}
+
+        value_type shared;
+        std::size_t count;
+        std::thread::id owner;
+    };
+
+    void acquire() noexcept
+    {
+        if (node) {
+            assert(node->owner == std::this_thread::get_id());
+            ++node->count;
+        }
+    }
+
+    void release() noexcept
+    {
+        if (node) {
+            assert(node->owner == std::this_thread::get_id());
+            if (--node->count == 0) {
+                delete node;
+            }
+            node = nullptr;
+        }
+    }
+
+    Node* node;
+};
+
+/**
+ * \relates LocalSafeSharedPtr
+ * \brief Creates a new object held by a LocalSafeSharedPtr of the current
+ *        thread.
+ * \tparam T            Type of object to be created.
+ * \tparam SharedMutex  Type of the mutex used, default is shared_mutex_t.
+ * \tparam SharedLock   Type of the read-lock used, default is shared_lock_t.
+ * \tparam UniqueLock   Type of the write-lock used, default is unique_lock_t.
+ * \param args Arguments forwarded to the constructor of `T`.
+ * \return The new handle.
+ */
+template<typename T,
+         typename SharedMutex = shared_mutex_t,
+         typename SharedLock = shared_lock_t,
+         typename UniqueLock = unique_lock_t,
+         typename... Args>
+inline LocalSafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> make_local(Args&&... args)
+{
+    return LocalSafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>(
+        make_shared<T, SharedMutex, SharedLock, UniqueLock>(std::forward<Args>(args)...));
+}
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_LOCALSAFESHAREDPTR_HPP
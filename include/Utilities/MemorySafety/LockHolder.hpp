@@ -0,0 +1,262 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_LOCKHOLDER_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_LOCKHOLDER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "../Common.h"
+
+/**
+ * \file LockHolder.hpp
+ * \brief Generic RAII guards and timed locking for any read-write lock.
+ * \details
+ *   Memory::SharedHolder / Memory::UniqueHolder have the same interface as
+ *   RWSpinLock::ReadHolder / RWSpinLock::WriteHolder, but are usable with every
+ *   type providing `lock_shared()` / `unlock_shared()` and `lock()` /
+ *   `unlock()`, even before C++17 brings `std::shared_lock`.\n
+ *   Used as `read_lock_t` / `write_lock_t` of Memory::SafeSharedPtr for the
+ *   lock policies of this module.
+ *
+ *   Memory::TimedLocking gives every read-write lock a deadline, used by the
+ *   `try_read_until()` / `try_write_until()` family of Memory::SafeSharedPtr.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief RAII guard for read lock with Mutex::lock_shared() on construction
+ *        and Mutex::unlock_shared() on destruction.
+ * \tparam Mutex Type of the read-write lock.
+ */
+template<typename Mutex>
+class SharedHolder
+{
+public:
+    /** \brief Type of the lock guarded. */
+    using mutex_type = Mutex;
+
+    explicit SharedHolder(Mutex* lock = nullptr) : lock_(lock)
+    {
+        if (lock_) {
+            lock_->lock_shared();
+        }
+    }
+
+    /** \brief Takes over a lock already held by the caller. */
+    SharedHolder(Mutex& lock, std::adopt_lock_t) noexcept : lock_(&lock)
+    {}
+
+    explicit SharedHolder(Mutex& lock) : lock_(&lock)
+    {
+        lock_->lock_shared();
+    }
+
+    SharedHolder(SharedHolder&& other) noexcept : lock_(other.lock_)
+    {
+        other.lock_ = nullptr;
+    }
+
+    SharedHolder& operator=(SharedHolder&& other)
+    {
+        using std::swap;
+        swap(lock_, other.lock_);
+        return *this;
+    }
+
+    SharedHolder(const SharedHolder& other) = delete;
+    SharedHolder& operator=(const SharedHolder& other) = delete;
+
+    ~SharedHolder()
+    {
+        if (lock_) {
+            lock_->unlock_shared();
+        }
+    }
+
+    void reset(Mutex* lock = nullptr)
+    {
+        if (lock == lock_) {
+            return;
+        }
+        if (lock_) {
+            lock_->unlock_shared();
+        }
+        lock_ = lock;
+        if (lock_) {
+            lock_->lock_shared();
+        }
+    }
+
+    void swap(SharedHolder& other)
+    {
+        std::swap(lock_, other.lock_);
+    }
+
+    /** \brief Returns the lock guarded, or `nullptr`. */
+    Mutex* mutex() const noexcept
+    { return lock_; }
+
+private:
+    Mutex* lock_;
+};
+
+/**
+ * \brief RAII guard for write lock with Mutex::lock() on construction and
+ *        Mutex::unlock() on destruction.
+ * \tparam Mutex Type of the read-write lock.
+ */
+template<typename Mutex>
+class UniqueHolder
+{
+public:
+    /** \brief Type of the lock guarded. */
+    using mutex_type = Mutex;
+
+    explicit UniqueHolder(Mutex* lock = nullptr) : lock_(lock)
+    {
+        if (lock_) {
+            lock_->lock();
+        }
+    }
+
+    /** \brief Takes over a lock already held by the caller. */
+    UniqueHolder(Mutex& lock, std::adopt_lock_t) noexcept : lock_(&lock)
+    {}
+
+    explicit UniqueHolder(Mutex& lock) : lock_(&lock)
+    {
+        lock_->lock();
+    }
+
+    UniqueHolder(UniqueHolder&& other) noexcept : lock_(other.lock_)
+    {
+        other.lock_ = nullptr;
+    }
+
+    UniqueHolder& operator=(UniqueHolder&& other)
+    {
+        using std::swap;
+        swap(lock_, other.lock_);
+        return *this;
+    }
+
+    UniqueHolder(const UniqueHolder& other) = delete;
+    UniqueHolder& operator=(const UniqueHolder& other) = delete;
+
+    ~UniqueHolder()
+    {
+        if (lock_) {
+            lock_->unlock();
+        }
+    }
+
+    void reset(Mutex* lock = nullptr)
+    {
+        if (lock == lock_) {
+            return;
+        }
+        if (lock_) {
+            lock_->unlock();
+        }
+        lock_ = lock;
+        if (lock_) {
+            lock_->lock();
+        }
+    }
+
+    void swap(UniqueHolder& other)
+    {
+        std::swap(lock_, other.lock_);
+    }
+
+    /** \brief Returns the lock guarded, or `nullptr`. */
+    Mutex* mutex() const noexcept
+    { return lock_; }
+
+private:
+    Mutex* lock_;
+};
+
+/**
+ * \brief Acquires any read-write lock with a deadline.
+ * \details
+ *   Calls `try_lock_until()` / `try_lock_shared_until()` of the lock if it has
+ *   them, like `std::shared_timed_mutex` and RWSpinLock. Otherwise polls
+ *   `try_lock()` / `try_lock_shared()`, yielding the thread between attempts
+ *   after a short spin, until the deadline passes.
+ */
+class TimedLocking
+{
+public:
+    /**
+     * \brief Tries to lock `m` for writing until `deadline` passes.
+     * \return `true` if the lock was acquired.
+     */
+    template<typename Mutex, typename Clock, typename Duration>
+    static bool try_lock_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline)
+    { return lock_until(m, deadline, 0); }
+
+    /**
+     * \brief Tries to lock `m` for reading until `deadline` passes.
+     * \return `true` if the lock was acquired.
+     */
+    template<typename Mutex, typename Clock, typename Duration>
+    static bool try_lock_shared_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline)
+    { return lock_shared_until(m, deadline, 0); }
+
+private:
+    enum : std::uint_fast32_t { SpinLimit = 1000 };
+
+    template<typename Mutex, typename Clock, typename Duration>
+    static auto lock_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline, int)
+        -> decltype(bool(m.try_lock_until(deadline)))
+    { return m.try_lock_until(deadline); }
+
+    template<typename Mutex, typename Clock, typename Duration>
+    static bool lock_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline, long)
+    {
+        std::uint_fast32_t count = 0;
+        while (!m.try_lock()) {
+            if (Clock::now() >= deadline) {
+                return false;
+            }
+            if (++count > SpinLimit) {
+                std::this_thread::yield();
+            }
+        }
+        return true;
+    }
+
+    template<typename Mutex, typename Clock, typename Duration>
+    static auto lock_shared_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline, int)
+        -> decltype(bool(m.try_lock_shared_until(deadline)))
+    { return m.try_lock_shared_until(deadline); }
+
+    template<typename Mutex, typename Clock, typename Duration>
+    static bool lock_shared_until(Mutex& m, const std::chrono::time_point<Clock, Duration>& deadline, long)
+    {
+        std::uint_fast32_t count = 0;
+        while (!m.try_lock_shared()) {
+            if (Clock::now() >= deadline) {
+                return false;
+            }
+            if (++count > SpinLimit) {
+                std::this_thread::yield();
+            }
+        }
+        return true;
+    }
+};
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_LOCKHOLDER_HPP
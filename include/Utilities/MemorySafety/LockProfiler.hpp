@@ -0,0 +1,779 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_LOCKPROFILER_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_LOCKPROFILER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../Common.h"
+#include "SafeSharedPtr.hpp"
+#include "LockHolder.hpp"
+
+/**
+ * \file LockProfiler.hpp
+ * \brief Opt-in contention profiling for the locks of Memory::SafeSharedPtr.
+ * \details
+ *   Memory::ProfiledLock wraps any read-write lock and records, split by
+ *   shared and exclusive mode:
+ *     - number of acquisitions;
+ *     - number of contended acquisitions, which could not get the lock at the
+ *       first attempt;
+ *     - spin iterations before success, for locks reporting them such as
+ *       RWSpinLock::lock(uint_fast32_t&);
+ *     - log2 histograms of wait time and hold time in nanoseconds.
+ *
+ *   Without a `Site` tag every lock instance has its own Memory::LockStats,
+ *   named after its address. With a `Site` tag all locks of that tag share one
+ *   Memory::LockStats named `Site::name()`, which aggregates per call site or
+ *   per subsystem.\n
+ *   All statistics alive are registered in Memory::LockProfiler, which dumps
+ *   them as text and can record a bounded buffer of acquisitions for the
+ *   Chrome trace-event viewer (`chrome://tracing`, Perfetto).
+ *
+ *   -------------------------------------------------------------------
+ *
+ *   **Overhead**
+ *
+ *   Only objects using Memory::ProfiledLock pay for profiling, other locks
+ *   are untouched. Defining `UTILITIES_DISABLE_LOCK_PROFILING` before
+ *   including this file turns `ProfiledLock<Mutex, Site>` into `Mutex`
+ *   itself, so profiled locks cost exactly what the plain ones do. Profiled
+ *   pointers keep their own type though: `ProfiledSafeSharedPtr<T, Mutex>`
+ *   then names `SafeSharedPtr<T, Mutex, SharedHolder<Mutex>,
+ *   UniqueHolder<Mutex>>`, which is not `SafeSharedPtr<T>` and does not
+ *   convert to it.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   struct CacheSite { static const char* name() { return "cache"; } };
+ *   Memory::ProfiledSafeSharedPtr<Cache, Memory::shared_mutex_t, CacheSite> cache(new Cache);
+ *   Memory::LockProfiler::instance().start_tracing();
+ *   // ... run workload ...
+ *   Memory::LockProfiler::instance().dump(std::cout);
+ *   std::ofstream trace("locks.json");
+ *   Memory::LockProfiler::instance().write_chrome_trace(trace);
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/** \brief Mode of a lock acquisition. */
+enum class LockMode : int
+{
+    Shared = 0,
+    Exclusive = 1
+};
+
+/**
+ * \brief Lock-free histogram of durations with power-of-two buckets.
+ * \details
+ *   Bucket `0` counts durations below 2ns, bucket `i` counts durations in
+ *   `[2^i, 2^(i+1))` ns, and the last bucket counts everything longer.
+ */
+class LockHistogram
+{
+public:
+    /** \brief Number of buckets. */
+    enum : std::size_t { Buckets = 32 };
+
+    LockHistogram() noexcept
+    { reset(); }
+
+    LockHistogram(const LockHistogram&) = delete;
+    LockHistogram& operator=(const LockHistogram&) = delete;
+
+    /** \brief Records one duration of `ns` nanoseconds. */
+    void record(std::uint64_t ns) noexcept
+    { counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed); }
+
+    /** \brief Returns the number of durations recorded in bucket `i`. */
+    std::uint64_t count(std::size_t i) const noexcept
+    { return counts[i].load(std::memory_order_relaxed); }
+
+    /** \brief Returns the number of durations recorded. */
+    std::uint64_t total() const noexcept
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < Buckets; ++i) {
+            sum += count(i);
+        }
+        return sum;
+    }
+
+    /**
+     * \brief Returns an upper bound in nanoseconds of the `p`-th quantile.
+     * \param p Quantile in `[0, 1]`, e.g. `0.99`.
+     * \return Upper bound of the bucket holding the quantile, `0` if empty.
+     */
+    std::uint64_t percentile(double p) const noexcept
+    {
+        const std::uint64_t all = total();
+        if (all == 0) {
+            return 0;
+        }
+        const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(p * all + 0.5));
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < Buckets; ++i) {
+            seen += count(i);
+            if (seen >= rank) {
+                return upper_bound(i);
+            }
+        }
+        return upper_bound(Buckets - 1);
+    }
+
+    /** \brief Clears all buckets. */
+    void reset() noexcept
+    {
+        for (std::size_t i = 0; i < Buckets; ++i) {
+            counts[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /** \brief Returns the bucket a duration of `ns` nanoseconds falls in. */
+    static std::size_t bucket(std::uint64_t ns) noexcept
+    {
+        std::size_t i = 0;
+        while (ns > 1 && i + 1 < Buckets) {
+            ns >>= 1;
+            ++i;
+        }
+        return i;
+    }
+
+    /** \brief Returns the largest duration in nanoseconds of bucket `i`. */
+    static std::uint64_t upper_bound(std::size_t i) noexcept
+    { return i + 1 < Buckets ? (std::uint64_t(1) << (i + 1)) - 1 : ~std::uint64_t(0); }
+
+private:
+    std::atomic<std::uint64_t> counts[Buckets];
+};
+
+/**
+ * \brief Statistics of one profiled lock or call site, registered in
+ *        LockProfiler for its whole lifetime.
+ * \sa ProfiledLock
+ */
+class LockStats
+{
+public:
+    /** \brief Statistics of one LockMode. */
+    struct Counters
+    {
+        /** \brief Number of acquisitions. */
+        std::atomic<std::uint64_t> acquisitions{0};
+        /** \brief Number of acquisitions failing at the first attempt. */
+        std::atomic<std::uint64_t> contended{0};
+        /** \brief Failed attempts summed over all acquisitions. */
+        std::atomic<std::uint64_t> spins{0};
+        /** \brief Time from the request until the lock was acquired. */
+        LockHistogram wait;
+        /** \brief Time from acquisition until release. */
+        LockHistogram hold;
+    };
+
+    /**
+     * \brief Constructs statistics named `name` and registers them in
+     *        LockProfiler::instance().
+     */
+    explicit LockStats(std::string name);
+
+    /** \brief Unregisters from LockProfiler::instance(). */
+    ~LockStats();
+
+    LockStats(const LockStats&) = delete;
+    LockStats& operator=(const LockStats&) = delete;
+
+    /** \brief Returns the name given on construction. */
+    const std::string& name() const noexcept
+    { return *name_; }
+
+    /** \brief Returns the statistics of `mode`. */
+    const Counters& counters(LockMode mode) const noexcept
+    { return counters_[static_cast<int>(mode)]; }
+
+    /**
+     * \brief Records one acquisition.
+     * \param mode      Mode acquired.
+     * \param contended Whether the first attempt failed.
+     * \param spins     Failed attempts before success.
+     * \param wait      Nanoseconds spent waiting.
+     */
+    void acquired(LockMode mode, bool contended, std::uint64_t spins, std::uint64_t wait) noexcept
+    {
+        Counters& c = counters_[static_cast<int>(mode)];
+        c.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (contended) {
+            c.contended.fetch_add(1, std::memory_order_relaxed);
+            c.spins.fetch_add(spins, std::memory_order_relaxed);
+        }
+        c.wait.record(wait);
+    }
+
+    /**
+     * \brief Records one release, and a trace event if tracing.
+     * \param mode  Mode released.
+     * \param start Timestamp of the request, see LockProfiler::now().
+     * \param wait  Nanoseconds spent waiting.
+     * \param hold  Nanoseconds the lock was held.
+     */
+    void released(LockMode mode, std::uint64_t start, std::uint64_t wait, std::uint64_t hold);
+
+    /** \brief Clears all statistics. */
+    void reset() noexcept
+    {
+        for (Counters& c : counters_) {
+            c.acquisitions.store(0, std::memory_order_relaxed);
+            c.contended.store(0, std::memory_order_relaxed);
+            c.spins.store(0, std::memory_order_relaxed);
+            c.wait.reset();
+            c.hold.reset();
+        }
+    }
+
+private:
+    friend class LockProfiler;
+
+    std::shared_ptr<const std::string> name_;
+    Counters counters_[2];
+};
+
+#ifndef UTILITIES_DISABLE_LOCK_PROFILING
+template<typename Mutex, typename Site>
+class ProfiledLock;
+#endif
+
+/**
+ * \brief Global registry of LockStats, with text dump and Chrome trace-event
+ *        export.
+ */
+class LockProfiler
+{
+public:
+    /** \brief One acquisition recorded while tracing. */
+    struct TraceEvent
+    {
+        /** \brief Name of the LockStats. */
+        std::shared_ptr<const std::string> name;
+        /** \brief Mode acquired. */
+        LockMode mode;
+        /** \brief Small index of the thread, see thread_index(). */
+        std::uint32_t thread;
+        /** \brief Timestamp of the request, see now(). */
+        std::uint64_t start;
+        /** \brief Nanoseconds spent waiting. */
+        std::uint64_t wait;
+        /** \brief Nanoseconds the lock was held. */
+        std::uint64_t hold;
+    };
+
+    /** \brief Returns the process-wide profiler. */
+    static LockProfiler& instance()
+    {
+        static LockProfiler profiler;
+        return profiler;
+    }
+
+    /** \brief Returns a monotonic timestamp in nanoseconds. */
+    static std::uint64_t now() noexcept
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /** \brief Returns a small number identifying the calling thread, from 1. */
+    static std::uint32_t thread_index() noexcept
+    {
+        static std::atomic<std::uint32_t> next(0);
+        thread_local std::uint32_t index = next.fetch_add(1, std::memory_order_relaxed) + 1;
+        return index;
+    }
+
+    /**
+     * \brief Returns the statistics shared by all locks tagged `Site`.
+     * \tparam Site Type with a `static const char* name()`.
+     */
+    template<typename Site>
+    static LockStats& site()
+    {
+        static LockStats stats(Site::name());
+        return stats;
+    }
+
+    /**
+     * \brief Calls `f(const LockStats&)` for every registered LockStats.
+     * \note Locks being created or destroyed wait until `f` returns.
+     */
+    template<typename F>
+    void for_each(F f) const
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        for (const LockStats* stats : locks) {
+            f(*stats);
+        }
+    }
+
+    /**
+     * \brief Writes a human-readable summary of all registered LockStats.
+     * \details
+     *   Durations are upper bounds of histogram buckets, in nanoseconds.
+     */
+    void dump(std::ostream& os) const
+    {
+        for_each([&os](const LockStats& stats) {
+            os << stats.name() << '\n';
+            for (int m = 0; m < 2; ++m) {
+                const LockStats::Counters& c = stats.counters(static_cast<LockMode>(m));
+                const std::uint64_t acquisitions = c.acquisitions.load(std::memory_order_relaxed);
+                if (acquisitions == 0) {
+                    continue;
+                }
+                const std::uint64_t contended = c.contended.load(std::memory_order_relaxed);
+                os << (m == static_cast<int>(LockMode::Shared) ? "  shared   " : "  exclusive")
+                   << " acquisitions " << acquisitions
+                   << " contended " << contended
+                   << " (" << (100.0 * contended / acquisitions) << "%)"
+                   << " spins " << c.spins.load(std::memory_order_relaxed)
+                   << " wait(ns) p50 " << c.wait.percentile(0.5)
+                   << " p99 " << c.wait.percentile(0.99)
+                   << " max " << c.wait.percentile(1.0)
+                   << " hold(ns) p50 " << c.hold.percentile(0.5)
+                   << " p99 " << c.hold.percentile(0.99)
+                   << " max " << c.hold.percentile(1.0) << '\n';
+            }
+        });
+    }
+
+    /**
+     * \brief Starts recording acquisitions for write_chrome_trace().
+     * \param capacity Maximal number of events kept, later ones are dropped
+     *                 and counted in dropped_events().
+     */
+    void start_tracing(std::size_t capacity = 64 * 1024)
+    {
+        std::lock_guard<std::mutex> guard(traceMutex);
+        traceCapacity = capacity;
+        events.reserve(std::min<std::size_t>(capacity, 4096));
+        tracingEnabled.store(true, std::memory_order_relaxed);
+    }
+
+    /** \brief Stops recording acquisitions, events recorded are kept. */
+    void stop_tracing() noexcept
+    { tracingEnabled.store(false, std::memory_order_relaxed); }
+
+    /** \brief Returns whether acquisitions are being recorded. */
+    bool tracing() const noexcept
+    { return tracingEnabled.load(std::memory_order_relaxed); }
+
+    /** \brief Returns a copy of the events recorded. */
+    std::vector<TraceEvent> trace_events() const
+    {
+        std::lock_guard<std::mutex> guard(traceMutex);
+        return events;
+    }
+
+    /** \brief Returns the number of events dropped for lack of capacity. */
+    std::size_t dropped_events() const
+    {
+        std::lock_guard<std::mutex> guard(traceMutex);
+        return dropped;
+    }
+
+    /**
+     * \brief Writes the events recorded in the Chrome trace-event JSON format.
+     * \details
+     *   Every acquisition becomes a complete event (`"ph":"X"`) for the time
+     *   held, preceded by a `"<name> (wait)"` event if it had to wait.
+     *   Timestamps are in microseconds since the earliest event.
+     */
+    void write_chrome_trace(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> guard(traceMutex);
+        std::uint64_t origin = ~std::uint64_t(0);
+        for (const TraceEvent& event : events) {
+            origin = std::min(origin, event.start);
+        }
+        const auto micros = [](std::uint64_t ns) -> std::string {
+            std::ostringstream s;
+            s << ns / 1000 << '.' << static_cast<char>('0' + ns / 100 % 10)
+              << static_cast<char>('0' + ns / 10 % 10) << static_cast<char>('0' + ns % 10);
+            return s.str();
+        };
+        const auto write = [&](const TraceEvent& event, bool wait, bool first) {
+            os << (first ? "\n" : ",\n") << "{\"name\":\"";
+            write_json(os, *event.name);
+            os << (wait ? " (wait)" : "") << "\",\"cat\":\"lock\",\"ph\":\"X\",\"pid\":1"
+               << ",\"tid\":" << event.thread
+               << ",\"ts\":" << micros(event.start - origin + (wait ? 0 : event.wait))
+               << ",\"dur\":" << micros(wait ? event.wait : event.hold)
+               << ",\"args\":{\"mode\":\""
+               << (event.mode == LockMode::Shared ? "shared" : "exclusive") << "\"}}";
+        };
+        os << "{\"traceEvents\":[";
+        bool first = true;
+        for (const TraceEvent& event : events) {
+            if (event.wait > 0) {
+                write(event, true, first);
+                first = false;
+            }
+            write(event, false, first);
+            first = false;
+        }
+        os << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << dropped << "}}\n";
+    }
+
+    /** \brief Clears the statistics of all registered locks and all events. */
+    void reset()
+    {
+        for_each([](const LockStats& stats) { const_cast<LockStats&>(stats).reset(); });
+        std::lock_guard<std::mutex> guard(traceMutex);
+        events.clear();
+        dropped = 0;
+    }
+
+private:
+#ifndef UTILITIES_DISABLE_LOCK_PROFILING
+    template<typename Mutex, typename Site>
+    friend class ProfiledLock;
+#endif
+    friend class LockStats;
+
+    /** Shared acquisitions of one thread, for measuring their hold time. */
+    struct SharedStack
+    {
+        enum : std::size_t { Capacity = 16 };
+        struct Entry
+        {
+            const void* lock;
+            std::uint64_t start;
+            std::uint64_t acquired;
+        };
+        Entry entries[Capacity];
+        std::size_t size = 0;
+    };
+
+    LockProfiler() = default;
+
+    static SharedStack& shared_stack() noexcept
+    {
+        thread_local SharedStack stack;
+        return stack;
+    }
+
+    static void push_shared(const void* lock, std::uint64_t start, std::uint64_t acquired) noexcept
+    {
+        SharedStack& stack = shared_stack();
+        if (stack.size < SharedStack::Capacity) {
+            stack.entries[stack.size++] = SharedStack::Entry{lock, start, acquired};
+        }
+    }
+
+    static bool pop_shared(const void* lock, std::uint64_t& start, std::uint64_t& acquired) noexcept
+    {
+        SharedStack& stack = shared_stack();
+        for (std::size_t i = stack.size; i > 0; --i) {
+            if (stack.entries[i - 1].lock == lock) {
+                start = stack.entries[i - 1].start;
+                acquired = stack.entries[i - 1].acquired;
+                std::copy(stack.entries + i, stack.entries + stack.size, stack.entries + i - 1);
+                --stack.size;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void write_json(std::ostream& os, const std::string& s)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (const char ch : s) {
+            const unsigned char c = static_cast<unsigned char>(ch);
+            if (c == '"' || c == '\\') {
+                os << '\\' << ch;
+            } else if (c < 0x20) {
+                os << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+            } else {
+                os << ch;
+            }
+        }
+    }
+
+    void add(LockStats* stats)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        locks.push_back(stats);
+    }
+
+    void remove(LockStats* stats)
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        locks.erase(std::remove(locks.begin(), locks.end(), stats), locks.end());
+    }
+
+    void trace(TraceEvent&& event)
+    {
+        std::lock_guard<std::mutex> guard(traceMutex);
+        if (events.size() < traceCapacity) {
+            events.push_back(std::move(event));
+        } else {
+            ++dropped;
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::vector<LockStats*> locks;
+    std::atomic<bool> tracingEnabled{false};
+    mutable std::mutex traceMutex;
+    std::vector<TraceEvent> events;
+    std::size_t traceCapacity = 0;
+    std::size_t dropped = 0;
+};
+
+inline LockStats::LockStats(std::string name)
+    : name_(std::make_shared<const std::string>(std::move(name)))
+{ LockProfiler::instance().add(this); }
+
+inline LockStats::~LockStats()
+{ LockProfiler::instance().remove(this); }
+
+inline void LockStats::released(LockMode mode, std::uint64_t start, std::uint64_t wait, std::uint64_t hold)
+{
+    counters_[static_cast<int>(mode)].hold.record(hold);
+    LockProfiler& profiler = LockProfiler::instance();
+    if (profiler.tracing()) {
+        profiler.trace(LockProfiler::TraceEvent{name_, mode, LockProfiler::thread_index(), start, wait, hold});
+    }
+}
+
+#ifdef UTILITIES_DISABLE_LOCK_PROFILING
+template<typename Mutex, typename Site = void>
+using ProfiledLock = Mutex;
+#else
+/**
+ * \brief Read-write lock recording its contention in a LockStats, see
+ *        LockProfiler.hpp for details.
+ * \tparam Mutex Type of the read-write lock wrapped.
+ * \tparam Site  `void` for statistics per lock instance, otherwise a type with
+ *               `static const char* name()` whose locks share statistics.
+ * \details
+ *   If `Mutex` provides `lock(uint_fast32_t&)` / `lock_shared(uint_fast32_t&)`
+ *   reporting its failed attempts, like RWSpinLock, the spins are recorded;
+ *   otherwise an acquisition is contended if `try_lock()` /
+ *   `try_lock_shared()` fails before blocking.\n
+ *   Shared hold times are tracked per thread, for up to 16 shared locks held
+ *   at once by one thread; further ones only count their acquisition.
+ * \sa ProfiledSafeSharedPtr
+ */
+template<typename Mutex, typename Site = void>
+class ProfiledLock
+{
+public:
+    /** \brief Type of the lock wrapped. */
+    using mutex_type = Mutex;
+
+    /** \brief Constructs an unlocked lock, named after its address. */
+    ProfiledLock()
+        : ProfiledLock(std::string())
+    {}
+
+    /**
+     * \brief Constructs an unlocked lock.
+     * \param name Name of the statistics if `Site` is `void`, ignored
+     *             otherwise.
+     */
+    explicit ProfiledLock(std::string name)
+        : stats_(init(std::move(name), std::is_void<Site>()))
+    {}
+
+    ProfiledLock(const ProfiledLock&) = delete;
+    ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    /** \brief Acquires exclusive ownership. */
+    void lock()
+    {
+        const std::uint64_t start = LockProfiler::now();
+        std::uint_fast32_t spins = 0;
+        const bool contended = acquire(spins, CountsSpins<Mutex>());
+        const std::uint64_t acquired = LockProfiler::now();
+        stats_->acquired(LockMode::Exclusive, contended, spins, acquired - start);
+        exclusiveStart = start;
+        exclusiveAcquired = acquired;
+    }
+
+    /** \brief Tries to acquire exclusive ownership without blocking. */
+    bool try_lock()
+    {
+        const std::uint64_t start = LockProfiler::now();
+        if (!mutex_.try_lock()) {
+            return false;
+        }
+        stats_->acquired(LockMode::Exclusive, false, 0, 0);
+        exclusiveStart = start;
+        exclusiveAcquired = start;
+        return true;
+    }
+
+    /** \brief Releases exclusive ownership. */
+    void unlock()
+    {
+        const std::uint64_t start = exclusiveStart;
+        const std::uint64_t acquired = exclusiveAcquired;
+        const std::uint64_t released = LockProfiler::now();
+        mutex_.unlock();
+        stats_->released(LockMode::Exclusive, start, acquired - start, released - acquired);
+    }
+
+    /** \brief Acquires shared ownership. */
+    void lock_shared()
+    {
+        const std::uint64_t start = LockProfiler::now();
+        std::uint_fast32_t spins = 0;
+        const bool contended = acquire_shared(spins, CountsSharedSpins<Mutex>());
+        const std::uint64_t acquired = LockProfiler::now();
+        stats_->acquired(LockMode::Shared, contended, spins, acquired - start);
+        LockProfiler::push_shared(this, start, acquired);
+    }
+
+    /** \brief Tries to acquire shared ownership without blocking. */
+    bool try_lock_shared()
+    {
+        const std::uint64_t start = LockProfiler::now();
+        if (!mutex_.try_lock_shared()) {
+            return false;
+        }
+        stats_->acquired(LockMode::Shared, false, 0, 0);
+        LockProfiler::push_shared(this, start, start);
+        return true;
+    }
+
+    /** \brief Releases shared ownership. */
+    void unlock_shared()
+    {
+        const std::uint64_t released = LockProfiler::now();
+        std::uint64_t start = 0;
+        std::uint64_t acquired = 0;
+        const bool tracked = LockProfiler::pop_shared(this, start, acquired);
+        mutex_.unlock_shared();
+        if (tracked) {
+            stats_->released(LockMode::Shared, start, acquired - start, released - acquired);
+        }
+    }
+
+    /** \brief Returns the lock wrapped. */
+    Mutex& native() noexcept
+    { return mutex_; }
+
+    /** \brief Returns the statistics recorded into. */
+    LockStats& stats() const noexcept
+    { return *stats_; }
+
+private:
+    template<typename M, typename = void>
+    struct CountsSpins : std::false_type {};
+    template<typename M>
+    struct CountsSpins<M, decltype(std::declval<M&>().lock(std::declval<std::uint_fast32_t&>()))>
+        : std::true_type {};
+    template<typename M, typename = void>
+    struct CountsSharedSpins : std::false_type {};
+    template<typename M>
+    struct CountsSharedSpins<M, decltype(std::declval<M&>().lock_shared(std::declval<std::uint_fast32_t&>()))>
+        : std::true_type {};
+
+    bool acquire(std::uint_fast32_t& spins, std::true_type)
+    {
+        mutex_.lock(spins);
+        return spins != 0;
+    }
+
+    bool acquire(std::uint_fast32_t&, std::false_type)
+    {
+        if (mutex_.try_lock()) {
+            return false;
+        }
+        mutex_.lock();
+        return true;
+    }
+
+    bool acquire_shared(std::uint_fast32_t& spins, std::true_type)
+    {
+        mutex_.lock_shared(spins);
+        return spins != 0;
+    }
+
+    bool acquire_shared(std::uint_fast32_t&, std::false_type)
+    {
+        if (mutex_.try_lock_shared()) {
+            return false;
+        }
+        mutex_.lock_shared();
+        return true;
+    }
+
+    LockStats* init(std::string, std::false_type)
+    { return &LockProfiler::site<Site>(); }
+
+    LockStats* init(std::string name, std::true_type)
+    {
+        if (name.empty()) {
+            std::ostringstream os;
+            os << "ProfiledLock@" << static_cast<const void*>(this);
+            name = os.str();
+        }
+        owned.reset(new LockStats(std::move(name)));
+        return owned.get();
+    }
+
+    Mutex mutex_;
+    std::unique_ptr<LockStats> owned;
+    LockStats* stats_;
+    std::uint64_t exclusiveStart = 0;
+    std::uint64_t exclusiveAcquired = 0;
+};
+#endif
+
+/**
+ * \brief SafeSharedPtr whose lock is profiled by ProfiledLock.
+ * \tparam T     Type of the object managed.
+ * \tparam Mutex Type of the read-write lock wrapped, default is
+ *               shared_mutex_t.
+ * \tparam Site  `void` for statistics per object, otherwise a type with
+ *               `static const char* name()` whose objects share statistics.
+ */
+template<typename T, typename Mutex = shared_mutex_t, typename Site = void>
+using ProfiledSafeSharedPtr = SafeSharedPtr<T,
+                                            ProfiledLock<Mutex, Site>,
+                                            SharedHolder<ProfiledLock<Mutex, Site>>,
+                                            UniqueHolder<ProfiledLock<Mutex, Site>>>;
+
+/**
+ * \relates ProfiledSafeSharedPtr
+ * \brief Same as make_shared(), with a ProfiledLock.
+ */
+template<typename T, typename Mutex = shared_mutex_t, typename Site = void, typename... Args>
+inline ProfiledSafeSharedPtr<T, Mutex, Site> make_profiled(Args&&... args)
+{
+    return make_shared<T,
+                       ProfiledLock<Mutex, Site>,
+                       SharedHolder<ProfiledLock<Mutex, Site>>,
+                       UniqueHolder<ProfiledLock<Mutex, Site>>>(std::forward<Args>(args)...);
+}
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_LOCKPROFILER_HPP
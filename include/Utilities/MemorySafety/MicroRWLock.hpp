@@ -0,0 +1,328 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_MICRORWLOCK_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_MICRORWLOCK_HPP
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include "../Common.h"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+
+/**
+ * \file MicroRWLock.hpp
+ * \brief Read-write spin locks smaller than a word, packed into bits of the
+ *        caller's data.
+ * \details
+ *   Where memory matters more than contention, e.g. one lock per node of a
+ *   large graph, even the 4 bytes of Memory::RWSpinLock are too much:
+ *     - Memory::MicroRWLockBits packs a lock into `Bits` bits of an atomic
+ *       word supplied by the caller. The other bits of the word are never
+ *       changed by the lock, and stay free for the caller's flags.
+ *     - Memory::MicroRWLock is a lock of a single byte.
+ *     - Memory::PackedLockPtr keeps a lock in the low bits of a pointer, which
+ *       are always zero for aligned objects: pointer and lock take one word.
+ *
+ *   In `Bits` bits, the lowest flags the writer and the others count up to
+ *   `2^(Bits - 1) - 1` readers, further readers spin until one leaves.
+ *   Readers are preferred, as with RWSpinLock.
+ *
+ *   The opposite trade-off, one lock per cache line against false sharing,
+ *   is served by CacheLinePadded.hpp.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   struct Node
+ *   {
+ *       // Bits 0-7 lock the node, 8-31 are node flags.
+ *       std::atomic<uint32_t> state;
+ *       Memory::PackedLockPtr<Node> next;   // 8 bytes, locks the link
+ *   };
+ *   using NodeLock = Memory::MicroRWLockBits<uint32_t, 0, 8>;
+ *
+ *   NodeLock::lock_shared(node.state);
+ *   read(node);
+ *   NodeLock::unlock_shared(node.state);
+ *
+ *   Memory::PackedLockPtr<Node>::WriteHolder writer(node.next);
+ *   node.next.reset(inserted);
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write spin lock in bits `[Shift, Shift + Bits)` of an atomic
+ *        word, see MicroRWLock.hpp for details.
+ * \tparam Word  Unsigned integer type of the word.
+ * \tparam Shift Position of the lowest bit of the lock.
+ * \tparam Bits  Number of bits of the lock, at least 2.
+ * \details Only the bits of the lock are changed, the others may be updated
+ *          concurrently by the caller.
+ */
+template<typename Word, unsigned Shift = 0, unsigned Bits = 8>
+struct MicroRWLockBits
+{
+    static_assert(std::is_unsigned<Word>::value, "MicroRWLockBits needs an unsigned word");
+    static_assert(Bits >= 2, "MicroRWLockBits needs a writer bit and a reader bit at least");
+    static_assert(Shift + Bits <= std::numeric_limits<Word>::digits, "MicroRWLockBits exceeds its word");
+
+    /** \brief Bits of the word used by the lock. */
+    static constexpr Word Mask = Word((Word(~Word(0)) >> (std::numeric_limits<Word>::digits - Bits)) << Shift);
+    /** \brief Bit of the writer. */
+    static constexpr Word Writer = Word(Word(1) << Shift);
+    /** \brief Count of one reader. */
+    static constexpr Word Reader = Word(Word(2) << Shift);
+
+    /** \brief Maximum number of concurrent readers. */
+    static constexpr std::size_t max_readers() noexcept
+    { return (std::size_t(1) << (Bits - 1)) - 1; }
+
+    /** \brief Acquires the write lock. */
+    static void lock(std::atomic<Word>& word)
+    {
+        uint_fast32_t count = 0;
+        while (!try_lock(word)) {
+            // Only reads while held, so waiting does not steal the line.
+            while (word.load(std::memory_order_relaxed) & Mask) {
+                backoff(count);
+            }
+        }
+    }
+
+    /** \brief Acquires the write lock if free. */
+    static bool try_lock(std::atomic<Word>& word)
+    {
+        Word old = word.load(std::memory_order_relaxed);
+        while (!(old & Mask)) {
+            if (word.compare_exchange_weak(old, Word(old | Writer), std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** \brief Releases the write lock. */
+    static void unlock(std::atomic<Word>& word)
+    {
+        assert(word.load(std::memory_order_relaxed) & Writer);
+        word.fetch_and(Word(~Writer), std::memory_order_release);
+    }
+
+    /** \brief Acquires a read lock. */
+    static void lock_shared(std::atomic<Word>& word)
+    {
+        uint_fast32_t count = 0;
+        while (!try_lock_shared(word)) {
+            backoff(count);
+        }
+    }
+
+    /** \brief Acquires a read lock if no writer holds it, and a reader count
+     *         is left. */
+    static bool try_lock_shared(std::atomic<Word>& word)
+    {
+        Word old = word.load(std::memory_order_relaxed);
+        while (!(old & Writer) && (old & Mask) != Word(Mask & ~Writer)) {
+            if (word.compare_exchange_weak(old, Word(old + Reader), std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** \brief Releases a read lock. */
+    static void unlock_shared(std::atomic<Word>& word)
+    {
+        assert(word.load(std::memory_order_relaxed) & Mask & ~Writer);
+        word.fetch_sub(Reader, std::memory_order_release);
+    }
+
+private:
+    static void backoff(uint_fast32_t& count)
+    {
+        cpu_relax();
+        if ((++count & 1023) == 0) {
+            std::this_thread::yield();
+        }
+    }
+};
+
+template<typename Word, unsigned Shift, unsigned Bits>
+constexpr Word MicroRWLockBits<Word, Shift, Bits>::Mask;
+template<typename Word, unsigned Shift, unsigned Bits>
+constexpr Word MicroRWLockBits<Word, Shift, Bits>::Writer;
+template<typename Word, unsigned Shift, unsigned Bits>
+constexpr Word MicroRWLockBits<Word, Shift, Bits>::Reader;
+
+/**
+ * \brief Read-write spin lock of one byte, for up to 127 readers.
+ * \details Usable wherever RWSpinLock is, at a quarter of its size.
+ */
+class MicroRWLock
+{
+    using Bits = MicroRWLockBits<uint8_t>;
+
+public:
+    /** \brief RAII guard of a read lock. */
+    using ReadHolder = SharedHolder<MicroRWLock>;
+    /** \brief RAII guard of the write lock. */
+    using WriteHolder = UniqueHolder<MicroRWLock>;
+
+    constexpr MicroRWLock() noexcept
+        : bits_(0)
+    {}
+
+    MicroRWLock(const MicroRWLock&) = delete;
+    MicroRWLock& operator=(const MicroRWLock&) = delete;
+
+    void lock()
+    { Bits::lock(bits_); }
+
+    bool try_lock()
+    { return Bits::try_lock(bits_); }
+
+    void unlock()
+    { Bits::unlock(bits_); }
+
+    void lock_shared()
+    { Bits::lock_shared(bits_); }
+
+    bool try_lock_shared()
+    { return Bits::try_lock_shared(bits_); }
+
+    void unlock_shared()
+    { Bits::unlock_shared(bits_); }
+
+    /** \brief State of the lock, for debugging. */
+    uint8_t bits() const noexcept
+    { return bits_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<uint8_t> bits_;
+};
+
+/**
+ * \brief Pointer to `T` with a read-write spin lock in its low bits, see
+ *        MicroRWLock.hpp for details.
+ * \tparam T    Type of the object pointed to, may be incomplete where the
+ *              pointer is declared, e.g. a member of `T` itself.
+ * \tparam Bits Number of bits of the lock, at most `log2(alignof(T))`, which
+ *              is the default (up to 8). Objects aligned to 8 bytes give 3
+ *              bits, i.e. 3 concurrent readers: align `T` further for more.
+ * \details
+ *   The lock guards whatever the caller decides, usually the pointer itself
+ *   and the object pointed to. get() and reset() never touch the lock bits.
+ */
+template<typename T, unsigned Bits = 0>
+class PackedLockPtr
+{
+    // Deferred to the member bodies, where `T` is complete.
+    template<typename U>
+    static constexpr unsigned lock_bits() noexcept
+    {
+        return Bits ? Bits
+               : alignof(U) >= 256 ? 8
+               : alignof(U) >= 128 ? 7
+               : alignof(U) >= 64  ? 6
+               : alignof(U) >= 32  ? 5
+               : alignof(U) >= 16  ? 4
+               : alignof(U) >= 8   ? 3
+               : alignof(U) >= 4   ? 2
+                                   : 0;
+    }
+
+    template<typename U = T>
+    using LockType = MicroRWLockBits<std::uintptr_t, 0, lock_bits<U>()>;
+
+public:
+    /** \brief RAII guard of a read lock. */
+    using ReadHolder = SharedHolder<PackedLockPtr>;
+    /** \brief RAII guard of the write lock. */
+    using WriteHolder = UniqueHolder<PackedLockPtr>;
+
+    /** \brief Unlocked pointer to `p`. */
+    explicit PackedLockPtr(T* p = nullptr) noexcept
+        : word(address(p))
+    {
+        static_assert(lock_bits<T>() >= 2, "PackedLockPtr needs objects aligned to 4 bytes at least");
+        static_assert((std::size_t(1) << lock_bits<T>()) <= alignof(T), "PackedLockPtr needs the low bits to be free");
+    }
+
+    PackedLockPtr(const PackedLockPtr&) = delete;
+    PackedLockPtr& operator=(const PackedLockPtr&) = delete;
+
+    /** \brief The pointer, whatever the state of the lock. */
+    T* get() const noexcept
+    { return reinterpret_cast<T*>(word.load(std::memory_order_acquire) & ~LockType<>::Mask); }
+
+    T* operator->() const noexcept
+    { return get(); }
+
+    T& operator*() const noexcept
+    { return *get(); }
+
+    explicit operator bool() const noexcept
+    { return get() != nullptr; }
+
+    /**
+     * \brief Replaces the pointer, keeping the state of the lock.
+     * \details Usually called with the write lock held.
+     */
+    void reset(T* p = nullptr) noexcept
+    {
+        const std::uintptr_t bits = address(p);
+        std::uintptr_t old = word.load(std::memory_order_relaxed);
+        while (!word.compare_exchange_weak(old, bits | (old & LockType<>::Mask), std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+    }
+
+    /** \brief Maximum number of concurrent readers. */
+    static constexpr std::size_t max_readers() noexcept
+    { return LockType<>::max_readers(); }
+
+    void lock()
+    { LockType<>::lock(word); }
+
+    bool try_lock()
+    { return LockType<>::try_lock(word); }
+
+    void unlock()
+    { LockType<>::unlock(word); }
+
+    void lock_shared()
+    { LockType<>::lock_shared(word); }
+
+    bool try_lock_shared()
+    { return LockType<>::try_lock_shared(word); }
+
+    void unlock_shared()
+    { LockType<>::unlock_shared(word); }
+
+private:
+    static std::uintptr_t address(T* p) noexcept
+    {
+        const std::uintptr_t bits = reinterpret_cast<std::uintptr_t>(p);
+        assert(!(bits & LockType<>::Mask) && "PackedLockPtr needs an aligned pointer");
+        return bits;
+    }
+
+    std::atomic<std::uintptr_t> word;
+};
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_MICRORWLOCK_HPP
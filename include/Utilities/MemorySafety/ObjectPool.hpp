@@ -0,0 +1,394 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_OBJECTPOOL_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_OBJECTPOOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "CompactSafeWeakPtr.hpp"
+#include "RWSpinLock.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file ObjectPool.hpp
+ * \brief Pool recycling the memory of SafeSharedPtr objects, with their lock
+ *        and control block.
+ * \details
+ *   Memory::make_shared() costs two heap allocations, one for the object with
+ *   its control block and one for the lock with its own, and as many frees:
+ *   for objects created and dropped at a high rate, most of the time goes to
+ *   the allocator.
+ *
+ *   Memory::make_pooled() builds the object like Memory::allocate_compact(),
+ *   object, lock and control block in one chunk of memory, taken from a
+ *   Memory::ObjectPool. When the last handle is gone the chunk goes back to
+ *   the pool instead of the heap, and the next make_pooled() reuses it:
+ *     - each thread keeps up to `perThread` chunks of its own, taken and
+ *       given back without locking;
+ *     - a thread whose cache is full moves half of it to a list shared by
+ *       all threads, and a thread whose cache is empty takes from there, so
+ *       objects created by one thread and dropped by another are recycled
+ *       as well;
+ *     - the shared list keeps at most `capacity` chunks, chunks beyond it
+ *       are freed, as are the chunks of a thread when it exits.
+ *
+ *   The object and its lock are still constructed and destroyed each time,
+ *   only the memory is recycled. Pointers made by a pool are compact ones,
+ *   usable with CompactSafeWeakPtr.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::ObjectPool<Order> pool(4096);
+ *   // Hot path, no allocation once the pool is warm
+ *   auto order = Memory::make_pooled<Order>(pool, id, price);
+ *   book.submit(order);
+ *   ```
+ *
+ * \warning The pool must outlive the objects made from it, including the weak
+ *          handles observing them. Chunks cached by other threads are only
+ *          freed when they exit.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Pool of memory chunks for SafeSharedPtr objects, see ObjectPool.hpp
+ *        for details.
+ * \tparam T            Type of the objects, same requirements as
+ *                      make_compact().
+ * \tparam SharedMutex  Type of the mutex used, default is shared_mutex_t.
+ * \tparam SharedLock   Type of the read-lock used, default is shared_lock_t.
+ * \tparam UniqueLock   Type of the write-lock used, default is unique_lock_t.
+ */
+template<typename T,
+         typename SharedMutex = shared_mutex_t,
+         typename SharedLock = shared_lock_t,
+         typename UniqueLock = unique_lock_t>
+class ObjectPool
+{
+public:
+    /** \brief Type of the pointers made by the pool. */
+    using pointer = SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>;
+
+    /**
+     * \brief Allocator handing out the chunks of a pool, given to
+     *        allocate_compact() by make_pooled().
+     * \details
+     *   Single objects of the type first allocated are served by the pool,
+     *   any other request by `std::allocator`.
+     */
+    template<typename U>
+    class Allocator
+    {
+    public:
+        using value_type = U;
+
+        template<typename V>
+        struct rebind
+        {
+            using other = Allocator<V>;
+        };
+
+        explicit Allocator(ObjectPool& pool) noexcept
+            : pool(&pool)
+        {}
+
+        template<typename V>
+        Allocator(const Allocator<V>& other) noexcept
+            : pool(other.pool)
+        {}
+
+        U* allocate(std::size_t n)
+        {
+            if (n == 1 && pool->serves(&release<U>)) {
+                if (void* chunk = pool->acquire()) {
+                    return static_cast<U*>(chunk);
+                }
+            }
+            return std::allocator<U>().allocate(n);
+        }
+
+        void deallocate(U* p, std::size_t n) noexcept
+        {
+            if (n == 1 && pool->serves(&release<U>)) {
+                try {
+                    pool->recycle(p);
+                    return;
+                } catch (...) {
+                    // No room for the cache of this thread, free it.
+                }
+            }
+            std::allocator<U>().deallocate(p, n);
+        }
+
+        template<typename V>
+        bool operator==(const Allocator<V>& other) const noexcept
+        { return pool == other.pool; }
+
+        template<typename V>
+        bool operator!=(const Allocator<V>& other) const noexcept
+        { return pool != other.pool; }
+
+    private:
+        template<typename V>
+        friend class Allocator;
+
+        ObjectPool* pool;
+    };
+
+    /**
+     * \brief Empty pool.
+     * \param capacity  Maximum number of chunks kept in the shared list.
+     * \param perThread Maximum number of chunks kept by each thread, at
+     *                  least 2.
+     */
+    explicit ObjectPool(std::size_t capacity = 1024, std::size_t perThread = 32)
+        : id(next_id()), limit(capacity), perThread(perThread < 2 ? 2 : perThread), chunkType(nullptr)
+    {
+        shared.head = nullptr;
+        shared.count = 0;
+    }
+
+    /**
+     * \brief Frees the chunks of the shared list and of the calling thread,
+     *        other threads free theirs when they exit.
+     */
+    ~ObjectPool()
+    {
+        clear();
+        local().forget(id);
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * \brief Creates an object and its lock in a chunk of the pool.
+     * \details Same as make_pooled().
+     */
+    template<typename... Args>
+    pointer make(Args&&... args)
+    {
+        return allocate_compact<T, SharedMutex, SharedLock, UniqueLock>(Allocator<T>(*this),
+                                                                        std::forward<Args>(args)...);
+    }
+
+    /** \brief Maximum number of chunks kept in the shared list. */
+    std::size_t capacity() const noexcept
+    { return limit; }
+
+    /** \brief Maximum number of chunks kept by each thread. */
+    std::size_t thread_capacity() const noexcept
+    { return perThread; }
+
+    /** \brief Number of chunks kept in the shared list and by the calling thread. */
+    std::size_t cached() const
+    {
+        const std::size_t mine = local().find(id).count;
+        RWSpinLock::WriteHolder holder(shared.lock);
+        return mine + shared.count;
+    }
+
+    /** \brief Frees the chunks of the shared list and of the calling thread. */
+    void clear()
+    {
+        void (*release)(void*) = chunkType.load(std::memory_order_acquire);
+        Entry& mine = local().find(id);
+        free(release, mine.head);
+        mine.head = nullptr;
+        mine.count = 0;
+        Chunk* list;
+        {
+            RWSpinLock::WriteHolder holder(shared.lock);
+            list = shared.head;
+            shared.head = nullptr;
+            shared.count = 0;
+        }
+        free(release, list);
+    }
+
+private:
+    struct Chunk
+    {
+        Chunk* next;
+    };
+
+    /** Chunks kept by one thread for one pool. */
+    struct Entry
+    {
+        std::uint64_t pool;
+        void (*release)(void*);
+        Chunk* head;
+        std::size_t count;
+    };
+
+    /** Chunks kept by the calling thread for all pools, freed when it exits. */
+    struct ThreadCache
+    {
+        ~ThreadCache()
+        {
+            for (Entry& entry : entries) {
+                free(entry.release, entry.head);
+            }
+        }
+
+        Entry& find(std::uint64_t pool)
+        {
+            for (Entry& entry : entries) {
+                if (entry.pool == pool) {
+                    return entry;
+                }
+            }
+            entries.push_back(Entry{pool, nullptr, nullptr, 0});
+            return entries.back();
+        }
+
+        void forget(std::uint64_t pool)
+        {
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                if (entries[i].pool == pool) {
+                    entries.erase(entries.begin() + i);
+                    return;
+                }
+            }
+        }
+
+        std::vector<Entry> entries;
+    };
+
+    /** Central list, shared by all threads. */
+    struct Shared
+    {
+        RWSpinLock lock;
+        Chunk* head;
+        std::size_t count;
+    };
+
+    /** Frees a chunk allocated for `U`. */
+    template<typename U>
+    static void release(void* chunk)
+    { std::allocator<U>().deallocate(static_cast<U*>(chunk), 1); }
+
+    static void free(void (*release)(void*), Chunk* list)
+    {
+        while (list) {
+            Chunk* next = list->next;
+            release(list);
+            list = next;
+        }
+    }
+
+    static ThreadCache& local()
+    {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+
+    /** Identifies the pool in the thread caches, never reused unlike its address. */
+    static std::uint64_t next_id() noexcept
+    {
+        static std::atomic<std::uint64_t> ids(0);
+        return ids.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /** Whether chunks are allocated for the type freed by `type`, the first one asked. */
+    bool serves(void (*type)(void*)) noexcept
+    {
+        void (*current)(void*) = chunkType.load(std::memory_order_acquire);
+        if (!current && chunkType.compare_exchange_strong(current, type, std::memory_order_acq_rel)) {
+            return true;
+        }
+        return current == type;
+    }
+
+    /** A chunk of the thread, refilled from the shared list if empty, else `nullptr`. */
+    void* acquire()
+    {
+        Entry& mine = local().find(id);
+        if (!mine.head) {
+            // Freed by this thread at exit, even if it never recycles one.
+            mine.release = chunkType.load(std::memory_order_relaxed);
+            RWSpinLock::WriteHolder holder(shared.lock);
+            while (shared.head && mine.count < perThread / 2) {
+                Chunk* chunk = shared.head;
+                shared.head = chunk->next;
+                --shared.count;
+                chunk->next = mine.head;
+                mine.head = chunk;
+                ++mine.count;
+            }
+        }
+        Chunk* chunk = mine.head;
+        if (chunk) {
+            mine.head = chunk->next;
+            --mine.count;
+        }
+        return chunk;
+    }
+
+    /**
+     * Keeps `p` in the thread, moving half of a full thread cache to the
+     * shared list. Throws only if the thread had no cache for the pool yet.
+     */
+    void recycle(void* p)
+    {
+        Entry& mine = local().find(id);
+        mine.release = chunkType.load(std::memory_order_relaxed);
+        if (mine.count >= perThread) {
+            Chunk* excess = nullptr;
+            {
+                RWSpinLock::WriteHolder holder(shared.lock);
+                while (mine.count > perThread / 2) {
+                    Chunk* chunk = mine.head;
+                    mine.head = chunk->next;
+                    --mine.count;
+                    Chunk*& list = shared.count < limit ? shared.head : excess;
+                    shared.count += shared.count < limit;
+                    chunk->next = list;
+                    list = chunk;
+                }
+            }
+            free(mine.release, excess);
+        }
+        Chunk* chunk = ::new (p) Chunk;
+        chunk->next = mine.head;
+        mine.head = chunk;
+        ++mine.count;
+    }
+
+    const std::uint64_t id;
+    const std::size_t limit;
+    const std::size_t perThread;
+    std::atomic<void (*)(void*)> chunkType;
+    mutable CacheLinePadded<Shared> shared;
+};
+
+/**
+ * \relates ObjectPool
+ * \brief Creates an object and its lock in a chunk of `pool`, given back to
+ *        the pool with the last handle.
+ * \tparam T Type of object to be created, the lock types are those of `pool`.
+ * \param pool Pool of the chunk, must outlive the object.
+ * \param args Arguments forwarded to the constructor of `T`.
+ * \return The new pointer, observable by CompactSafeWeakPtr.
+ */
+template<typename T, typename SharedMutex, typename SharedLock, typename UniqueLock, typename... Args>
+inline SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> make_pooled(
+    ObjectPool<T, SharedMutex, SharedLock, UniqueLock>& pool, Args&&... args)
+{ return pool.make(std::forward<Args>(args)...); }
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_OBJECTPOOL_HPP
@@ -0,0 +1,366 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_RWSPINLOCK64_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_RWSPINLOCK64_HPP
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "../Common.h"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+
+/**
+ * \file RWSpinLock64.hpp
+ * \brief Read-write spin lock on a 64-bit word, counting its waiting writers
+ *        and upgraders.
+ * \details
+ *   Memory::RWSpinLock packs its state in 32 bits, and only knows whether a
+ *   writer holds the lock, not how many wait for it. Memory::RWSpinLock64T
+ *   spends a 64-bit word on:
+ *
+ *   | Bits    | Field                                             |
+ *   | :-----: | ------------------------------------------------- |
+ *   | 0       | writer holds the lock                             |
+ *   | 1       | upgrader holds the lock                           |
+ *   | 2 - 17  | waiting writers, upgraders waiting to write too   |
+ *   | 18 - 33 | waiting upgraders                                 |
+ *   | 34 - 63 | readers                                           |
+ *
+ *   A writer or upgrader failing its first attempt registers as waiting, and
+ *   leaves the count when it gets the lock or times out, so the counts are
+ *   exact at any time. With `PreferWriter`, the default, new readers are held
+ *   back as long as a writer waits, without the grace period
+ *   RWSpinLockT needs to guess that.
+ *
+ *   Readers beyond 2^29 fail to lock instead of overflowing the word. Up to
+ *   65535 threads may wait for each of writing and upgrading.
+ *
+ *   state() returns a snapshot of all fields for diagnostics. Debug builds
+ *   (without `NDEBUG`) also record the thread holding the write lock, shown
+ *   in the snapshot, and assert when that thread locks again.
+ *
+ *   Any non-parking wait policy of RWSpinLock.hpp applies. Futexes wait on
+ *   32-bit words only, so parking policies are not supported.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::RWSpinLock64 lock;
+ *   auto state = lock.state();
+ *   if (state.waitingWriters > 8) {
+ *       report("writers queueing on the lock", state.readers);
+ *   }
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Read-write spin lock with waiter counts, see RWSpinLock64.hpp for
+ *        details.
+ * \tparam WaitPolicy   How a thread waits after a failed attempt,
+ *                      YieldWaitPolicy or BackoffWaitPolicy.
+ * \tparam PreferWriter Whether waiting writers hold back new readers.
+ */
+template<typename WaitPolicy = YieldWaitPolicy, bool PreferWriter = true>
+class RWSpinLock64T : private WaitPolicy
+{
+    static_assert(!WaitPolicy::parks, "futexes wait on 32-bit words, RWSpinLock64T cannot park");
+
+    enum : uint64_t {
+        WRITER = 1,
+        UPGRADED = 2,
+        WAITING_WRITER = uint64_t(1) << 2,
+        WAITING_WRITER_MASK = uint64_t(0xFFFF) << 2,
+        WAITING_UPGRADER = uint64_t(1) << 18,
+        WAITING_UPGRADER_MASK = uint64_t(0xFFFF) << 18,
+        READER = uint64_t(1) << 34,
+        READER_MASK = ~(READER - 1)
+    };
+
+public:
+    /** \brief Type of the wait policy. */
+    using wait_policy = WaitPolicy;
+    /** \brief RAII guard of a read lock. */
+    using ReadHolder = SharedHolder<RWSpinLock64T>;
+    /** \brief RAII guard of the write lock. */
+    using WriteHolder = UniqueHolder<RWSpinLock64T>;
+
+    /** \brief Readers allowed at once, further ones wait. */
+    static constexpr uint32_t MaxReaders = uint32_t(1) << 29;
+
+    /** \brief Snapshot of the lock, see state(). */
+    struct State
+    {
+        /** \brief Whether a writer holds the lock. */
+        bool writer;
+        /** \brief Whether an upgrader holds the lock. */
+        bool upgraded;
+        /** \brief Number of readers holding the lock. */
+        uint32_t readers;
+        /** \brief Number of writers waiting, upgraders waiting to write included. */
+        uint32_t waitingWriters;
+        /** \brief Number of threads waiting for the upgrade lock. */
+        uint32_t waitingUpgraders;
+        /** \brief Thread holding the write lock, in debug builds only. */
+        std::thread::id owner;
+    };
+
+    RWSpinLock64T() noexcept
+        : bits_(0)
+#ifndef NDEBUG
+        , owner_(std::thread::id())
+#endif
+    {}
+
+    RWSpinLock64T(const RWSpinLock64T&) = delete;
+    RWSpinLock64T& operator=(const RWSpinLock64T&) = delete;
+
+    /** \brief The wait policy, holding its per-lock settings if any. */
+    WaitPolicy& policy() noexcept
+    { return *this; }
+
+    /** \brief Acquires the write lock, counted as waiting meanwhile. */
+    void lock()
+    {
+        assert(owner_thread() != std::this_thread::get_id() && "RWSpinLock64T is not recursive");
+        if (try_lock()) {
+            return;
+        }
+        bits_.fetch_add(WAITING_WRITER, std::memory_order_relaxed);
+        uint_fast32_t count = 0;
+        while (!acquire(WRITER | UPGRADED | READER_MASK, WRITER, WAITING_WRITER)) {
+            wait(count, WRITER | UPGRADED | READER_MASK);
+        }
+        acquired(count);
+    }
+
+    /** \brief Acquires the write lock if nobody holds it. */
+    bool try_lock()
+    { return acquire(WRITER | UPGRADED | READER_MASK, WRITER, 0); }
+
+    /**
+     * \brief Tries to acquire the write lock until `deadline` passed, counted
+     *        as waiting meanwhile.
+     */
+    template<class Clock, class Duration>
+    bool try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline)
+    {
+        if (try_lock()) {
+            return true;
+        }
+        bits_.fetch_add(WAITING_WRITER, std::memory_order_relaxed);
+        uint_fast32_t count = 0;
+        while (!acquire(WRITER | UPGRADED | READER_MASK, WRITER, WAITING_WRITER)) {
+            if (Clock::now() >= deadline) {
+                bits_.fetch_sub(WAITING_WRITER, std::memory_order_relaxed);
+                return false;
+            }
+            wait(count, WRITER | UPGRADED | READER_MASK);
+        }
+        acquired(count);
+        return true;
+    }
+
+    /** \brief Same as try_lock_until() with a timeout. */
+    template<class Rep, class Period>
+    bool try_lock_for(const std::chrono::duration<Rep, Period>& timeout)
+    { return try_lock_until(std::chrono::steady_clock::now() + timeout); }
+
+    /** \brief Releases the write lock. */
+    void unlock()
+    {
+        set_owner(std::thread::id());
+        bits_.fetch_sub(WRITER, std::memory_order_release);
+    }
+
+    /** \brief Acquires a read lock. */
+    void lock_shared()
+    {
+        uint_fast32_t count = 0;
+        while (!try_lock_shared()) {
+            wait(count, WRITER | UPGRADED | (PreferWriter ? uint64_t(WAITING_WRITER_MASK) : uint64_t(0)));
+        }
+        acquired(count);
+    }
+
+    /**
+     * \brief Acquires a read lock if no writer nor upgrader holds the lock,
+     *        nor a writer waits for it with `PreferWriter`.
+     */
+    bool try_lock_shared()
+    {
+        const uint64_t value = bits_.fetch_add(READER, std::memory_order_acquire);
+        if ((value & (WRITER | UPGRADED | (PreferWriter ? uint64_t(WAITING_WRITER_MASK) : uint64_t(0))))
+            || (value >> 34) >= MaxReaders) {
+            bits_.fetch_sub(READER, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief Releases a read lock. */
+    void unlock_shared()
+    { bits_.fetch_sub(READER, std::memory_order_release); }
+
+    /** \brief Turns the write lock into a read lock. */
+    void unlock_and_lock_shared()
+    {
+        set_owner(std::thread::id());
+        bits_.fetch_add(READER - WRITER, std::memory_order_acq_rel);
+    }
+
+    /** \brief Acquires the upgrade lock, counted as waiting meanwhile. */
+    void lock_upgrade()
+    {
+        if (try_lock_upgrade()) {
+            return;
+        }
+        bits_.fetch_add(WAITING_UPGRADER, std::memory_order_relaxed);
+        uint_fast32_t count = 0;
+        while (!acquire(WRITER | UPGRADED, UPGRADED, WAITING_UPGRADER)) {
+            wait(count, WRITER | UPGRADED);
+        }
+        acquired(count);
+    }
+
+    /** \brief Acquires the upgrade lock if no writer nor upgrader holds it. */
+    bool try_lock_upgrade()
+    { return acquire(WRITER | UPGRADED, UPGRADED, 0); }
+
+    /** \brief Releases the upgrade lock. */
+    void unlock_upgrade()
+    { bits_.fetch_sub(UPGRADED, std::memory_order_release); }
+
+    /**
+     * \brief Turns the upgrade lock into the write lock once the readers left,
+     *        counted as waiting writer meanwhile.
+     */
+    void unlock_upgrade_and_lock()
+    {
+        if (try_unlock_upgrade_and_lock()) {
+            return;
+        }
+        bits_.fetch_add(WAITING_WRITER, std::memory_order_relaxed);
+        uint_fast32_t count = 0;
+        while (!upgrade(WAITING_WRITER)) {
+            wait(count, READER_MASK);
+        }
+        acquired(count);
+    }
+
+    /** \brief Turns the upgrade lock into the write lock if no reader is in. */
+    bool try_unlock_upgrade_and_lock()
+    { return upgrade(0); }
+
+    /** \brief Turns the upgrade lock into a read lock. */
+    void unlock_upgrade_and_lock_shared()
+    { bits_.fetch_add(READER - UPGRADED, std::memory_order_acq_rel); }
+
+    /** \brief Turns the write lock into the upgrade lock. */
+    void unlock_and_lock_upgrade()
+    {
+        set_owner(std::thread::id());
+        bits_.fetch_add(UPGRADED - WRITER, std::memory_order_acq_rel);
+    }
+
+    /** \brief Snapshot of the lock, for diagnostics. */
+    State state() const noexcept
+    {
+        const uint64_t value = bits_.load(std::memory_order_acquire);
+        State result;
+        result.writer = (value & WRITER) != 0;
+        result.upgraded = (value & UPGRADED) != 0;
+        result.readers = static_cast<uint32_t>(value >> 34);
+        result.waitingWriters = static_cast<uint32_t>((value & WAITING_WRITER_MASK) >> 2);
+        result.waitingUpgraders = static_cast<uint32_t>((value & WAITING_UPGRADER_MASK) >> 18);
+        result.owner = owner_thread();
+        return result;
+    }
+
+    /** \brief Raw lock word, mainly for debugging purposes. */
+    uint64_t bits() const noexcept
+    { return bits_.load(std::memory_order_acquire); }
+
+private:
+    /** Sets `set` if none of `busy` is, and leaves the `waiting` count. */
+    bool acquire(uint64_t busy, uint64_t set, uint64_t waiting)
+    {
+        uint64_t value = bits_.load(std::memory_order_relaxed);
+        while (!(value & busy)) {
+            if (bits_.compare_exchange_weak(value, value + set - waiting, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                if (set == WRITER) {
+                    set_owner(std::this_thread::get_id());
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Turns UPGRADED into WRITER once the readers left, leaving the `waiting` count. */
+    bool upgrade(uint64_t waiting)
+    {
+        uint64_t value = bits_.load(std::memory_order_relaxed);
+        while (!(value & READER_MASK)) {
+            assert(value & UPGRADED);
+            if (bits_.compare_exchange_weak(value, value - UPGRADED + WRITER - waiting, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+                set_owner(std::this_thread::get_id());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void wait(uint_fast32_t& count, uint64_t blocking)
+    {
+        WaitPolicy::pause(++count, [this, blocking]() {
+            return (bits_.load(std::memory_order_relaxed) & blocking) != 0;
+        });
+    }
+
+    void acquired(uint_fast32_t count)
+    {
+        if (count != 0) {
+            WaitPolicy::acquired(count);
+        }
+    }
+
+#ifndef NDEBUG
+    void set_owner(std::thread::id id) noexcept
+    { owner_.store(id, std::memory_order_relaxed); }
+
+    std::thread::id owner_thread() const noexcept
+    { return owner_.load(std::memory_order_relaxed); }
+#else
+    void set_owner(std::thread::id) noexcept
+    {}
+
+    std::thread::id owner_thread() const noexcept
+    { return std::thread::id(); }
+#endif
+
+    std::atomic<uint64_t> bits_;
+#ifndef NDEBUG
+    std::atomic<std::thread::id> owner_;
+#endif
+};
+
+template<typename WaitPolicy, bool PreferWriter>
+constexpr uint32_t RWSpinLock64T<WaitPolicy, PreferWriter>::MaxReaders;
+
+/** \brief 64-bit read-write spin lock preferring writers, yielding after 1000 attempts. */
+using RWSpinLock64 = RWSpinLock64T<>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_RWSPINLOCK64_HPP
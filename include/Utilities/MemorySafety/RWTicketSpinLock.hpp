@@ -0,0 +1,351 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_RWTICKETSPINLOCK_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_RWTICKETSPINLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+#include "RWSpinLock.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file RWTicketSpinLock.hpp
+ * \brief Fair read-write spin lock serving writers in ticket order, after
+ *        folly's `RWTicketSpinLockT`.
+ * \details
+ *   Memory::RWSpinLock lets readers in as long as no writer holds the lock,
+ *   so under a steady read load a writer may wait indefinitely.
+ *   Memory::RWTicketSpinLockT hands out tickets from one counter, and serves
+ *   them with two: `write` for writers and `read` for readers.
+ *     - A writer takes the next ticket and waits for `write` to reach it,
+ *       i.e. for every reader and writer arrived before it to leave. Its wait
+ *       is bounded by the holders ahead of it.
+ *     - A reader enters only when nobody is queued ahead of it, taking and
+ *       serving its ticket at once, so readers share the lock but never
+ *       overtake a waiting writer.
+ *
+ *   The three counters are packed in one word of `BitWidth` bits and wrap
+ *   around, so at most `2^(BitWidth / 4) - 1` threads may wait at once: 255
+ *   for RWTicketSpinLock32, 65535 for RWTicketSpinLock64.
+ *
+ *   With `FavorWriter` set to `false`, writers poll try_lock() instead of
+ *   taking a ticket, like RWSpinLock, trading fairness for throughput.
+ *
+ *   Memory::TicketSafeSharedPtr is the SafeSharedPtr policy using it.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::TicketSafeSharedPtr<Routes> routes(new Routes);
+ *   // Readers on every core
+ *   auto hop = routes->next(address);
+ *   // Updates are not starved by them
+ *   routes->add(prefix, hop);
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Fair read-write spin lock with tickets, see RWTicketSpinLock.hpp for
+ *        details.
+ * \tparam BitWidth    Size of the lock word, 32 or 64.
+ * \tparam FavorWriter Whether writers take a ticket, `true` for fairness.
+ */
+template<std::size_t BitWidth, bool FavorWriter = true>
+class RWTicketSpinLockT
+{
+    static_assert(BitWidth == 32 || BitWidth == 64, "RWTicketSpinLockT supports 32 or 64 bits");
+
+    using FullInt = typename std::conditional<BitWidth == 64, uint64_t, uint32_t>::type;
+
+    // Fields of the word, `users` on top so that its carry leaves the word.
+    enum : unsigned { Quarter = BitWidth / 4, WriteShift = 0, ReadShift = Quarter, UsersShift = 3 * Quarter };
+    static constexpr FullInt Mask = (FullInt(1) << Quarter) - 1;
+
+public:
+    class ReadHolder;
+    class WriteHolder;
+
+    constexpr RWTicketSpinLockT() noexcept
+        : ticket(0)
+    {}
+
+    RWTicketSpinLockT(const RWTicketSpinLockT&) = delete;
+    RWTicketSpinLockT& operator=(const RWTicketSpinLockT&) = delete;
+
+    /**
+     * \brief Acquires the write lock, after every holder and writer arrived
+     *        before.
+     */
+    void lock()
+    {
+        uint_fast32_t count = 0;
+        if (FavorWriter) {
+            const FullInt mine = field(ticket.fetch_add(FullInt(1) << UsersShift, std::memory_order_acquire),
+                                       UsersShift);
+            while (field(ticket.load(std::memory_order_acquire), WriteShift) != mine) {
+                backoff(count);
+            }
+        } else {
+            while (!try_lock()) {
+                backoff(count);
+            }
+        }
+    }
+
+    /** \brief Acquires the write lock if nobody holds or waits for it. */
+    bool try_lock()
+    {
+        FullInt old = ticket.load(std::memory_order_acquire);
+        if (field(old, UsersShift) != field(old, WriteShift)) {
+            return false;
+        }
+        return ticket.compare_exchange_strong(old, old + (FullInt(1) << UsersShift),
+                                              std::memory_order_acquire);
+    }
+
+    /** \brief Releases the write lock, serving the next reader and writer. */
+    void unlock()
+    { advance([](FullInt t) { return bump(bump(t, ReadShift), WriteShift); }); }
+
+    /** \brief Turns the write lock into a read lock, letting readers in. */
+    void unlock_and_lock_shared()
+    { advance([](FullInt t) { return bump(t, ReadShift); }); }
+
+    /** \brief Acquires a read lock, waits for the writers ahead. */
+    void lock_shared()
+    {
+        uint_fast32_t count = 0;
+        while (!try_lock_shared()) {
+            backoff(count);
+        }
+    }
+
+    /** \brief Acquires a read lock if no writer holds or waits for it. */
+    bool try_lock_shared()
+    {
+        FullInt old = ticket.load(std::memory_order_acquire);
+        if (field(old, UsersShift) != field(old, ReadShift)) {
+            return false;
+        }
+        // Takes the next ticket and serves it at once.
+        const FullInt next = bump(old, ReadShift) + (FullInt(1) << UsersShift);
+        return ticket.compare_exchange_strong(old, next, std::memory_order_acquire);
+    }
+
+    /** \brief Releases a read lock. */
+    void unlock_shared()
+    { advance([](FullInt t) { return bump(t, WriteShift); }); }
+
+    /**
+     * \brief RAII guard for read lock with RWTicketSpinLockT::lock_shared() on
+     *        construction and RWTicketSpinLockT::unlock_shared() on
+     *        destruction.
+     */
+    class ReadHolder
+    {
+    public:
+        ReadHolder() noexcept
+            : lock_(nullptr)
+        {}
+
+        /** \brief Takes over a read lock already held by the caller. */
+        ReadHolder(RWTicketSpinLockT& lock, std::adopt_lock_t) noexcept
+            : lock_(&lock)
+        {}
+
+        explicit ReadHolder(RWTicketSpinLockT* lock)
+            : lock_(lock)
+        {
+            if (lock_) {
+                lock_->lock_shared();
+            }
+        }
+
+        explicit ReadHolder(RWTicketSpinLockT& lock)
+            : lock_(&lock)
+        { lock_->lock_shared(); }
+
+        /** \brief down-grade */
+        explicit ReadHolder(WriteHolder&& writer)
+            : lock_(writer.lock_)
+        {
+            writer.lock_ = nullptr;
+            if (lock_) {
+                lock_->unlock_and_lock_shared();
+            }
+        }
+
+        ReadHolder(ReadHolder&& other) noexcept
+            : lock_(other.lock_)
+        { other.lock_ = nullptr; }
+
+        ReadHolder& operator=(ReadHolder&& other) noexcept
+        {
+            std::swap(lock_, other.lock_);
+            return *this;
+        }
+
+        ReadHolder(const ReadHolder&) = delete;
+        ReadHolder& operator=(const ReadHolder&) = delete;
+
+        ~ReadHolder()
+        {
+            if (lock_) {
+                lock_->unlock_shared();
+            }
+        }
+
+        void reset(RWTicketSpinLockT* lock = nullptr)
+        {
+            if (lock == lock_) {
+                return;
+            }
+            if (lock_) {
+                lock_->unlock_shared();
+            }
+            lock_ = lock;
+            if (lock_) {
+                lock_->lock_shared();
+            }
+        }
+
+        void swap(ReadHolder& other) noexcept
+        { std::swap(lock_, other.lock_); }
+
+    private:
+        RWTicketSpinLockT* lock_;
+    };
+
+    /**
+     * \brief RAII guard for write lock with RWTicketSpinLockT::lock() on
+     *        construction and RWTicketSpinLockT::unlock() on destruction.
+     */
+    class WriteHolder
+    {
+    public:
+        WriteHolder() noexcept
+            : lock_(nullptr)
+        {}
+
+        /** \brief Takes over a write lock already held by the caller. */
+        WriteHolder(RWTicketSpinLockT& lock, std::adopt_lock_t) noexcept
+            : lock_(&lock)
+        {}
+
+        explicit WriteHolder(RWTicketSpinLockT* lock)
+            : lock_(lock)
+        {
+            if (lock_) {
+                lock_->lock();
+            }
+        }
+
+        explicit WriteHolder(RWTicketSpinLockT& lock)
+            : lock_(&lock)
+        { lock_->lock(); }
+
+        WriteHolder(WriteHolder&& other) noexcept
+            : lock_(other.lock_)
+        { other.lock_ = nullptr; }
+
+        WriteHolder& operator=(WriteHolder&& other) noexcept
+        {
+            std::swap(lock_, other.lock_);
+            return *this;
+        }
+
+        WriteHolder(const WriteHolder&) = delete;
+        WriteHolder& operator=(const WriteHolder&) = delete;
+
+        ~WriteHolder()
+        {
+            if (lock_) {
+                lock_->unlock();
+            }
+        }
+
+        void reset(RWTicketSpinLockT* lock = nullptr)
+        {
+            if (lock == lock_) {
+                return;
+            }
+            if (lock_) {
+                lock_->unlock();
+            }
+            lock_ = lock;
+            if (lock_) {
+                lock_->lock();
+            }
+        }
+
+        void swap(WriteHolder& other) noexcept
+        { std::swap(lock_, other.lock_); }
+
+    private:
+        friend class ReadHolder;
+        RWTicketSpinLockT* lock_;
+    };
+
+private:
+    static FullInt field(FullInt t, unsigned shift) noexcept
+    { return (t >> shift) & Mask; }
+
+    /** Increments one field, wrapping around within it. */
+    static FullInt bump(FullInt t, unsigned shift) noexcept
+    { return (t & ~(Mask << shift)) | (((field(t, shift) + 1) & Mask) << shift); }
+
+    /** Applies `fn` atomically, concurrent arrivals may change `users`. */
+    template<typename Fn>
+    void advance(Fn fn)
+    {
+        FullInt old = ticket.load(std::memory_order_relaxed);
+        while (!ticket.compare_exchange_weak(old, fn(old), std::memory_order_release,
+                                             std::memory_order_relaxed)) {
+        }
+    }
+
+    static void backoff(uint_fast32_t& count)
+    {
+        cpu_relax();
+        if ((++count & 1023) == 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<FullInt> ticket;
+};
+
+template<std::size_t BitWidth, bool FavorWriter>
+constexpr typename RWTicketSpinLockT<BitWidth, FavorWriter>::FullInt RWTicketSpinLockT<BitWidth, FavorWriter>::Mask;
+
+/** \brief 32-bit ticket lock, up to 255 waiting threads. */
+using RWTicketSpinLock32 = RWTicketSpinLockT<32>;
+
+/** \brief 64-bit ticket lock, up to 65535 waiting threads. */
+using RWTicketSpinLock64 = RWTicketSpinLockT<64>;
+
+/**
+ * \brief SafeSharedPtr locked by RWTicketSpinLockT, whose writers are not
+ *        starved by readers.
+ */
+template<typename T, std::size_t BitWidth = 64>
+using TicketSafeSharedPtr = SafeSharedPtr<T,
+                                          RWTicketSpinLockT<BitWidth>,
+                                          typename RWTicketSpinLockT<BitWidth>::ReadHolder,
+                                          typename RWTicketSpinLockT<BitWidth>::WriteHolder>;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_RWTICKETSPINLOCK_HPP
@@ -0,0 +1,746 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_RECLAMATION_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_RECLAMATION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "../Common.h"
+
+/**
+ * \file Reclamation.hpp
+ * \brief Deferred memory reclamation with hazard pointers and epochs.
+ * \details
+ *   Lock-free readers may still be looking at an object after a writer has
+ *   unlinked it, so the writer cannot delete it at once. Instead it
+ *   **retires** the object into a domain, which deletes it later in batches,
+ *   once no reader can reach it any more.\n
+ *   Two schemes are provided:
+ *     - Memory::HazardPointerDomain with Memory::HazardPointer : a reader
+ *       publishes the address it is about to dereference in a hazard slot,
+ *       retired objects are only deleted if no slot holds their address.
+ *       Protecting costs one store and one load, with no read-modify-write
+ *       on any reference count, and bounds the amount of unreclaimed memory.
+ *     - Memory::EpochDomain with Memory::EpochDomain::ThreadHandle : threads
+ *       register once, and pin the global epoch around each read-side
+ *       critical section. Retired objects are deleted two epochs later.
+ *       Pinning is even cheaper than a hazard pointer and covers any number
+ *       of objects, but a stalled reader delays all reclamation.
+ *
+ *   **Sample Code**\n
+ *   ```cpp
+ *   std::atomic<Node*> head;
+ *   // reader
+ *   Memory::HazardPointer hazard;
+ *   Node* node = hazard.protect(head);
+ *   use(node->value);
+ *   // writer
+ *   Node* old = head.exchange(new Node(42));
+ *   Memory::HazardPointerDomain::global().retire(old);
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Type-erased object waiting for reclamation, shared by
+ *        HazardPointerDomain and EpochDomain.
+ */
+class Retired
+{
+public:
+    /**
+     * \brief Creates a retired entry owning `p`, deleted by `d(p)`.
+     * \tparam T        Type of the retired object.
+     * \tparam Deleter  Type of deleter.
+     * \param  p        Object to retire.
+     * \param  d        Deleter to destroy `p`.
+     * \return Heap-allocated entry, free it with reclaim().
+     */
+    template<typename T, typename Deleter>
+    static Retired* create(T* p, Deleter d)
+    { return new Holder<T, Deleter>(p, std::move(d)); }
+
+    /** \brief Destroys the retired object and the entry itself. */
+    void reclaim()
+    { reclaimer(this); }
+
+    /** \brief Address of the retired object. */
+    const void* object;
+    /** \brief Next entry in a retire list. */
+    Retired* next = nullptr;
+    /** \brief Epoch the object was retired in, used by EpochDomain. */
+    std::uint64_t epoch = 0;
+
+protected:
+    Retired(const void* p, void (*r)(Retired*))
+        : object(p), reclaimer(r)
+    {}
+
+private:
+    template<typename T, typename Deleter>
+    struct Holder;
+
+    void (*reclaimer)(Retired*);
+};
+
+template<typename T, typename Deleter>
+struct Retired::Holder : public Retired
+{
+    Holder(T* p, Deleter&& d)
+        : Retired(p, &Holder::destroy), pointer(p), deleter(std::move(d))
+    {}
+
+    static void destroy(Retired* r)
+    {
+        Holder* self = static_cast<Holder*>(r);
+        self->deleter(self->pointer);
+        delete self;
+    }
+
+    T* pointer;
+    Deleter deleter;
+};
+
+/**
+ * \brief Domain of hazard pointers and the objects retired against them,
+ *        see Reclamation.hpp for details.
+ * \details
+ *   Retired objects are kept in one lock-free list per domain. Once the list
+ *   grows beyond the threshold, the retiring thread collects the addresses in
+ *   all hazard slots and deletes every retired object not among them, keeping
+ *   the rest for the next round.
+ * \sa HazardPointer
+ */
+class HazardPointerDomain
+{
+public:
+    /**
+     * \brief Constructs an empty domain.
+     * \param threshold Number of retired objects that triggers a reclamation.
+     */
+    explicit HazardPointerDomain(std::size_t threshold = 64) noexcept
+        : threshold(threshold), records(nullptr), retired(nullptr), retiredCount(0)
+    {}
+
+    HazardPointerDomain(const HazardPointerDomain&) = delete;
+    HazardPointerDomain& operator=(const HazardPointerDomain&) = delete;
+
+    /**
+     * \brief Deletes all retired objects and hazard slots.
+     * \warning All HazardPointer of this domain must be destroyed before.
+     */
+    ~HazardPointerDomain()
+    {
+        Retired* r = retired.exchange(nullptr, std::memory_order_acquire);
+        while (r) {
+            Retired* next = r->next;
+            r->reclaim();
+            r = next;
+        }
+        Record* record = records.load(std::memory_order_acquire);
+        while (record) {
+            Record* next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+
+    /**
+     * \brief Default domain shared by the whole process.
+     */
+    static HazardPointerDomain& global()
+    {
+        static HazardPointerDomain domain;
+        return domain;
+    }
+
+    /**
+     * \brief Retires an object already unlinked from all shared locations.
+     * \tparam T        Type of the retired object.
+     * \tparam Deleter  Type of deleter, default is `std::default_delete<T>`.
+     * \param  p        Object to retire, `nullptr` is ignored.
+     * \param  d        Deleter to destroy `p` once unprotected.
+     */
+    template<typename T, typename Deleter = std::default_delete<T>>
+    void retire(T* p, Deleter d = Deleter())
+    {
+        if (!p) {
+            return;
+        }
+        push(Retired::create(p, std::move(d)), 1);
+        if (retiredCount.load(std::memory_order_relaxed) >= threshold) {
+            reclaim();
+        }
+    }
+
+    /**
+     * \brief Deletes every retired object not protected by a hazard pointer.
+     * \return Number of objects deleted.
+     */
+    std::size_t reclaim()
+    {
+        Retired* list = retired.exchange(nullptr, std::memory_order_acquire);
+        if (!list) {
+            return 0;
+        }
+        // pairs with the store-load in HazardPointer::protect()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<const void*> hazards;
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            const void* p = r->hazard.load(std::memory_order_seq_cst);
+            if (p) {
+                hazards.push_back(p);
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        Retired* keep = nullptr;
+        Retired* keepTail = nullptr;
+        std::size_t kept = 0;
+        std::size_t reclaimed = 0;
+        while (list) {
+            Retired* next = list->next;
+            if (std::binary_search(hazards.begin(), hazards.end(), list->object)) {
+                list->next = keep;
+                keep = list;
+                if (!keepTail) {
+                    keepTail = list;
+                }
+                ++kept;
+            } else {
+                list->reclaim();
+                ++reclaimed;
+            }
+            list = next;
+        }
+        retiredCount.fetch_sub(kept + reclaimed, std::memory_order_relaxed);
+        if (keep) {
+            pushList(keep, keepTail, kept);
+        }
+        return reclaimed;
+    }
+
+    /**
+     * \brief Number of objects retired but not yet deleted.
+     */
+    std::size_t retired_count() const noexcept
+    { return retiredCount.load(std::memory_order_relaxed); }
+
+private:
+    friend class HazardPointer;
+
+    struct Record
+    {
+        std::atomic<const void*> hazard{nullptr};
+        std::atomic<bool> active{true};
+        Record* next = nullptr;
+    };
+
+    Record* acquireRecord()
+    {
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            if (!r->active.load(std::memory_order_relaxed)
+                && !r->active.exchange(true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record* r = new Record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        return r;
+    }
+
+    static void releaseRecord(Record* r) noexcept
+    {
+        r->hazard.store(nullptr, std::memory_order_release);
+        r->active.store(false, std::memory_order_release);
+    }
+
+    void push(Retired* r, std::size_t count)
+    { pushList(r, r, count); }
+
+    void pushList(Retired* first, Retired* last, std::size_t count)
+    {
+        retiredCount.fetch_add(count, std::memory_order_relaxed);
+        last->next = retired.load(std::memory_order_relaxed);
+        while (!retired.compare_exchange_weak(last->next, first,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+    }
+
+    const std::size_t threshold;
+    std::atomic<Record*> records;
+    std::atomic<Retired*> retired;
+    std::atomic<std::size_t> retiredCount;
+};
+
+/**
+ * \brief RAII owner of one hazard slot in a HazardPointerDomain.
+ * \details
+ *   Acquiring a slot scans the slot list of the domain, so keep a
+ *   HazardPointer alive across many reads instead of creating one per read.\n
+ *   A slot protects at most one address at a time, use several HazardPointer
+ *   to traverse linked structures hand over hand.
+ * \sa HazardPointerDomain
+ */
+class HazardPointer
+{
+public:
+    /**
+     * \brief Acquires a hazard slot from `domain`.
+     * \param domain Domain the protected objects are retired to.
+     */
+    explicit HazardPointer(HazardPointerDomain& domain = HazardPointerDomain::global())
+        : record(domain.acquireRecord())
+    {}
+
+    /**
+     * \brief Move constructor, transports the slot to `*this`.
+     * \param other Another HazardPointer to move from.
+     */
+    HazardPointer(HazardPointer&& other) noexcept
+        : record(other.record)
+    { other.record = nullptr; }
+
+    /**
+     * \brief Move assignment, exchanges the slots of `*this` and `other`.
+     * \param other Another HazardPointer to move from.
+     * \return `*this`.
+     */
+    HazardPointer& operator=(HazardPointer&& other) noexcept
+    {
+        std::swap(record, other.record);
+        return *this;
+    }
+
+    HazardPointer(const HazardPointer&) = delete;
+    HazardPointer& operator=(const HazardPointer&) = delete;
+
+    /** \brief Clears and releases the slot. */
+    ~HazardPointer()
+    {
+        if (record) {
+            HazardPointerDomain::releaseRecord(record);
+        }
+    }
+
+    /**
+     * \brief Loads `src` and protects the loaded object from reclamation.
+     * \tparam T    Type of the object.
+     * \param  src  Shared location to load from.
+     * \return The protected pointer, safe to dereference until the slot is
+     *         reset or reused.
+     */
+    template<typename T>
+    T* protect(const std::atomic<T*>& src) noexcept
+    {
+        T* p = src.load(std::memory_order_relaxed);
+        while (!try_protect(p, src)) {
+        }
+        return p;
+    }
+
+    /**
+     * \brief Protects `p`, and validates it is still stored in `src`.
+     * \tparam T    Type of the object.
+     * \param  p    Pointer previously loaded from `src`, receives the current
+     *              value of `src` on failure.
+     * \param  src  Shared location `p` was loaded from.
+     * \return `true` if `p` is protected.
+     */
+    template<typename T>
+    bool try_protect(T*& p, const std::atomic<T*>& src) noexcept
+    {
+        T* expected = p;
+        record->hazard.store(expected, std::memory_order_seq_cst);
+        p = src.load(std::memory_order_seq_cst);
+        if (p != expected) {
+            record->hazard.store(nullptr, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Protects `p` unconditionally, the caller guarantees it was not
+     *        retired yet, e.g. it is reachable from another protected object.
+     * \param p The pointer to protect, `nullptr` clears the slot.
+     */
+    void reset(const void* p = nullptr) noexcept
+    { record->hazard.store(p, std::memory_order_seq_cst); }
+
+private:
+    HazardPointerDomain::Record* record;
+};
+
+/**
+ * \brief Domain of epoch-based reclamation, see Reclamation.hpp for details.
+ * \details
+ *   Each thread registers with ThreadHandle, and pins the domain with Guard
+ *   while reading shared objects. An object retired in epoch `e` is deleted
+ *   once the global epoch reaches `e + 2`, which requires every pinned thread
+ *   to have observed epoch `e + 1`.\n
+ *   Retired objects are kept in three per-thread bags indexed by epoch, and
+ *   handed to the domain when the thread unregisters.
+ * \sa ThreadHandle, Guard
+ */
+class EpochDomain
+{
+    struct Record;
+
+public:
+    class Guard;
+    class ThreadHandle;
+
+    /**
+     * \brief Constructs an empty domain.
+     * \param threshold Number of objects retired by a thread that triggers an
+     *                  attempt to advance the epoch and reclaim.
+     */
+    explicit EpochDomain(std::size_t threshold = 64) noexcept
+        : threshold(threshold), epoch(0), records(nullptr), orphans(nullptr)
+    {}
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    /**
+     * \brief Deletes all retired objects and thread records.
+     * \warning All ThreadHandle of this domain must be destroyed before.
+     */
+    ~EpochDomain()
+    {
+        freeList(orphans.exchange(nullptr, std::memory_order_acquire));
+        Record* record = records.load(std::memory_order_acquire);
+        while (record) {
+            Record* next = record->next;
+            for (Bag& bag : record->bags) {
+                freeList(bag.head);
+            }
+            delete record;
+            record = next;
+        }
+    }
+
+    /**
+     * \brief Default domain shared by the whole process.
+     */
+    static EpochDomain& global()
+    {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /**
+     * \brief Registers the calling thread.
+     * \return Handle owned by the calling thread, unregisters on destruction.
+     */
+    ThreadHandle register_thread();
+
+    /**
+     * \brief Current global epoch, mainly for debugging purposes.
+     */
+    std::uint64_t current_epoch() const noexcept
+    { return epoch.load(std::memory_order_acquire); }
+
+    /**
+     * \brief Advances the global epoch if every pinned thread has observed it.
+     * \return `true` if the epoch was advanced.
+     */
+    bool try_advance() noexcept
+    {
+        std::uint64_t e = epoch.load(std::memory_order_seq_cst);
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            const std::uint64_t local = r->local.load(std::memory_order_seq_cst);
+            if ((local & Pinned) && (local >> 1) != e) {
+                return false;
+            }
+        }
+        return epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+    }
+
+private:
+    enum : std::uint64_t { Pinned = 1 };
+
+    struct Bag
+    {
+        Retired* head = nullptr;
+        std::size_t count = 0;
+        std::uint64_t epoch = 0;
+    };
+
+    struct Record
+    {
+        std::atomic<std::uint64_t> local{0};
+        std::atomic<bool> active{true};
+        Record* next = nullptr;
+        // owned by the registered thread
+        unsigned nesting = 0;
+        std::size_t retiredCount = 0;
+        Bag bags[3];
+    };
+
+    static void freeList(Retired* r)
+    {
+        while (r) {
+            Retired* next = r->next;
+            r->reclaim();
+            r = next;
+        }
+    }
+
+    Record* acquireRecord()
+    {
+        for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            if (!r->active.load(std::memory_order_relaxed)
+                && !r->active.exchange(true, std::memory_order_acquire)) {
+                return r;
+            }
+        }
+        Record* r = new Record;
+        r->next = records.load(std::memory_order_relaxed);
+        while (!records.compare_exchange_weak(r->next, r,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+        return r;
+    }
+
+    void pin(Record* r) noexcept
+    {
+        if (r->nesting++ == 0) {
+            const std::uint64_t e = epoch.load(std::memory_order_seq_cst);
+            r->local.store((e << 1) | Pinned, std::memory_order_seq_cst);
+        }
+    }
+
+    static void unpin(Record* r) noexcept
+    {
+        if (--r->nesting == 0) {
+            const std::uint64_t local = r->local.load(std::memory_order_relaxed);
+            r->local.store(local & ~std::uint64_t(Pinned), std::memory_order_release);
+        }
+    }
+
+    void retire(Record* r, Retired* item)
+    {
+        const std::uint64_t e = epoch.load(std::memory_order_acquire);
+        Bag& bag = r->bags[e % 3];
+        if (bag.epoch != e) {
+            // bag holds objects of epoch e - 3 or older, all unreachable now
+            r->retiredCount -= bag.count;
+            freeList(bag.head);
+            bag.head = nullptr;
+            bag.count = 0;
+            bag.epoch = e;
+        }
+        item->epoch = e;
+        item->next = bag.head;
+        bag.head = item;
+        ++bag.count;
+        if (++r->retiredCount >= threshold) {
+            try_advance();
+            collect(r);
+        }
+    }
+
+    std::size_t collect(Record* r)
+    {
+        const std::uint64_t e = epoch.load(std::memory_order_acquire);
+        std::size_t reclaimed = 0;
+        for (Bag& bag : r->bags) {
+            if (bag.head && bag.epoch + 2 <= e) {
+                freeList(bag.head);
+                reclaimed += bag.count;
+                r->retiredCount -= bag.count;
+                bag.head = nullptr;
+                bag.count = 0;
+            }
+        }
+        return reclaimed + collectOrphans(e);
+    }
+
+    std::size_t collectOrphans(std::uint64_t e)
+    {
+        Retired* list = orphans.exchange(nullptr, std::memory_order_acquire);
+        std::size_t reclaimed = 0;
+        while (list) {
+            Retired* next = list->next;
+            if (list->epoch + 2 <= e) {
+                list->reclaim();
+                ++reclaimed;
+            } else {
+                pushOrphan(list);
+            }
+            list = next;
+        }
+        return reclaimed;
+    }
+
+    void pushOrphan(Retired* item) noexcept
+    {
+        item->next = orphans.load(std::memory_order_relaxed);
+        while (!orphans.compare_exchange_weak(item->next, item,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+    }
+
+    void unregister(Record* r) noexcept
+    {
+        for (Bag& bag : r->bags) {
+            Retired* item = bag.head;
+            while (item) {
+                Retired* next = item->next;
+                pushOrphan(item);
+                item = next;
+            }
+            bag.head = nullptr;
+            bag.count = 0;
+        }
+        r->retiredCount = 0;
+        r->nesting = 0;
+        r->local.store(0, std::memory_order_release);
+        r->active.store(false, std::memory_order_release);
+    }
+
+    const std::size_t threshold;
+    std::atomic<std::uint64_t> epoch;
+    std::atomic<Record*> records;
+    std::atomic<Retired*> orphans;
+};
+
+/**
+ * \brief RAII pin of an EpochDomain, objects retired while it lives are not
+ *        deleted until it is destroyed.
+ * \details Guards may be nested within one thread.
+ * \sa EpochDomain::ThreadHandle::pin
+ */
+class EpochDomain::Guard
+{
+public:
+    /**
+     * \brief Move constructor, transports the pin to `*this`.
+     * \param other Another Guard to move from.
+     */
+    Guard(Guard&& other) noexcept
+        : domain(other.domain), record(other.record)
+    { other.record = nullptr; }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    /** \brief Unpins the domain. */
+    ~Guard()
+    {
+        if (record) {
+            EpochDomain::unpin(record);
+        }
+    }
+
+private:
+    friend class ThreadHandle;
+
+    Guard(EpochDomain& d, Record* r) noexcept
+        : domain(&d), record(r)
+    { domain->pin(record); }
+
+    EpochDomain* domain;
+    Record* record;
+};
+
+/**
+ * \brief Registration of one thread in an EpochDomain.
+ * \details
+ *   A ThreadHandle must only be used by the thread that created it. Objects
+ *   it retired but not yet deleted are handed over to the domain on
+ *   destruction.
+ * \sa EpochDomain::register_thread
+ */
+class EpochDomain::ThreadHandle
+{
+public:
+    /**
+     * \brief Move constructor, transports the registration to `*this`.
+     * \param other Another ThreadHandle to move from.
+     */
+    ThreadHandle(ThreadHandle&& other) noexcept
+        : domain(other.domain), record(other.record)
+    { other.record = nullptr; }
+
+    ThreadHandle(const ThreadHandle&) = delete;
+    ThreadHandle& operator=(const ThreadHandle&) = delete;
+
+    /** \brief Unregisters the thread. */
+    ~ThreadHandle()
+    {
+        if (record) {
+            domain->unregister(record);
+        }
+    }
+
+    /**
+     * \brief Pins the domain for a read-side critical section.
+     * \return RAII guard, unpins on destruction.
+     */
+    Guard pin() noexcept
+    { return Guard(*domain, record); }
+
+    /**
+     * \brief Retires an object already unlinked from all shared locations.
+     * \tparam T        Type of the retired object.
+     * \tparam Deleter  Type of deleter, default is `std::default_delete<T>`.
+     * \param  p        Object to retire, `nullptr` is ignored.
+     * \param  d        Deleter to destroy `p` two epochs later.
+     */
+    template<typename T, typename Deleter = std::default_delete<T>>
+    void retire(T* p, Deleter d = Deleter())
+    {
+        if (p) {
+            domain->retire(record, Retired::create(p, std::move(d)));
+        }
+    }
+
+    /**
+     * \brief Tries to advance the epoch, then deletes every object retired by
+     *        this thread (or by exited threads) that became unreachable.
+     * \return Number of objects deleted.
+     */
+    std::size_t collect()
+    {
+        domain->try_advance();
+        return domain->collect(record);
+    }
+
+private:
+    friend class EpochDomain;
+
+    ThreadHandle(EpochDomain& d, Record* r) noexcept
+        : domain(&d), record(r)
+    {}
+
+    EpochDomain* domain;
+    Record* record;
+};
+
+inline EpochDomain::ThreadHandle EpochDomain::register_thread()
+{ return ThreadHandle(*this, acquireRecord()); }
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_RECLAMATION_HPP
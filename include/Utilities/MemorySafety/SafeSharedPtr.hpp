@@ -1,11 +1,15 @@
 ﻿#ifndef CPP_UTILITIES_MEMORYSAFETY_SAFESHAREDPTR_HPP
 #define CPP_UTILITIES_MEMORYSAFETY_SAFESHAREDPTR_HPP
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <type_traits>
 #include "../Common.h"
+#include "LockHolder.hpp"
 #if __cplusplus >= 201703L
+#include <mutex>
 #include <shared_mutex>
 #else
 #include "RWSpinLock.hpp"
@@ -22,7 +26,43 @@
  *                               thread-safety while operating the underlying
  *                               pointer.\n
  *     - Memory::SafeWeakPtr : A wrapper to `std::weak_ptr` to cooperate with
- *                             Memory::SafeSharedPtr.
+ *                             Memory::SafeSharedPtr.\n
+ *     - Memory::AtomicSafeSharedPtr : Lock-free atomic holder of a
+ *                                     Memory::SafeSharedPtr handle.\n
+ *     - Memory::HazardPointerDomain / Memory::EpochDomain : Deferred
+ *       reclamation with hazard pointers and epochs for lock-free readers.\n
+ *     - Memory::ProfiledLock / Memory::LockProfiler : Opt-in contention
+ *       profiling of the locks used by Memory::SafeSharedPtr.\n
+ *     - Memory::AsyncSharedMutex : Read-write lock acquired by `co_await`
+ *       from C++20 coroutines without blocking the thread.\n
+ *     - Memory::LocalSafeSharedPtr : Thread-confined handle of a
+ *       Memory::SafeSharedPtr with non-atomic counting of its copies.\n
+ *     - Memory::CompactSafeWeakPtr / Memory::make_compact : Object and lock in
+ *       one control block, observed by a single weak reference.\n
+ *     - Memory::StripedSafeArray : Shared array whose elements are guarded by
+ *       interleaved lock stripes instead of a single lock.\n
+ *     - Memory::SafeLockPolicy / Memory::StripedLockPolicy : Choice of the
+ *       lock of each object, e.g. a shared table instead of one allocation.\n
+ *     - Memory::DistributedSharedMutex : Read-write lock with per-thread reader
+ *       slots, for read-mostly objects read from many cores.\n
+ *     - Memory::RWTicketSpinLockT : Fair ticket read-write spin lock, whose
+ *       writers are not starved by a steady read load.\n
+ *     - Memory::CacheLinePadded : Lock alone on its cache line, against false
+ *       sharing between neighbouring locks.\n
+ *     - Memory::MicroRWLock / Memory::PackedLockPtr : Read-write locks of one
+ *       byte, or packed into the caller's word or pointer.\n
+ *     - Memory::RWSpinLock64T : 64-bit read-write spin lock counting its
+ *       waiting writers and upgraders, with a diagnostic snapshot.\n
+ *     - Memory::SeqLock / Memory::SeqLocked : Sequence lock whose readers
+ *       validate a version instead of locking, for read-mostly snapshots.\n
+ *     - Memory::CombiningMutex : Flat-combining lock whose writers publish
+ *       their operations to one combining thread, for write-heavy objects.\n
+ *     - Memory::CohortRWLock : Cohort lock keeping the write lock within a
+ *       group of CPUs up to a fairness bound, for multi-socket machines.\n
+ *     - Memory::DeferredWriteMutex : Lock queueing fire-and-forget writes
+ *       posted with SafeSharedPtr::post_write(), applied by lock holders.\n
+ *     - Memory::ObjectPool / Memory::make_pooled : Pool recycling object, lock
+ *       and control block of SafeSharedPtr objects without the allocator.
  * @{
  */
 
@@ -46,6 +86,21 @@ template<typename T,
          typename read_lock_t,
          typename write_lock_t>
 class EnableSafeSharedFromThis;
+template<typename T,
+         typename mutex_t,
+         typename read_lock_t,
+         typename write_lock_t>
+class EnableEmbeddedSafeSharedFromThis;
+template<typename T,
+         typename mutex_t,
+         typename read_lock_t,
+         typename write_lock_t>
+class AtomicSafeSharedPtr;
+template<typename T,
+         typename mutex_t,
+         typename read_lock_t,
+         typename write_lock_t>
+class CompactSafeWeakPtr;
 
 #if __cplusplus >= 201703L
     /**
@@ -81,6 +136,75 @@ class EnableSafeSharedFromThis;
     using unique_lock_t = RWSpinLock::WriteHolder;
 #endif
 
+/**
+ * \brief Policy choosing the lock of objects of type `T` managed by
+ *        SafeSharedPtr.
+ * \tparam T       Type of the managed object, without cv-qualifiers and
+ *                 array extents.
+ * \tparam mutex_t Type of the mutex used by SafeSharedPtr.
+ * \details
+ *   The primary template allocates one lock per object. Specialize it to
+ *   place the locks elsewhere, e.g. in a shared table with StripedLockPolicy:
+ *   ```cpp
+ *   UTILITIES_NAMESPACE_BEGIN
+ *   namespace Memory {
+ *   template<>
+ *   struct SafeLockPolicy<Node, shared_mutex_t>
+ *       : StripedLockPolicy<shared_mutex_t, 4096, Node>
+ *   {};
+ *   } // namespace Memory
+ *   UTILITIES_NAMESPACE_END
+ *   ```
+ *   A policy provides `create(owner)`, returning the lock of the object
+ *   managed by the `std::shared_ptr` `owner`, possibly empty, and
+ *   `create(owner, alloc)` doing the same with the allocator given to
+ *   SafeSharedPtr. It is called once per managed object, copies and
+ *   conversions of SafeSharedPtr share the lock returned.\n
+ *   Objects deriving from EnableSafeSharedFromThis or
+ *   EnableEmbeddedSafeSharedFromThis own their lock, the policy is not used
+ *   for them.
+ * \sa StripedLockPolicy
+ */
+template<typename T, typename mutex_t>
+struct SafeLockPolicy
+{
+    /**
+     * \brief Allocates a new lock for the object managed by `owner`.
+     * \exception std::bad_alloc If the lock could not be allocated.
+     */
+    template<typename Y>
+    static std::shared_ptr<mutex_t> create(const std::shared_ptr<Y>&)
+    { return std::make_shared<mutex_t>(); }
+
+    /**
+     * \brief Allocates a new lock for the object managed by `owner` with
+     *        `alloc`, rebound to the lock and its control block.
+     * \exception UserDefined Exceptions thrown from `Alloc::allocate()`.
+     */
+    template<typename Y, typename Alloc>
+    static std::shared_ptr<mutex_t> create(const std::shared_ptr<Y>&, const Alloc& alloc)
+    { return std::allocate_shared<mutex_t>(alloc); }
+};
+
+/**
+ * \brief Allocation of make_compact() and make_pooled(): the object, then its
+ *        lock, in one control block.
+ * \details
+ *   The lock is destroyed first, while the object is still alive, see
+ *   SafeSharedPtr::post_write().
+ */
+template<typename T, typename mutex_t>
+struct CompactBlock
+{
+    template<typename... Args>
+    explicit CompactBlock(Args&&... args)
+        : value(std::forward<Args>(args)...)
+    {}
+
+    T value;
+    mutex_t mutex;
+};
+
 /**
  * \brief Wrapper to `std::shared_ptr` to provide thread-safety while operating
  *        the underlying pointer.
@@ -184,7 +308,7 @@ class EnableSafeSharedFromThis;
  *   std::cout << point->x() << " " << point->y() << std::endl;
  *   ```
  *
- * \sa SafeWeakPtr, EnableSafeSharedFromThis
+ * \sa SafeWeakPtr, EnableSafeSharedFromThis, EnableEmbeddedSafeSharedFromThis
  */
 template<typename T,
          typename mutex_t = shared_mutex_t,
@@ -194,6 +318,41 @@ class SafeSharedPtr
 {
     template<typename Y, typename M, typename R, typename W>
     friend class SafeSharedPtr;
+    template<typename Y, typename M, typename R, typename W>
+    friend class EnableSafeSharedFromThis;
+    template<typename Y, typename M, typename R, typename W>
+    friend class EnableEmbeddedSafeSharedFromThis;
+
+    /** Whether `Y` carries its own lock, see EnableSafeSharedFromThis. */
+    template<typename Y>
+    using OwnsLock = std::integral_constant<bool,
+        std::is_base_of<EnableSafeSharedFromThis<Y, mutex_t, read_lock_t, write_lock_t>, Y>::value
+        || std::is_base_of<EnableEmbeddedSafeSharedFromThis<Y, mutex_t, read_lock_t, write_lock_t>, Y>::value>;
+
+    /** Where the locks of the objects which do not own one come from. */
+    using LockPolicy = SafeLockPolicy<typename std::remove_cv<typename std::remove_extent<T>::type>::type, mutex_t>;
+
+    /** Lock of an object deriving from EnableSafeSharedFromThis. */
+    template<typename U, typename Y>
+    static std::shared_ptr<mutex_t> lock_of(const std::shared_ptr<U>&, Y* object,
+        typename std::enable_if<!std::is_base_of<EnableEmbeddedSafeSharedFromThis<Y, mutex_t, read_lock_t, write_lock_t>, Y>::value>::type* = nullptr)
+    { return object->__safeSharedLock; }
+
+    /** Lock of an object deriving from EnableEmbeddedSafeSharedFromThis, aliasing its owner. */
+    template<typename U, typename Y>
+    static std::shared_ptr<mutex_t> lock_of(const std::shared_ptr<U>& owner, Y* object,
+        typename std::enable_if<std::is_base_of<EnableEmbeddedSafeSharedFromThis<Y, mutex_t, read_lock_t, write_lock_t>, Y>::value>::type* = nullptr)
+    { return std::shared_ptr<mutex_t>(owner, &object->__safeSharedMutex); }
+
+    /** Whether the lock lies after the object in its CompactBlock. */
+    bool compact() const noexcept
+    {
+        const std::uintptr_t object = reinterpret_cast<std::uintptr_t>(ptr.get());
+        const std::uintptr_t lock = reinterpret_cast<std::uintptr_t>(mutex.get());
+        return !ptr.owner_before(mutex) && !mutex.owner_before(ptr)
+               && lock >= object + sizeof(typename std::remove_extent<T>::type)
+               && lock < object + sizeof(CompactBlock<typename std::remove_extent<T>::type, mutex_t>);
+    }
 
 public:
     template<typename Lock> class PtrHelper;
@@ -226,7 +385,7 @@ public:
      *   called if an exception occurs.
      */
     constexpr SafeSharedPtr()
-        : mutex(std::make_shared<SharedMutex>())
+        : mutex(LockPolicy::create(std::shared_ptr<T>()))
     {}
 
     /**
@@ -239,7 +398,7 @@ public:
      *   called if an exception occurs.
      */
     constexpr SafeSharedPtr(std::nullptr_t p)
-        : mutex(std::make_shared<SharedMutex>()),
+        : mutex(LockPolicy::create(std::shared_ptr<T>())),
           ptr(p)
     {}
 
@@ -258,11 +417,9 @@ public:
      */
     template<typename Y>
     explicit SafeSharedPtr(Y* p,
-                           typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(p)
-    {
-    }
+                           typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(p)
+    { mutex = LockPolicy::create(ptr); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with a managed object.
@@ -279,9 +436,9 @@ public:
      */
     template<typename Y>
     explicit SafeSharedPtr(Y* p,
-                           typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
+                           typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
         : ptr(p)
-    { mutex = ptr->__safeSharedLock; }
+    { mutex = lock_of(ptr, p); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with a managed object of specified
@@ -303,11 +460,9 @@ public:
      */
     template<typename Y, typename Deleter>
     SafeSharedPtr(Y* p, Deleter d,
-                  typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(p, d)
-    {
-    }
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(p, d)
+    { mutex = LockPolicy::create(ptr); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with a managed object of specified
@@ -329,9 +484,9 @@ public:
      */
     template<typename Y, typename Deleter>
     SafeSharedPtr(Y* p, Deleter d,
-                  typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
         : ptr(p, d)
-    { mutex = ptr->__safeSharedLock; }
+    { mutex = lock_of(ptr, p); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with with no managed but has specified
@@ -352,9 +507,8 @@ public:
      */
     template<typename Deleter>
     SafeSharedPtr(std::nullptr_t p, Deleter d)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(p, d)
-    {}
+        : ptr(p, d)
+    { mutex = LockPolicy::create(ptr); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with a managed object of specified
@@ -368,7 +522,8 @@ public:
      *                  formed, have well-defined behavior and not throw any
      *                  exceptions.
      * \param   alloc   Allocator to use for allocations of data for internal
-     *                  use, must satisfy C++ named requirements of `Allocator`.
+     *                  use, including the lock, must satisfy C++ named
+     *                  requirements of `Allocator`.
      * \exception std::bad_alloc
      *   If read-write lock could not be obtained. May throw
      *   implementation-defined exception for other errors. `delete mutex` is
@@ -379,15 +534,14 @@ public:
      */
     template<typename Y, typename Deleter, typename Alloc>
     SafeSharedPtr(Y* p, Deleter d, Alloc alloc,
-                  typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(p, d, alloc)
-    {}
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(p, d, alloc)
+    { mutex = LockPolicy::create(ptr, alloc); }
     template<typename Y, typename Deleter, typename Alloc>
     SafeSharedPtr(Y* p, Deleter d, Alloc alloc,
-                  typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
         : ptr(p, d, alloc)
-    { mutex = ptr->__safeSharedLock; }
+    { mutex = lock_of(ptr, p); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` with no managed but has specified
@@ -400,7 +554,8 @@ public:
      *                  formed, have well-defined behavior and not throw any
      *                  exceptions.
      * \param   alloc   Allocator to use for allocations of data for internal
-     *                  use, must satisfy C++ named requirements of `Allocator`.
+     *                  use, including the lock, must satisfy C++ named
+     *                  requirements of `Allocator`.
      * \exception std::bad_alloc
      *   If read-write lock could not be obtained. May throw
      *   implementation-defined exception for other errors. `delete mutex` is
@@ -411,9 +566,8 @@ public:
      */
     template<typename Deleter, typename Alloc>
     SafeSharedPtr(std::nullptr_t p, Deleter d, Alloc alloc)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(p, d, alloc)
-    {}
+        : ptr(p, d, alloc)
+    { mutex = LockPolicy::create(ptr, alloc); }
 
     /**
      * \brief The aliasing constructor: constructs a `SafeSharedPtr` which shares
@@ -457,13 +611,13 @@ public:
      */
     template<typename Y>
     SafeSharedPtr(const std::shared_ptr<Y>& other, T* p,
-                  typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr) noexcept
-        : mutex(std::make_shared<SharedMutex>()), ptr(other, p)
-    {}
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr) noexcept
+        : ptr(other, p)
+    { mutex = LockPolicy::create(ptr); }
     template<typename Y>
     SafeSharedPtr(const std::shared_ptr<Y>& other, T* p,
-                  typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr) noexcept
-        : mutex(other->__safeSharedLock), ptr(other, p)
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr) noexcept
+        : mutex(lock_of(other, other.get())), ptr(other, p)
     {
     }
 
@@ -548,14 +702,14 @@ public:
      */
     template<typename Y>
     SafeSharedPtr(const std::shared_ptr<Y>& other,
-                  typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
-        : mutex(std::make_shared<SharedMutex>()), ptr(other)
-    {}
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(other)
+    { mutex = LockPolicy::create(ptr); }
     template<typename Y>
     SafeSharedPtr(const std::shared_ptr<Y>& other,
-                  typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
         : ptr(other)
-    { mutex = ptr->__safeSharedLock; }
+    { mutex = lock_of(ptr, ptr.get()); }
 
     /**
      * \brief Move-constructs a `SafeSharedPtr` from `other`. After the
@@ -570,15 +724,42 @@ public:
      */
     template<typename Y>
     SafeSharedPtr(std::shared_ptr<Y>&& other,
-                  typename std::enable_if<!std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
-        : mutex(std::make_shared<SharedMutex>()),
-          ptr(std::forward<std::shared_ptr<Y>>(other))
-    {}
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(std::forward<std::shared_ptr<Y>>(other))
+    { mutex = LockPolicy::create(ptr); }
     template<typename Y>
     SafeSharedPtr(std::shared_ptr<Y>&& other,
-                  typename std::enable_if<std::is_base_of<EnableSafeSharedFromThis<Y, SharedMutex, SharedLock, UniqueLock>, Y>::value>::type* = nullptr)
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
         : ptr(std::forward<std::shared_ptr<Y>>(other))
-    { mutex = ptr->__safeSharedLock; }
+    { mutex = lock_of(ptr, ptr.get()); }
+
+    /**
+     * \brief Constructs a `SafeSharedPtr` which takes the ownership of the
+     *        object managed by `other`, allocating its lock with `alloc`.
+     * \tparam  Alloc   Type of specified allocator.
+     * \tparam  Y       Type of input pointer.
+     * \param   alloc   Allocator to use for the lock, rebound as needed, must
+     *                  satisfy C++ named requirements of `Allocator`.
+     * \param   other   Another shared pointer to acquire the ownership from.
+     * \exception UserDefined
+     *   Exceptions thrown from `Alloc::allocate()`, `other` still releases
+     *   its object then.
+     * \details
+     *   Objects deriving from EnableSafeSharedFromThis keep the lock they
+     *   were constructed with, see
+     *   EnableSafeSharedFromThis(std::allocator_arg_t, const Alloc&).
+     * \sa allocate_shared
+     */
+    template<typename Alloc, typename Y>
+    SafeSharedPtr(std::allocator_arg_t, const Alloc& alloc, std::shared_ptr<Y> other,
+                  typename std::enable_if<!OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(std::move(other))
+    { mutex = LockPolicy::create(ptr, alloc); }
+    template<typename Alloc, typename Y>
+    SafeSharedPtr(std::allocator_arg_t, const Alloc&, std::shared_ptr<Y> other,
+                  typename std::enable_if<OwnsLock<Y>::value>::type* = nullptr)
+        : ptr(std::move(other))
+    { mutex = lock_of(ptr, ptr.get()); }
 
     /**
      * \brief Constructs a `SafeSharedPtr` which shares ownership of the object
@@ -850,7 +1031,8 @@ public:
      * \param   ptr     Pointer to an object to acquire ownership of.
      * \param   d       Deleter to store for deletion of the object.
      * \param   alloc   Allocator to use for allocations of data for internal
-     *                  use, must satisfy C++ named requirements of `Allocator`.
+     *                  use, including the lock, must satisfy C++ named
+     *                  requirements of `Allocator`.
      * \details
      *   Equivalent to `SafeSharedPtr<T>(ptr, d, alloc).swap(*this)`.\n
      *   Replaces the managed object with an object pointed to by `ptr`. Optional
@@ -1014,9 +1196,13 @@ public:
      *       former shared owners may not have completed, and because new shared
      *       owners may be introduced concurrently, such as by
      *       SafeWeakPtr::lock.
+     *   \n
+     *   Objects created by make_compact() keep their lock in the same control
+     *   block, which counts each SafeSharedPtr twice; this is compensated
+     *   here.
      */
     long use_count() const noexcept
-    { return ptr.use_count(); }
+    { return compact(mutex, ptr) ? ptr.use_count() / 2 : ptr.use_count(); }
 
     /**
      * \brief Checks if *this stores a non-null pointer, i.e. whether
@@ -1147,6 +1333,214 @@ public:
     UniqueLock unique_lock() const
     { return std::move(UniqueLock(*mutex)); }
 
+    /**
+     * \brief Tries to gain read access without blocking.
+     * \return A PtrHelper guarding the stored pointer with **read lock** if
+     *         the lock was acquired, otherwise an empty PtrHelper which
+     *         converts to `nullptr`.
+     * \details
+     *   Never succeeds if the stored pointer is null.\n
+     *   `SharedLock` must be constructible from `(SharedMutex&,
+     *   std::adopt_lock_t)`, as all locks of this module are.
+     *   ```cpp
+     *   if (const auto& config = ptr.try_read()) {
+     *       use(config->value);
+     *   } else {
+     *       shed_load();
+     *   }
+     *   ```
+     * \note This method is thread-safe.
+     * \sa try_read_for, try_read_until, try_write
+     */
+    const PtrHelper<SharedLock> try_read() const
+    {
+        if (get() && mutex->try_lock_shared()) {
+            return PtrHelper<SharedLock>(get(), SharedLock(*mutex, std::adopt_lock));
+        }
+        return PtrHelper<SharedLock>(nullptr, SharedLock());
+    }
+
+    /**
+     * \brief Tries to gain read access, blocking at most for `timeout`.
+     * \param timeout Maximum time to wait.
+     * \return Same as try_read().
+     * \note This method is thread-safe.
+     * \sa try_read, try_read_until
+     */
+    template<typename Rep, typename Period>
+    const PtrHelper<SharedLock> try_read_for(const std::chrono::duration<Rep, Period>& timeout) const
+    { return read_until(std::chrono::steady_clock::now() + timeout); }
+
+    /**
+     * \brief Tries to gain read access, blocking at most until `deadline`.
+     * \param deadline Time point to give up at.
+     * \return Same as try_read().
+     * \details
+     *   Waits with TimedLocking, i.e. with the timed functions of the lock if
+     *   it has them, polling otherwise.
+     * \note This method is thread-safe.
+     * \sa try_read, try_read_for
+     */
+    template<typename Clock, typename Duration>
+    const PtrHelper<SharedLock> try_read_until(const std::chrono::time_point<Clock, Duration>& deadline) const
+    { return read_until(deadline); }
+
+    /**
+     * \brief Tries to gain write access without blocking.
+     * \return A PtrHelper guarding the stored pointer with **write lock** if
+     *         the lock was acquired, otherwise an empty PtrHelper which
+     *         converts to `nullptr`.
+     * \details
+     *   Never succeeds if the stored pointer is null.\n
+     *   `UniqueLock` must be constructible from `(SharedMutex&,
+     *   std::adopt_lock_t)`, as all locks of this module are.
+     * \note This method is thread-safe.
+     * \sa try_write_for, try_write_until, try_read
+     */
+    PtrHelper<UniqueLock> try_write()
+    {
+        if (get() && mutex->try_lock()) {
+            return PtrHelper<UniqueLock>(get(), UniqueLock(*mutex, std::adopt_lock));
+        }
+        return PtrHelper<UniqueLock>(nullptr, UniqueLock());
+    }
+
+    /**
+     * \brief Tries to gain write access, blocking at most for `timeout`.
+     * \param timeout Maximum time to wait.
+     * \return Same as try_write().
+     * \note This method is thread-safe.
+     * \sa try_write, try_write_until
+     */
+    template<typename Rep, typename Period>
+    PtrHelper<UniqueLock> try_write_for(const std::chrono::duration<Rep, Period>& timeout)
+    { return try_write_until(std::chrono::steady_clock::now() + timeout); }
+
+    /**
+     * \brief Tries to gain write access, blocking at most until `deadline`.
+     * \param deadline Time point to give up at.
+     * \return Same as try_write().
+     * \details
+     *   Waits with TimedLocking, i.e. with the timed functions of the lock if
+     *   it has them, polling otherwise.
+     * \note This method is thread-safe.
+     * \sa try_write, try_write_for
+     */
+    template<typename Clock, typename Duration>
+    PtrHelper<UniqueLock> try_write_until(const std::chrono::time_point<Clock, Duration>& deadline)
+    {
+        if (get() && TimedLocking::try_lock_until(*mutex, deadline)) {
+            return PtrHelper<UniqueLock>(get(), UniqueLock(*mutex, std::adopt_lock));
+        }
+        return PtrHelper<UniqueLock>(nullptr, UniqueLock());
+    }
+
+#if __cplusplus >= 202002L
+    /**
+     * \brief Gains read access from a coroutine, suspending it instead of
+     *        blocking the thread.
+     * \return An awaitable, `co_await` on it returns a PtrHelper guarding the
+     *         stored pointer with **read lock**.
+     * \details
+     *   Requires a lock providing `lock_shared_async()`, like AsyncSharedMutex
+     *   used by AsyncSafeSharedPtr. The coroutine is resumed by the thread
+     *   releasing the lock.
+     *   ```cpp
+     *   const auto& config = co_await ptr.async_read();
+     *   use(config->value);
+     *   ```
+     * \note This method is thread-safe, requires C++20.
+     * \sa async_write, AsyncSharedMutex
+     */
+    auto async_read() const
+    {
+        using Awaiter = decltype(mutex->lock_shared_async());
+        return AsyncHelper<const PtrHelper<SharedLock>, SharedLock, Awaiter>(
+            get(), *mutex, mutex->lock_shared_async());
+    }
+
+    /**
+     * \brief Gains write access from a coroutine, suspending it instead of
+     *        blocking the thread.
+     * \return An awaitable, `co_await` on it returns a PtrHelper guarding the
+     *         stored pointer with **write lock**.
+     * \details Requires a lock providing `lock_async()`, see async_read().
+     * \note This method is thread-safe, requires C++20.
+     * \sa async_read, AsyncSharedMutex
+     */
+    auto async_write()
+    {
+        using Awaiter = decltype(mutex->lock_async());
+        return AsyncHelper<PtrHelper<UniqueLock>, UniqueLock, Awaiter>(
+            get(), *mutex, mutex->lock_async());
+    }
+#endif
+
+    /**
+     * \brief Calls `fn` on the stored object under write lock, batched with
+     *        the calls of other threads.
+     * \return The result of `fn(object)`, an exception thrown by `fn` is
+     *         rethrown here.
+     * \details
+     *   Requires a lock providing `combine()`, like CombiningMutex used by
+     *   CombiningSafeSharedPtr. `fn` may be run by the thread currently
+     *   holding the lock, while this one waits for it.
+     *   ```cpp
+     *   ptr.combine([&](std::vector<int>& v) { v.push_back(value); });
+     *   ```
+     * \note This method is thread-safe.
+     * \sa CombiningMutex
+     */
+    template<typename Fn>
+    auto combine(Fn&& fn) -> decltype(fn(std::declval<element_type&>()))
+    {
+        element_type* object = get();
+        return mutex->combine([&fn, object]() -> decltype(fn(std::declval<element_type&>())) {
+            return fn(*object);
+        });
+    }
+
+    /**
+     * \brief Queues a call of `fn` on the stored object under write lock,
+     *        without waiting for the lock.
+     * \details
+     *   Requires a lock providing `post()` and `flush()`, like
+     *   DeferredWriteMutex used by DeferredSafeSharedPtr. `fn` runs later, on
+     *   the thread draining the queue, and must not throw. The object is kept
+     *   alive until then, or, when the lock lies in the allocation of the
+     *   object as with make_compact() and make_pooled(), the writes still
+     *   queued run when the last handle is dropped, before the object is
+     *   destroyed.
+     *   ```cpp
+     *   ptr.post_write([](Stats& s) { ++s.requests; });
+     *   ```
+     * \note This method is thread-safe.
+     * \warning Not available for objects deriving from
+     *          EnableSafeSharedFromThis or EnableEmbeddedSafeSharedFromThis,
+     *          whose lock is destroyed after the object.
+     * \sa flush, DeferredWriteMutex
+     */
+    template<typename Fn>
+    void post_write(Fn fn)
+    {
+        static_assert(!OwnsLock<T>::value, "post_write() does not support objects owning their lock");
+        // Owning the object from a lock in its own allocation would keep both
+        // alive forever, such a lock runs its queue when destroyed, before the
+        // object. Any other lock, even one aliasing the owner like those of
+        // StripedLockPolicy, may outlive the object: the queue owns it.
+        std::shared_ptr<T> object = compact() ? std::shared_ptr<T>(std::shared_ptr<T>(), ptr.get()) : ptr;
+        mutex->post([object, fn]() mutable { fn(*object.get()); });
+    }
+
+    /**
+     * \brief Runs the writes queued by post_write(), waiting for the write
+     *        lock if any is pending.
+     * \note This method is thread-safe.
+     * \sa post_write
+     */
+    void flush()
+    { mutex->flush(); }
+
     /**
      * \brief Proxy class for operator-> in SafeSharedPtr, behave like
      *        underlying object, and provide RAII read-write lock for
@@ -1243,6 +1637,14 @@ public:
         { return ptr; }
 
     private:
+        friend class SafeSharedPtr;
+
+        PtrHelper(T* p, Lock&& l)
+            : ptr(p),
+              lock(std::move(l))
+        {
+        }
+
         T* const ptr = nullptr;
         Lock lock;
 
@@ -1479,11 +1881,61 @@ public:
 
 private:
     SafeSharedPtr(std::shared_ptr<SharedMutex> l, std::shared_ptr<T> p)
-        : mutex(l), ptr(p)
+        : mutex(std::move(l)), ptr(std::move(p))
     {}
 
+    template<typename Clock, typename Duration>
+    PtrHelper<SharedLock> read_until(const std::chrono::time_point<Clock, Duration>& deadline) const
+    {
+        if (get() && TimedLocking::try_lock_shared_until(*mutex, deadline)) {
+            return PtrHelper<SharedLock>(get(), SharedLock(*mutex, std::adopt_lock));
+        }
+        return PtrHelper<SharedLock>(nullptr, SharedLock());
+    }
+
+#if __cplusplus >= 202002L
+    /** Awaitable of async_read() / async_write(), wraps the lock's own awaitable. */
+    template<typename Helper, typename Lock, typename Awaiter>
+    class AsyncHelper
+    {
+    public:
+        AsyncHelper(T* p, SharedMutex& m, Awaiter a)
+            : ptr(p),
+              mutex(m),
+              awaiter(std::move(a))
+        {}
+
+        bool await_ready()
+        { return awaiter.await_ready(); }
+
+        template<typename Handle>
+        auto await_suspend(Handle handle)
+        { return awaiter.await_suspend(handle); }
+
+        Helper await_resume()
+        {
+            awaiter.await_resume();
+            return Helper(ptr, Lock(mutex, std::adopt_lock));
+        }
+
+    private:
+        T* ptr;
+        SharedMutex& mutex;
+        Awaiter awaiter;
+    };
+#endif
+
+    /** Whether the lock and the object share one control block, see make_compact(). */
+    template<typename M, typename P>
+    static bool compact(const M& m, const P& p) noexcept
+    { return !m.owner_before(p) && !p.owner_before(m) && p.use_count() != 0; }
+
     template<typename Y, typename M, typename R, typename W>
     friend class SafeWeakPtr;
+    template<typename Y, typename M, typename R, typename W>
+    friend class AtomicSafeSharedPtr;
+    template<typename Y, typename M, typename R, typename W>
+    friend class CompactSafeWeakPtr;
     mutable std::shared_ptr<SharedMutex> mutex;
     std::shared_ptr<T> ptr;
 };
@@ -1607,6 +2059,12 @@ inline SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> make_shared(Args&&.
  *   separate custom deleter: the supplied allocator is used for destruction of
  *   the control block and the `T` object, and for deallocation of their shared
  *   memory block.\n
+ *   The lock of the object is allocated with `alloc` as well, through
+ *   SafeLockPolicy. An object deriving from EnableSafeSharedFromThis creates
+ *   its own lock instead, forward the allocator from a uses-allocator
+ *   constructor of `T` to
+ *   EnableSafeSharedFromThis(std::allocator_arg_t, const Alloc&) to keep it
+ *   in the same memory.\n
  *   A constructor enables `shared_from_this` with a pointer ptr of type `U*`
  *   means that it determines if `U` has a base class that is a specialization of
  *   `std::enable_shared_from_this`, and if so, the constructor evaluates the
@@ -1636,7 +2094,7 @@ inline SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> allocate_shared(con
                                                                              Args&&... args)
 {
     std::shared_ptr<T> p = std::allocate_shared<T>(alloc, std::forward<Args>(args)...);
-    return SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>(p, p.get());
+    return SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>(std::allocator_arg, alloc, std::move(p));
 }
 
 /**
@@ -2457,13 +2915,19 @@ public:
     using UniqueLock = write_lock_t;
 
     /** \brief Same element_type of SafeSharedPtr. */
-    using element_type = typename SafeSharedPtr<T>::element_type;
+    using element_type = typename SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>::element_type;
 
     /**
      * \brief Default constructor. Constructs empty weak_ptr.
      */
     constexpr SafeWeakPtr() noexcept = default;
 
+    /**
+     * \brief Copy constructor, shares the object managed by `other`.
+     * \param   other   Weak pointer to share object from.
+     */
+    SafeWeakPtr(const SafeWeakPtr& other) noexcept = default;
+
     /**
      * \brief Constructs new SafeWeakPtr that shares an object with `other`.
      * \tparam  Y       Element type of input weak pointer.
@@ -2508,9 +2972,9 @@ public:
      *   The implementation may meet the requirements without creating a
      *   temporary SafeWeakPtr object.
      */
-    SafeWeakPtr<T>& operator=(const SafeWeakPtr<T>& other) noexcept
+    SafeWeakPtr& operator=(const SafeWeakPtr& other) noexcept
     {
-        SafeWeakPtr<T>(other).swap(*this);
+        SafeWeakPtr(other).swap(*this);
         return *this;
     }
 
@@ -2528,9 +2992,9 @@ public:
      *   temporary SafeWeakPtr object.
      */
     template<typename Y>
-    SafeWeakPtr<T>& operator=(const SafeWeakPtr<Y, SharedMutex, SharedLock, UniqueLock>& other) noexcept
+    SafeWeakPtr& operator=(const SafeWeakPtr<Y, SharedMutex, SharedLock, UniqueLock>& other) noexcept
     {
-        SafeWeakPtr<T>(other).swap(*this);
+        SafeWeakPtr(other).swap(*this);
         return *this;
     }
 
@@ -2539,7 +3003,7 @@ public:
      *        `*this` manages no object.
      */
     void reset() noexcept
-    { SafeWeakPtr<T>().swap(*this); }
+    { SafeWeakPtr().swap(*this); }
 
     /**
      * \brief Exchanges the contents of `*this` and `other`.
@@ -2548,7 +3012,7 @@ public:
      *   **Complexity**\n
      *   Constant.
      */
-    void swap(SafeWeakPtr<T>& other) noexcept
+    void swap(SafeWeakPtr& other) noexcept
     {
         mutex.swap(other.mutex);
         ptr.swap(other.ptr);
@@ -2570,7 +3034,10 @@ public:
      * \sa expired
      */
     long use_count() const noexcept
-    { return ptr.use_count(); }
+    {
+        using Shared = SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>;
+        return Shared::compact(mutex, ptr) ? ptr.use_count() / 2 : ptr.use_count();
+    }
 
     /**
      * \brief Checks whether the referenced object was already deleted.
@@ -2600,7 +3067,8 @@ public:
      *   returned `SafeSharedPtr` also is empty.\\n
      *   Effectively returns
      *   `expired() ? SafeSharedPtr<T>() : SafeSharedPtr<T>(*this)`, executed
-     *   atomically.
+     *   atomically: the object and the lock are each promoted once, and an
+     *   empty pointer is returned if either of them is gone.
      * \note
      *   Both this function and the constructor of `SafeSharedPtr` may be used to
      *   acquire temporary ownership of the managed object referred to by a
@@ -2608,9 +3076,15 @@ public:
      *   throws an exception when its SafeWeakPtr argument is empty, while
      *   `lock()` constructs an empty SafeSharedPtr<T>.
      */
-    SafeSharedPtr<T> lock() const noexcept
+    SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> lock() const noexcept
     {
-        return expired() ? SafeSharedPtr<T>() : SafeSharedPtr<T>(*this);
+        using Shared = SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>;
+        std::shared_ptr<SharedMutex> m = mutex.lock();
+        std::shared_ptr<T> p = ptr.lock();
+        if (!m || !p) {
+            return Shared();
+        }
+        return Shared(std::move(m), std::move(p));
     }
 
     /**
@@ -2677,8 +3151,10 @@ private:
  *   This class has no member values, so could be `static_cast` from
  *   `std::enable_shared_from_this` directly.\n
  *   See https://en.cppreference.com/w/cpp/memory/enable_shared_from_this for
- *   more details.
- * \sa SafeSharedPtr
+ *   more details.\n
+ *   The lock is allocated separately, EnableEmbeddedSafeSharedFromThis keeps
+ *   it inside the object instead.
+ * \sa SafeSharedPtr, EnableEmbeddedSafeSharedFromThis
  */
 template<typename T,
          typename mutex_t = shared_mutex_t,
@@ -2705,6 +3181,20 @@ public:
         : __safeSharedLock(std::make_shared<SharedMutex>())
     {}
 
+    /**
+     * \brief Constructs a new EnableSafeSharedFromThis object whose lock is
+     *        allocated with `alloc`, rebound as needed.
+     * \param alloc Allocator of the lock, typically the one given to
+     *              allocate_shared() and forwarded by the uses-allocator
+     *              constructor of `T`.
+     * \exception UserDefined Exceptions thrown from `Alloc::allocate()`.
+     * \sa SafeSharedPtr
+     */
+    template<typename Alloc>
+    EnableSafeSharedFromThis(std::allocator_arg_t, const Alloc& alloc)
+        : __safeSharedLock(std::allocate_shared<SharedMutex>(alloc))
+    {}
+
     /**
      * \brief Constructs a new EnableSafeSharedFromThis object. The private
      *        `std::weak_ptr<T>` member is value-initialized.
@@ -2862,6 +3352,117 @@ private:
     friend class SafeSharedPtr;
     std::shared_ptr<typename SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>::SharedMutex> __safeSharedLock;
 };
+
+/**
+ * \brief Same as EnableSafeSharedFromThis, but keeps the lock inside the
+ *        object instead of allocating it separately.
+ * \tparam T            Object type same as SafeSharedPtr.
+ * \tparam mutex_t      Type of the mutex used, default is shared_mutex_t.
+ * \tparam read_lock_t  Type of the read-lock used, default is shared_lock_t.
+ * \tparam write_lock_t Type of the write-lock used, default is unique_lock_t.
+ * \details
+ *   EnableSafeSharedFromThis allocates its lock on construction and keeps it
+ *   through a `std::shared_ptr`, so every object costs one more allocation and
+ *   every shared_from_this() copies that pointer.\n
+ *   Here the lock is a plain member, and `SafeSharedPtr` refers to it through
+ *   the aliasing constructor of `std::shared_ptr`, sharing the control block
+ *   of the object: no allocation for the lock, and shared_from_this() only
+ *   takes references on the control block of the object, a compare-and-swap
+ *   loop promoting its weak reference plus one atomic increment for the
+ *   lock's alias.\n
+ *   The resulting pointers are compact ones, see make_compact() and
+ *   CompactSafeWeakPtr.
+ * \note
+ *   Copying or assigning an object keeps its own lock, only
+ *   `std::enable_shared_from_this` is copied.
+ * \sa EnableSafeSharedFromThis, SafeSharedPtr
+ */
+template<typename T,
+         typename mutex_t = shared_mutex_t,
+         typename read_lock_t = shared_lock_t,
+         typename write_lock_t = unique_lock_t>
+class EnableEmbeddedSafeSharedFromThis : public std::enable_shared_from_this<T>
+{
+public:
+    /** \brief Type alias for template shared_mutex_t. */
+    using SharedMutex = mutex_t;
+
+    /** \brief Type alias for template read_lock_t. */
+    using SharedLock = read_lock_t;
+
+    /** \brief Type alias for template write_lock_t. */
+    using UniqueLock = write_lock_t;
+
+    /**
+     * \brief Constructs a new EnableEmbeddedSafeSharedFromThis object with its
+     *        own lock.
+     */
+    EnableEmbeddedSafeSharedFromThis() noexcept = default;
+
+    /**
+     * \brief Constructs a new EnableEmbeddedSafeSharedFromThis object with its
+     *        own lock, `other` is not shared.
+     * \param other Another EnableEmbeddedSafeSharedFromThis to copy.
+     */
+    EnableEmbeddedSafeSharedFromThis(const EnableEmbeddedSafeSharedFromThis& other) noexcept
+        : std::enable_shared_from_this<T>(other)
+    {}
+
+    /**
+     * \brief Does nothing; returns *this.
+     * \param other Another EnableEmbeddedSafeSharedFromThis to assign.
+     * \return `*this`.
+     */
+    EnableEmbeddedSafeSharedFromThis& operator=(const EnableEmbeddedSafeSharedFromThis& other) noexcept
+    {
+        static_cast<std::enable_shared_from_this<T>&>(*this)
+                = static_cast<const std::enable_shared_from_this<T>&>(other);
+        return *this;
+    }
+
+    /**
+     * \brief Returns a `SafeSharedPtr<T>` that shares ownership of `*this`
+     *        and its lock with all existing `SafeSharedPtr` that refer to
+     *        `*this`.
+     * \details
+     *   Costs two atomic operations on the control block of the object: the
+     *   compare-and-swap loop of `std::enable_shared_from_this`, then one
+     *   increment for the lock, as both members of SafeSharedPtr own a
+     *   reference.
+     * \exception std::bad_weak_ptr
+     *   **Since C++17**: If `*this` is not owned by a `SafeSharedPtr`, see
+     *   EnableSafeSharedFromThis::shared_from_this().
+     */
+    SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock> shared_from_this()
+    {
+        std::shared_ptr<T> p = std::enable_shared_from_this<T>::shared_from_this();
+        std::shared_ptr<SharedMutex> m(p, &__safeSharedMutex);
+        return SafeSharedPtr<T, SharedMutex, SharedLock, UniqueLock>(std::move(m), std::move(p));
+    }
+
+    /** \overload */
+    SafeSharedPtr<T const, SharedMutex, SharedLock, UniqueLock> shared_from_this() const
+    {
+        std::shared_ptr<T const> p = std::enable_shared_from_this<T>::shared_from_this();
+        std::shared_ptr<SharedMutex> m(p, &__safeSharedMutex);
+        return SafeSharedPtr<T const, SharedMutex, SharedLock, UniqueLock>(std::move(m), std::move(p));
+    }
+
+    /**
+     * \brief Returns a `SafeWeakPtr<T>` that tracks ownership of `*this`.
+     */
+    SafeWeakPtr<T, SharedMutex, SharedLock, UniqueLock> weak_from_this()
+    { return shared_from_this(); }
+
+    /** \overload */
+    SafeWeakPtr<T const, SharedMutex, SharedLock, UniqueLock> weak_from_this() const
+    { return shared_from_this(); }
+
+private:
+    template<typename Y, typename M, typename R, typename W>
+    friend class SafeSharedPtr;
+    mutable SharedMutex __safeSharedMutex;
+};
 } // namespace Memory
 /** @} end of namespace Memory*/
 
@@ -0,0 +1,309 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_SEQLOCK_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include "../Common.h"
+#include "LockHolder.hpp"
+#include "RWSpinLock.hpp"
+
+/**
+ * \file SeqLock.hpp
+ * \brief Sequence lock: optimistic readers which never write to shared
+ *        memory, validated by a version counter.
+ * \details
+ *   Every reader of RWSpinLock writes the lock word, so readers take the cache
+ *   line away from each other and from the writer. With Memory::SeqLock
+ *   readers only read:
+ *     - the writer makes the sequence odd, updates the data, and makes the
+ *       sequence even again;
+ *     - a reader notes the sequence, waiting while it is odd, copies the
+ *       data, then checks the sequence did not change, and retries otherwise.
+ *
+ *   The writer never waits for readers, and readers never slow it down, but
+ *   a reader may have to retry while writes keep coming. Writers are
+ *   serialized with each other by the lock.
+ *
+ *   A copy racing with a write is only valid if made with atomic accesses,
+ *   so Memory::SeqLocked stores its trivially copyable payload as relaxed
+ *   atomic words, ordered by acquire / release fences as described by H.-J.
+ *   Boehm in "Can Seqlocks Get Along With Programming Language Memory
+ *   Models?". On x86 all of them are plain moves, on ARM the fences are the
+ *   `dmb` barriers the algorithm requires.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   struct Quote { double bid, ask; uint64_t time; };
+ *   Memory::SeqLocked<Quote> quote;
+ *   // Feed thread
+ *   quote.store({bid, ask, now});
+ *   // Any number of readers, never blocking the feed
+ *   Quote q = quote.load();
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Sequence counter of a SeqLocked payload, see SeqLock.hpp for
+ *        details.
+ * \details
+ *   Readers using the raw interface must only read the protected data with
+ *   atomic operations, relaxed ones suffice:
+ *   ```cpp
+ *   uint64_t seq;
+ *   do {
+ *       seq = lock.read_begin();
+ *       x = a.load(std::memory_order_relaxed);
+ *   } while (lock.read_retry(seq));
+ *   ```
+ */
+class SeqLock
+{
+public:
+    /** \brief RAII guard of the writer side. */
+    using WriteHolder = UniqueHolder<SeqLock>;
+
+    constexpr SeqLock() noexcept
+        : seq(0)
+    {}
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /**
+     * \brief Starts a read, waiting for a write in progress to finish.
+     * \return The sequence to give to read_retry().
+     */
+    uint64_t read_begin() const noexcept
+    {
+        uint64_t value = seq.load(std::memory_order_acquire);
+        uint_fast32_t count = 0;
+        while (value & 1) {
+            backoff(count);
+            value = seq.load(std::memory_order_acquire);
+        }
+        return value;
+    }
+
+    /**
+     * \brief Ends a read started with `start`.
+     * \return Whether a write overlapped the read, whose result must then be
+     *         dropped.
+     */
+    bool read_retry(uint64_t start) const noexcept
+    {
+        // Orders the data loads before the sequence load.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq.load(std::memory_order_relaxed) != start;
+    }
+
+    /**
+     * \brief Calls `fn` until it ran without a concurrent write.
+     * \details `fn` may run several times, and must only read the data with
+     *          atomic operations.
+     */
+    template<typename Fn>
+    void read(Fn&& fn) const
+    {
+        uint64_t start;
+        do {
+            start = read_begin();
+            fn();
+        } while (read_retry(start));
+    }
+
+    /** \brief Starts a write, waiting for other writers. */
+    void lock() noexcept
+    {
+        uint64_t value = seq.load(std::memory_order_relaxed);
+        uint_fast32_t count = 0;
+        for (;;) {
+            if (!(value & 1)
+                && seq.compare_exchange_weak(value, value + 1, std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+                break;
+            }
+            if (value & 1) {
+                backoff(count);
+                value = seq.load(std::memory_order_relaxed);
+            }
+        }
+        // Orders the odd sequence before the data stores.
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /** \brief Starts a write if no other writer is in. */
+    bool try_lock() noexcept
+    {
+        uint64_t value = seq.load(std::memory_order_relaxed);
+        if ((value & 1)
+            || !seq.compare_exchange_strong(value, value + 1, std::memory_order_acquire,
+                                            std::memory_order_relaxed)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    /** \brief Ends a write, publishing the data. */
+    void unlock() noexcept
+    { seq.fetch_add(1, std::memory_order_release); }
+
+    /** \brief Current sequence, odd while a write is in progress. */
+    uint64_t sequence() const noexcept
+    { return seq.load(std::memory_order_acquire); }
+
+private:
+    static void backoff(uint_fast32_t& count) noexcept
+    {
+        cpu_relax();
+        if (++count > 1000) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<uint64_t> seq;
+};
+
+/**
+ * \brief Trivially copyable `T` read optimistically and written under a
+ *        SeqLock, see SeqLock.hpp for details.
+ * \tparam T Type of the payload, trivially copyable and default
+ *           constructible. Copies cost `sizeof(T)`, keep it to a few cache
+ *           lines.
+ */
+template<typename T>
+class SeqLocked
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLocked copies its payload bytewise");
+
+    using Word = std::uintptr_t;
+    enum : std::size_t { Words = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word) };
+
+public:
+    /** \brief Type of the payload. */
+    using value_type = T;
+    /** \brief RAII guard of the writer side. */
+    using WriteHolder = SeqLock::WriteHolder;
+
+    /** \brief Value-initialized payload. */
+    SeqLocked() noexcept
+        : SeqLocked(T())
+    {}
+
+    /** \brief Payload copied from `value`. */
+    explicit SeqLocked(const T& value) noexcept
+    { put(value); }
+
+    SeqLocked(const SeqLocked&) = delete;
+    SeqLocked& operator=(const SeqLocked&) = delete;
+
+    /**
+     * \brief Copies the payload, retrying while writes overlap the copy.
+     * \details Never writes to shared memory.
+     */
+    T load() const noexcept
+    {
+        Word buffer[Words];
+        uint64_t start;
+        do {
+            start = lock_.read_begin();
+            get(buffer);
+        } while (lock_.read_retry(start));
+        return from(buffer);
+    }
+
+    /**
+     * \brief Copies the payload into `value` if no write overlapped.
+     * \return Whether `value` was assigned, does not wait nor retry.
+     */
+    bool try_load(T& value) const noexcept
+    {
+        const uint64_t start = lock_.sequence();
+        if (start & 1) {
+            return false;
+        }
+        Word buffer[Words];
+        get(buffer);
+        if (lock_.read_retry(start)) {
+            return false;
+        }
+        value = from(buffer);
+        return true;
+    }
+
+    /** \brief Replaces the payload, waiting for other writers only. */
+    void store(const T& value) noexcept
+    {
+        WriteHolder writer(lock_);
+        put(value);
+    }
+
+    /**
+     * \brief Calls `fn` with a copy of the payload under the write lock, and
+     *        stores it back.
+     * \return The stored payload.
+     */
+    template<typename Fn>
+    T update(Fn&& fn)
+    {
+        WriteHolder writer(lock_);
+        Word buffer[Words];
+        get(buffer);
+        T value = from(buffer);
+        fn(value);
+        put(value);
+        return value;
+    }
+
+    /** \brief The SeqLock, e.g. to hold writers back with a WriteHolder. */
+    SeqLock& lock() noexcept
+    { return lock_; }
+
+    /** \brief Current sequence, counts twice the writes. */
+    uint64_t sequence() const noexcept
+    { return lock_.sequence(); }
+
+private:
+    void get(Word* buffer) const noexcept
+    {
+        for (std::size_t i = 0; i < Words; ++i) {
+            buffer[i] = words[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void put(const T& value) noexcept
+    {
+        Word buffer[Words] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+        for (std::size_t i = 0; i < Words; ++i) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+    }
+
+    static T from(const Word* buffer) noexcept
+    {
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    SeqLock lock_;
+    std::atomic<Word> words[Words];
+};
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_SEQLOCK_HPP
@@ -0,0 +1,124 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_STRIPEDLOCKPOLICY_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_STRIPEDLOCKPOLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file StripedLockPolicy.hpp
+ * \brief Lock policy of Memory::SafeSharedPtr mapping objects to a fixed table
+ *        of locks instead of allocating one lock per object.
+ * \details
+ *   Every object managed by Memory::SafeSharedPtr gets its own heap-allocated
+ *   lock by default: a `std::shared_mutex` with its control block costs about
+ *   a hundred bytes per object, which dominates for graphs of millions of
+ *   small objects.
+ *
+ *   Memory::StripedLockPolicy hashes the address of the object to one of `N`
+ *   locks of a static table, each on its own cache line. No memory is
+ *   allocated for the lock, the `std::shared_ptr` of the lock aliases the
+ *   control block of the object. Copies, weak pointers and conversions of the
+ *   SafeSharedPtr work as usual.
+ *
+ *   The policy is enabled per object type by specializing
+ *   Memory::SafeLockPolicy. Each `Tag` gets its own table, types sharing a
+ *   tag (by default `void`) share one global table:
+ *   ```cpp
+ *   UTILITIES_NAMESPACE_BEGIN
+ *   namespace Memory {
+ *   // 4096 locks private to Node
+ *   template<>
+ *   struct SafeLockPolicy<Node, shared_mutex_t>
+ *       : StripedLockPolicy<shared_mutex_t, 4096, Node>
+ *   {};
+ *   } // namespace Memory
+ *   UTILITIES_NAMESPACE_END
+ *
+ *   auto node = Memory::make_shared<Node>();   // no lock allocated
+ *   node->link(other);
+ *   ```
+ *
+ * \warning
+ *   Unrelated objects may share a lock, so a thread must not hold the lock of
+ *   one object while locking another of the same table, even for reading if
+ *   writers may be waiting: both may map to the same lock, which is **NOT**
+ *   recursive. Size `N` after the number of threads accessing objects
+ *   concurrently, not after the number of objects.
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief SafeLockPolicy sharing a static table of `N` locks between all
+ *        objects, see StripedLockPolicy.hpp for details.
+ * \tparam mutex_t Type of the locks, the `mutex_t` of SafeSharedPtr.
+ * \tparam N       Number of locks of the table.
+ * \tparam Tag     Identifies the table, each type gives a distinct table.
+ * \sa SafeLockPolicy
+ */
+template<typename mutex_t, std::size_t N = 1024, typename Tag = void>
+struct StripedLockPolicy
+{
+    static_assert(N > 0, "a lock table needs at least one lock");
+
+    /** \brief Number of locks of the table. */
+    static constexpr std::size_t stripes() noexcept
+    { return N; }
+
+    /**
+     * \brief Index of the lock guarding the object at `object`.
+     * \details Addresses are hashed with Fibonacci hashing, so that objects
+     *          allocated at regular strides spread over the whole table.
+     */
+    static std::size_t index_of(const void* object) noexcept
+    {
+        const std::uint64_t h = (static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(object)) >> 4)
+                                * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>(h >> 32) % N;
+    }
+
+    /** \brief Lock guarding the object at `object`. */
+    static mutex_t& lock_of(const void* object) noexcept
+    { return table()[index_of(object)].mutex; }
+
+    /**
+     * \brief Returns the lock of the object managed by `owner`, sharing its
+     *        ownership instead of allocating.
+     */
+    template<typename Y>
+    static std::shared_ptr<mutex_t> create(const std::shared_ptr<Y>& owner) noexcept
+    { return std::shared_ptr<mutex_t>(owner, &lock_of(owner.get())); }
+
+    /** \overload Nothing is allocated, `alloc` is not used. */
+    template<typename Y, typename Alloc>
+    static std::shared_ptr<mutex_t> create(const std::shared_ptr<Y>& owner, const Alloc&) noexcept
+    { return create(owner); }
+
+private:
+    /** One lock per cache line, so neighbouring locks do not share lines. */
+    struct alignas(cache_line_size) Slot
+    {
+        mutex_t mutex;
+    };
+
+    static Slot* table() noexcept
+    {
+        static Slot slots[N];
+        return slots;
+    }
+};
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_STRIPEDLOCKPOLICY_HPP
@@ -0,0 +1,336 @@
+#ifndef CPP_UTILITIES_MEMORYSAFETY_STRIPEDSAFEARRAY_HPP
+#define CPP_UTILITIES_MEMORYSAFETY_STRIPEDSAFEARRAY_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "../Common.h"
+#include "CacheLinePadded.hpp"
+#include "LockHolder.hpp"
+#include "SafeSharedPtr.hpp"
+
+/**
+ * \file StripedSafeArray.hpp
+ * \brief Shared array guarded by several lock stripes instead of one lock.
+ * \details
+ *   `SafeSharedPtr<T[]>::operator[]` locks the single lock of the whole array,
+ *   so writers to disjoint indices are serialized.\n
+ *   Memory::StripedSafeArray splits the array over `S` locks: element `i` is
+ *   guarded by stripe `i % S`, so concurrent accesses to elements of
+ *   different stripes proceed in parallel. Interleaving keeps neighbouring
+ *   elements on different stripes, which spreads threads working on nearby
+ *   offsets too.
+ *
+ *   Accesses of one element lock one stripe, lock_range() locks only the
+ *   stripes covering `[first, last)`, all of them once the range spans `S`
+ *   elements or more. Stripes are always locked in increasing order, so
+ *   ranges never deadlock each other.
+ *
+ *   **Sample Code**
+ *   ```cpp
+ *   Memory::StripedSafeArray<double> buffer(1 << 20, 64);
+ *   buffer[offset] = 1.0;                      // write-locks one stripe
+ *   {
+ *       auto range = buffer.lock_range(offset, offset + 16);
+ *       std::fill(range.begin(), range.end(), 0.0);
+ *   }
+ *   const auto& view = buffer;
+ *   double sum = view.lock_range(0, 8).begin()[3];  // read-locked
+ *   ```
+ */
+
+UTILITIES_NAMESPACE_BEGIN
+
+/**
+ * \addtogroup MemorySafety
+ * @{
+ */
+namespace Memory {
+/**
+ * \brief Shared array whose elements are guarded by interleaved lock stripes,
+ *        see StripedSafeArray.hpp for details.
+ * \tparam T        Type of the elements.
+ * \tparam mutex_t  Type of the stripe locks, default is shared_mutex_t.
+ * \details
+ *   Copies share the elements and the locks, like SafeSharedPtr.\n
+ *   Non-const accessors take write locks, const accessors take read locks.
+ * \sa SafeSharedPtr
+ */
+template<typename T, typename mutex_t = shared_mutex_t>
+class StripedSafeArray
+{
+    /**
+     * One lock per cache line, so stripes do not share lines. Over-aligned
+     * `new` needs C++17, older standards only pad to the line size.
+     */
+#if __cplusplus >= 201703L
+    struct alignas(cache_line_size) Stripe
+    {
+        mutex_t mutex;
+    };
+#else
+    struct Stripe
+    {
+        mutex_t mutex;
+        char padding[cache_line_size - sizeof(mutex_t) % cache_line_size];
+    };
+#endif
+
+public:
+    /** \brief Type alias for template mutex_t. */
+    using SharedMutex = mutex_t;
+
+    /** \brief Default number of stripes. */
+    static constexpr std::size_t DefaultStripes = 16;
+
+    /**
+     * \brief Proxy of one element holding the lock of its stripe, behaves like
+     *        `T&`.
+     * \tparam Lock SharedHolder or UniqueHolder of the stripe.
+     */
+    template<typename Lock>
+    class ElementHelper
+    {
+    public:
+        /** \brief Reference type of element. */
+        using reference = T&;
+        /** \brief Const reference type of element. */
+        using const_reference = const T&;
+
+        ElementHelper(ElementHelper&& other) noexcept
+            : ptr(other.ptr),
+              lock(std::move(other.lock))
+        {}
+
+        /** \brief Operator overload to act as `T&`. */
+        operator reference()
+        { return *ptr; }
+
+        /** \brief Operator overload to act as `const T&`. */
+        operator const_reference() const
+        { return *ptr; }
+
+        /** \brief Assigns `other` to the element. */
+        template<typename X>
+        ElementHelper& operator=(const X& other)
+        {
+            *ptr = other;
+            return *this;
+        }
+
+    private:
+        friend class StripedSafeArray;
+
+        ElementHelper(T* p, SharedMutex& m)
+            : ptr(p),
+              lock(m)
+        {}
+
+        ElementHelper(const ElementHelper&) = delete;
+        ElementHelper& operator=(const ElementHelper&) = delete;
+
+        T* ptr;
+        Lock lock;
+    };
+
+    /**
+     * \brief Proxy of a range of elements holding the locks of the stripes
+     *        covering it.
+     * \tparam Shared `true` for read locks, `false` for write locks.
+     */
+    template<bool Shared>
+    class RangeHelper
+    {
+    public:
+        /** \brief Pointer type of elements. */
+        using pointer = typename std::conditional<Shared, const T*, T*>::type;
+
+        RangeHelper(RangeHelper&& other) noexcept
+            : stripes(other.stripes),
+              total(other.total),
+              first(other.first),
+              last(other.last),
+              lockFirst(other.lockFirst),
+              lockCount(other.lockCount)
+        { other.stripes = nullptr; }
+
+        /** \brief Releases the stripes. */
+        ~RangeHelper()
+        {
+            if (!stripes) {
+                return;
+            }
+            for (std::size_t i = 0; i < lockCount; ++i) {
+                SharedMutex& m = stripes[(lockFirst + i) % total].mutex;
+                if (Shared) {
+                    m.unlock_shared();
+                } else {
+                    m.unlock();
+                }
+            }
+        }
+
+        /** \brief First element of the range. */
+        pointer begin() const noexcept
+        { return first; }
+
+        /** \brief Past-the-end element of the range. */
+        pointer end() const noexcept
+        { return last; }
+
+        /** \brief Number of elements of the range. */
+        std::size_t size() const noexcept
+        { return static_cast<std::size_t>(last - first); }
+
+        /** \brief Element `idx` of the range, i.e. `begin()[idx]`. */
+        auto operator[](std::size_t idx) const noexcept -> decltype(*pointer())
+        { return first[idx]; }
+
+    private:
+        friend class StripedSafeArray;
+
+        RangeHelper(Stripe* s, std::size_t n, pointer f, pointer l, std::size_t lf, std::size_t lc)
+            : stripes(s),
+              total(n),
+              first(f),
+              last(l),
+              lockFirst(lf),
+              lockCount(lc)
+        {
+            // Increasing stripe index, whatever the rotation of the range.
+            for (std::size_t i = 0; i < total; ++i) {
+                if (covers(i)) {
+                    if (Shared) {
+                        stripes[i].mutex.lock_shared();
+                    } else {
+                        stripes[i].mutex.lock();
+                    }
+                }
+            }
+        }
+
+        bool covers(std::size_t stripe) const noexcept
+        { return (stripe + total - lockFirst) % total < lockCount; }
+
+        RangeHelper(const RangeHelper&) = delete;
+        RangeHelper& operator=(const RangeHelper&) = delete;
+
+        Stripe* stripes;
+        std::size_t total;
+        pointer first;
+        pointer last;
+        std::size_t lockFirst;
+        std::size_t lockCount;
+    };
+
+    /**
+     * \brief Constructs an empty array, with one stripe.
+     */
+    StripedSafeArray() noexcept = default;
+
+    /**
+     * \brief Allocates `size` value-initialized elements guarded by
+     *        `stripes` locks.
+     * \param size    Number of elements.
+     * \param stripes Number of lock stripes, 0 is taken as 1.
+     * \exception std::bad_alloc If the memory could not be obtained.
+     */
+    explicit StripedSafeArray(std::size_t size, std::size_t stripes = DefaultStripes)
+        : StripedSafeArray(new T[size](), size, stripes)
+    {}
+
+    /**
+     * \brief Takes ownership of an array allocated by `new T[size]`.
+     * \param p       The array, released with `delete[]`.
+     * \param size    Number of elements of `p`.
+     * \param stripes Number of lock stripes, 0 is taken as 1.
+     * \exception std::bad_alloc
+     *   If the locks could not be allocated, `delete[] p` is called then.
+     */
+    StripedSafeArray(T* p, std::size_t size, std::size_t stripes = DefaultStripes)
+        : data(p, std::default_delete<T[]>()),
+          length(size),
+          stripeCount(stripes > 0 ? stripes : 1)
+    {
+        locks.reset(new Stripe[stripeCount], std::default_delete<Stripe[]>());
+    }
+
+    /** \brief Number of elements. */
+    std::size_t size() const noexcept
+    { return length; }
+
+    /** \brief Number of lock stripes. */
+    std::size_t stripes() const noexcept
+    { return stripeCount; }
+
+    /** \brief Stripe guarding element `idx`. */
+    std::size_t stripe_of(std::size_t idx) const noexcept
+    { return idx % stripeCount; }
+
+    /**
+     * \brief Returns the stored array without locking.
+     */
+    T* get() const noexcept
+    { return data.get(); }
+
+    /**
+     * \brief Accesses element `idx` with the **write lock** of its stripe.
+     * \warning `idx` must be less than size().
+     */
+    ElementHelper<UniqueHolder<SharedMutex>> operator[](std::size_t idx)
+    {
+        assert(idx < length);
+        return ElementHelper<UniqueHolder<SharedMutex>>(data.get() + idx, locks.get()[stripe_of(idx)].mutex);
+    }
+
+    /**
+     * \brief Accesses element `idx` with the **read lock** of its stripe.
+     * \warning `idx` must be less than size().
+     */
+    const ElementHelper<SharedHolder<SharedMutex>> operator[](std::size_t idx) const
+    {
+        assert(idx < length);
+        return ElementHelper<SharedHolder<SharedMutex>>(data.get() + idx, locks.get()[stripe_of(idx)].mutex);
+    }
+
+    /**
+     * \brief Write-locks the stripes covering `[first, last)`.
+     * \return A proxy giving access to the range while alive.
+     * \warning `first <= last <= size()`.
+     */
+    RangeHelper<false> lock_range(std::size_t first, std::size_t last)
+    { return range<false>(data.get(), first, last); }
+
+    /**
+     * \brief Read-locks the stripes covering `[first, last)`.
+     * \return A proxy giving read access to the range while alive.
+     * \warning `first <= last <= size()`.
+     */
+    RangeHelper<true> lock_range(std::size_t first, std::size_t last) const
+    { return range<true>(data.get(), first, last); }
+
+private:
+    template<bool Shared, typename P>
+    RangeHelper<Shared> range(P p, std::size_t first, std::size_t last) const
+    {
+        assert(first <= last && last <= length);
+        const std::size_t count = last - first < stripeCount ? last - first : stripeCount;
+        return RangeHelper<Shared>(locks.get(), stripeCount, p + first, p + last, stripe_of(first), count);
+    }
+
+    std::shared_ptr<T> data;
+    std::shared_ptr<Stripe> locks;
+    std::size_t length = 0;
+    std::size_t stripeCount = 1;
+};
+
+template<typename T, typename mutex_t>
+constexpr std::size_t StripedSafeArray<T, mutex_t>::DefaultStripes;
+} // namespace Memory
+/** @} */
+
+UTILITIES_NAMESPACE_END
+
+#endif  // CPP_UTILITIES_MEMORYSAFETY_STRIPEDSAFEARRAY_HPP
@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include <Utilities/MemorySafety/AsyncSharedMutex.hpp>
+
+#if __cplusplus >= 202002L
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::AsyncSharedMutex;
+using Memory::AsyncSafeSharedPtr;
+
+namespace {
+/** Eager fire-and-forget coroutine, enough to drive the awaitables. */
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+Task writer(AsyncSharedMutex& mutex, std::string& log, const char* name)
+{
+    auto holder = co_await mutex.scoped_lock_async();
+    log += name;
+}
+
+Task reader(AsyncSharedMutex& mutex, std::string& log, const char* name, int& concurrent)
+{
+    co_await mutex.lock_shared_async();
+    log += name;
+    ++concurrent;
+    // Readers granted together are all resumed before the lock is released.
+    mutex.unlock_shared();
+}
+
+Task count(AsyncSharedMutex& mutex, int& value)
+{
+    auto holder = co_await mutex.scoped_lock_async();
+    ++value;
+}
+
+Task relock(AsyncSharedMutex& mutex, int& value)
+{
+    co_await mutex.lock_async();
+    mutex.unlock();
+    // Granted to the next coroutine before, which must not wait for this one.
+    mutex.lock();
+    ++value;
+    mutex.unlock();
+}
+
+Task increment(AsyncSafeSharedPtr<int> ptr, int times, std::atomic<int>& done)
+{
+    for (int i = 0; i < times; ++i) {
+        auto&& value = co_await ptr.async_write();
+        ++*value;
+    }
+    const auto& value = co_await ptr.async_read();
+    EXPECT_GE(*value, times);
+    ++done;
+}
+} // namespace
+
+TEST(AsyncSharedMutex, uncontended)
+{
+    AsyncSharedMutex mutex;
+    std::string log;
+    int concurrent = 0;
+    writer(mutex, log, "W");
+    reader(mutex, log, "R", concurrent);
+    EXPECT_EQ(log, "WR");
+    EXPECT_TRUE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock_shared());
+    mutex.unlock();
+}
+
+TEST(AsyncSharedMutex, fifo)
+{
+    AsyncSharedMutex mutex;
+    std::string log;
+    int concurrent = 0;
+    mutex.lock();
+    writer(mutex, log, "W1");
+    reader(mutex, log, "R1", concurrent);
+    reader(mutex, log, "R2", concurrent);
+    writer(mutex, log, "W2");
+    EXPECT_TRUE(log.empty());
+    EXPECT_FALSE(mutex.try_lock_shared());
+
+    mutex.unlock();
+    EXPECT_EQ(log, "W1R1R2W2");
+    EXPECT_EQ(concurrent, 2);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(AsyncSharedMutex, readersBlockWriter)
+{
+    AsyncSharedMutex mutex;
+    std::string log;
+    mutex.lock_shared();
+    mutex.lock_shared();
+    writer(mutex, log, "W");
+    // A queued writer holds back new readers.
+    EXPECT_FALSE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+    EXPECT_TRUE(log.empty());
+    mutex.unlock_shared();
+    EXPECT_EQ(log, "W");
+}
+
+TEST(AsyncSharedMutex, longChain)
+{
+    enum { Waiters = 200000 };
+    AsyncSharedMutex mutex;
+    int value = 0;
+    mutex.lock();
+    for (int i = 0; i < Waiters; ++i) {
+        count(mutex, value);
+    }
+    // Each waiter releases to the next one without nesting its frame.
+    mutex.unlock();
+    EXPECT_EQ(value, Waiters);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(AsyncSharedMutex, unlockThenLock)
+{
+    enum { Waiters = 64 };
+    AsyncSharedMutex mutex;
+    int value = 0;
+    mutex.lock();
+    for (int i = 0; i < Waiters; ++i) {
+        relock(mutex, value);
+    }
+    mutex.unlock();
+    EXPECT_EQ(value, Waiters);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(AsyncSharedMutex, safeSharedPtr)
+{
+    AsyncSafeSharedPtr<int> ptr(new int(0));
+    std::atomic<int> done(0);
+    {
+        auto writeLock = ptr.unique_lock();
+        increment(ptr, 10, done);
+        EXPECT_EQ(*ptr.get(), 0);
+        EXPECT_EQ(done, 0);
+    }
+    EXPECT_EQ(done, 1);
+    EXPECT_EQ(*ptr, 10);
+}
+
+TEST(AsyncSharedMutex, mixedThreads)
+{
+    enum { Threads = 4, Times = 2000 };
+    AsyncSafeSharedPtr<int> ptr(new int(0));
+    std::atomic<int> done(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i, &done]() mutable {
+            if (i % 2) {
+                increment(ptr, Times, done);
+            } else {
+                for (int j = 0; j < Times; ++j) {
+                    *ptr += 1;
+                }
+                ++done;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Coroutines may finish on whichever thread released the lock last.
+    while (done != Threads) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(*ptr, Threads * Times);
+}
+
+#endif  // __cplusplus >= 202002L
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#define private public
+#include <Utilities/MemorySafety/AtomicSafeSharedPtr.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::SafeSharedPtr;
+using Memory::AtomicSafeSharedPtr;
+
+struct Config
+{
+    Config(int v) : version(v), check(v * 7) {}
+    int version;
+    int check;
+};
+
+TEST(AtomicSafeSharedPtr, loadStore)
+{
+    AtomicSafeSharedPtr<int> empty;
+    EXPECT_FALSE(empty.load());
+    EXPECT_TRUE(empty.is_lock_free());
+
+    SafeSharedPtr<int> ptr(new int(3));
+    AtomicSafeSharedPtr<int> atomic(ptr);
+    SafeSharedPtr<int> loaded = atomic.load();
+    EXPECT_EQ(loaded.ptr, ptr.ptr);
+    EXPECT_EQ(loaded.mutex, ptr.mutex);
+    EXPECT_EQ(ptr.use_count(), 3);
+
+    atomic.store(SafeSharedPtr<int>(new int(4)));
+    EXPECT_EQ(*atomic.load(), 4);
+    EXPECT_EQ(ptr.use_count(), 2);
+
+    atomic = nullptr;
+    EXPECT_FALSE(static_cast<SafeSharedPtr<int>>(atomic));
+}
+
+TEST(AtomicSafeSharedPtr, exchange)
+{
+    SafeSharedPtr<int> first(new int(1));
+    AtomicSafeSharedPtr<int> atomic(first);
+
+    SafeSharedPtr<int> second(new int(2));
+    SafeSharedPtr<int> old = atomic.exchange(second);
+    EXPECT_EQ(old.ptr, first.ptr);
+    EXPECT_EQ(old.mutex, first.mutex);
+    EXPECT_EQ(first.use_count(), 2);
+    EXPECT_EQ(atomic.load().mutex, second.mutex);
+}
+
+TEST(AtomicSafeSharedPtr, compare_exchange)
+{
+    SafeSharedPtr<int> first(new int(1));
+    SafeSharedPtr<int> second(new int(2));
+    AtomicSafeSharedPtr<int> atomic(first);
+
+    SafeSharedPtr<int> expected = second;
+    EXPECT_FALSE(atomic.compare_exchange_strong(expected, SafeSharedPtr<int>(new int(3))));
+    EXPECT_EQ(expected.ptr, first.ptr);
+    EXPECT_EQ(expected.mutex, first.mutex);
+
+    EXPECT_TRUE(atomic.compare_exchange_strong(expected, second));
+    EXPECT_EQ(atomic.load().ptr, second.ptr);
+
+    // same object but another lock is not equivalent
+    SafeSharedPtr<int> relocked(second.ptr);
+    EXPECT_FALSE(atomic.compare_exchange_weak(relocked, first));
+    EXPECT_EQ(relocked.mutex, second.mutex);
+
+    AtomicSafeSharedPtr<int> empty;
+    SafeSharedPtr<int> none;
+    EXPECT_TRUE(empty.compare_exchange_strong(none, first));
+    EXPECT_EQ(empty.load().ptr, first.ptr);
+}
+
+TEST(AtomicSafeSharedPtr, concurrentReadersAndWriters)
+{
+    AtomicSafeSharedPtr<Config> current(SafeSharedPtr<Config>(new Config(0)));
+    std::atomic<bool> stop(false);
+    std::atomic<int> torn(0);
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&current, &stop, &torn] {
+            while (!stop.load()) {
+                SafeSharedPtr<Config> config = current.load();
+                if (config->check != config.get()->version * 7) {
+                    ++torn;
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 2; ++i) {
+        writers.emplace_back([&current, i] {
+            for (int v = 1; v <= 20 * 1000; ++v) {
+                current.store(SafeSharedPtr<Config>(new Config(v * 2 + i)));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(torn.load(), 0);
+    EXPECT_EQ(current.load().use_count(), 2);
+}
+
+TEST(AtomicSafeSharedPtr, concurrentCompareExchange)
+{
+    AtomicSafeSharedPtr<int> counter(SafeSharedPtr<int>(new int(0)));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&counter] {
+            for (int n = 0; n < 10 * 1000; ++n) {
+                SafeSharedPtr<int> expected = counter.load();
+                while (!counter.compare_exchange_weak(
+                           expected, SafeSharedPtr<int>(new int(*expected.get() + 1)))) {
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(*counter.load(), 4 * 10 * 1000);
+}
+
+TEST(AtomicSafeSharedPtr, storeEmptyWhileLoading)
+{
+    AtomicSafeSharedPtr<int> holder;
+    SafeSharedPtr<int> value(new int(1));
+    // A reader overtaken while the word goes full and empty again.
+    const auto taken = holder.acquire();
+    holder.store(value);
+    holder.store(SafeSharedPtr<int>());
+    holder.release(holder.node(taken));
+    EXPECT_EQ(holder.word.load(), 0u);
+
+    std::atomic<bool> stop(false);
+    std::thread reader([&]() {
+        while (!stop) {
+            SafeSharedPtr<int> current = holder.load();
+            if (current) {
+                EXPECT_EQ(*current.get(), 1);
+            }
+        }
+    });
+    for (int i = 0; i < 100000; ++i) {
+        holder.store(value);
+        holder.store(SafeSharedPtr<int>());
+    }
+    stop = true;
+    reader.join();
+    EXPECT_EQ(holder.word.load(), 0u);
+    EXPECT_FALSE(holder.load());
+    holder.store(value);
+    EXPECT_EQ(value.use_count(), 2);
+}
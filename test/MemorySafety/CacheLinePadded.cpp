@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/CacheLinePadded.hpp>
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::CacheLinePadded;
+using Memory::RWSpinLock;
+
+TEST(CacheLinePadded, layout)
+{
+    static_assert(sizeof(CacheLinePadded<RWSpinLock>) == Memory::cache_line_size, "one line per lock");
+    static_assert(alignof(CacheLinePadded<RWSpinLock>) == Memory::cache_line_size, "lines start at locks");
+    CacheLinePadded<RWSpinLock> locks[4];
+    for (auto& lock : locks) {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&lock) % Memory::cache_line_size, 0u);
+    }
+    EXPECT_EQ(reinterpret_cast<const char*>(&locks[1]) - reinterpret_cast<const char*>(&locks[0]),
+              static_cast<std::ptrdiff_t>(Memory::cache_line_size));
+}
+
+TEST(CacheLinePadded, lock)
+{
+    enum { Threads = 8, Times = 2000 };
+    CacheLinePadded<RWSpinLock> locks[Threads];
+    long values[Threads] = {};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < Times; ++j) {
+                const int k = (i + j) % Threads;
+                RWSpinLock::WriteHolder writer(locks[k]);
+                ++values[k];
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < Threads; ++i) {
+        EXPECT_EQ(values[i], Times);
+        EXPECT_EQ(locks[i].get().bits(), 0);
+    }
+}
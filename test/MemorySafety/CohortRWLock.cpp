@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#define private public
+#include <Utilities/MemorySafety/CohortRWLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::CohortRWLock;
+using Memory::CohortSafeSharedPtr;
+using Memory::CohortTopology;
+
+TEST(CohortRWLock, parseCpulist)
+{
+    std::vector<std::size_t> values;
+    EXPECT_TRUE(CohortTopology::parse_cpulist("0-3,8,10-11", values));
+    EXPECT_EQ(values, (std::vector<std::size_t>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_FALSE(CohortTopology::parse_cpulist("", values));
+    EXPECT_FALSE(CohortTopology::parse_cpulist("3-1", values));
+    EXPECT_FALSE(CohortTopology::parse_cpulist("x", values));
+    EXPECT_FALSE(CohortTopology::parse_cpulist("1,2+3", values));
+    EXPECT_EQ(values.size(), std::size_t(7));
+}
+
+TEST(CohortRWLock, topology)
+{
+    CohortTopology single;
+    EXPECT_EQ(single.groups(), std::size_t(1));
+    EXPECT_EQ(single.current_group(), std::size_t(0));
+
+    CohortTopology explicitMap(std::vector<std::size_t>{0, 0, 1, 1, 2});
+    EXPECT_EQ(explicitMap.groups(), std::size_t(3));
+    EXPECT_EQ(explicitMap.group_of(1), std::size_t(0));
+    EXPECT_EQ(explicitMap.group_of(3), std::size_t(1));
+    EXPECT_EQ(explicitMap.group_of(4), std::size_t(2));
+    EXPECT_EQ(explicitMap.group_of(100), std::size_t(0));
+    EXPECT_LT(explicitMap.current_group(), std::size_t(3));
+
+    EXPECT_EQ(CohortTopology::from_sysfs("/nonexistent").groups(), std::size_t(1));
+    EXPECT_GE(CohortTopology::system().groups(), std::size_t(1));
+}
+
+#if defined(__linux__)
+TEST(CohortRWLock, fromSysfs)
+{
+    char root[] = "/tmp/cohortXXXXXX";
+    ASSERT_NE(mkdtemp(root), nullptr);
+    const std::string dir(root);
+    const auto write = [](const std::string& path, const char* text) {
+        std::ofstream(path) << text << '\n';
+    };
+    write(dir + "/online", "0,2");
+    mkdir((dir + "/node0").c_str(), 0700);
+    mkdir((dir + "/node2").c_str(), 0700);
+    write(dir + "/node0/cpulist", "0-1,4-5");
+    write(dir + "/node2/cpulist", "2-3,6-7");
+
+    const CohortTopology topology = CohortTopology::from_sysfs(dir);
+    EXPECT_EQ(topology.groups(), std::size_t(2));
+    for (std::size_t cpu : {0, 1, 4, 5}) {
+        EXPECT_EQ(topology.group_of(cpu), std::size_t(0));
+    }
+    for (std::size_t cpu : {2, 3, 6, 7}) {
+        EXPECT_EQ(topology.group_of(cpu), std::size_t(1));
+    }
+
+    // Memory-only nodes have no CPUs, and no group.
+    write(dir + "/online", "0-2");
+    mkdir((dir + "/node1").c_str(), 0700);
+    write(dir + "/node1/cpulist", "");
+    const CohortTopology withMemoryNode = CohortTopology::from_sysfs(dir);
+    EXPECT_EQ(withMemoryNode.groups(), std::size_t(2));
+    EXPECT_EQ(withMemoryNode.group_of(1), std::size_t(0));
+    EXPECT_EQ(withMemoryNode.group_of(2), std::size_t(1));
+
+    std::remove((dir + "/node2/cpulist").c_str());
+    EXPECT_EQ(CohortTopology::from_sysfs(dir).groups(), std::size_t(1));
+    write(dir + "/node2/cpulist", "");
+    EXPECT_EQ(CohortTopology::from_sysfs(dir).groups(), std::size_t(1));
+    std::remove((dir + "/node2/cpulist").c_str());
+    std::remove((dir + "/node1/cpulist").c_str());
+    rmdir((dir + "/node1").c_str());
+
+    std::remove((dir + "/node0/cpulist").c_str());
+    std::remove((dir + "/online").c_str());
+    rmdir((dir + "/node0").c_str());
+    rmdir((dir + "/node2").c_str());
+    rmdir(root);
+}
+#endif
+
+TEST(CohortRWLock, modes)
+{
+    CohortRWLock<> lock;
+    // Shared, not copied.
+    EXPECT_EQ(&lock.cohorts(), &CohortTopology::system());
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    // A failed writer leaves the way open to readers.
+    EXPECT_FALSE(lock.global);
+    lock.unlock_shared();
+    lock.unlock_shared();
+
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_EQ(lock.readers(), 0);
+    lock.unlock();
+    EXPECT_FALSE(lock.global);
+
+    {
+        CohortRWLock<>::WriteHolder writer(lock);
+    }
+    {
+        CohortRWLock<>::ReadHolder reader(lock);
+    }
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TEST(CohortRWLock, handoverWithinGroup)
+{
+    const CohortTopology topology(std::vector<std::size_t>{0, 1});
+    CohortRWLock<> lock(topology);
+    lock.acquire(1);
+    std::atomic<bool> inherited(false);
+    std::thread successor([&lock, &inherited]() {
+        lock.acquire(1);
+        inherited = lock.groups[1].inherited;
+        lock.unlock();
+    });
+    while (lock.groups[1].waiting.load() == 0) {
+        std::this_thread::yield();
+    }
+    lock.unlock();
+    successor.join();
+    // Passed along without releasing the global lock, which the successor
+    // released since nobody else waited.
+    EXPECT_TRUE(inherited);
+    EXPECT_FALSE(lock.global);
+    EXPECT_FALSE(lock.groups[1].inherited);
+
+    // Other groups still contend for the global lock.
+    EXPECT_TRUE(lock.try_acquire(0));
+    EXPECT_FALSE(lock.try_acquire(1));
+    lock.unlock();
+}
+
+TEST(CohortRWLock, handoverBound)
+{
+    const CohortTopology topology(std::vector<std::size_t>{0, 1});
+    CohortRWLock<8, 2> lock(topology);
+    std::vector<bool> kept;
+    for (int i = 0; i < 4; ++i) {
+        lock.acquire(0);
+        // A writer of the group waits at every release.
+        lock.groups[0].waiting.fetch_add(1);
+        lock.unlock();
+        lock.groups[0].waiting.fetch_sub(1);
+        kept.push_back(lock.global.load());
+    }
+    EXPECT_EQ(kept, (std::vector<bool>{true, true, false, true}));
+    lock.acquire(0);
+    lock.unlock();
+    EXPECT_FALSE(lock.global);
+}
+
+TEST(CohortRWLock, concurrent)
+{
+    enum { Threads = 8, Times = 3000 };
+    const CohortTopology topology(std::vector<std::size_t>{0, 1, 2, 3});
+    CohortRWLock<4, 4> lock(topology);
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&lock, &value, i]() {
+            for (int j = 0; j < Times; ++j) {
+                if ((i + j) % 2 == 0) {
+                    // Threads act as members of two groups.
+                    lock.acquire(std::size_t(i % 2));
+                    ++value;
+                    lock.unlock();
+                } else {
+                    CohortRWLock<4, 4>::ReadHolder reader(lock);
+                    EXPECT_GE(value, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(value, Threads * Times / 2);
+    EXPECT_FALSE(lock.global);
+    EXPECT_EQ(lock.readers(), 0);
+}
+
+TEST(CohortRWLock, safeSharedPtr)
+{
+    enum { Threads = 8, Times = 5000 };
+    CohortSafeSharedPtr<long> ptr(new long(0));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i]() mutable {
+            for (int j = 0; j < Times; ++j) {
+                if (j % 8 == i % 8) {
+                    *ptr += 1;
+                } else {
+                    const auto& reader = ptr;
+                    EXPECT_GE(*reader, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(*ptr, Threads * Times / 8);
+}
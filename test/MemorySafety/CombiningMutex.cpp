@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/CombiningMutex.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::CombiningMutex;
+using Memory::CombiningSafeSharedPtr;
+
+TEST(CombiningMutex, results)
+{
+    CombiningMutex<> mutex;
+    int value = 1;
+    EXPECT_EQ(mutex.combine([&value]() { return value + 1; }), 2);
+    mutex.combine([&value]() { value = 3; });
+    EXPECT_EQ(value, 3);
+    int& ref = mutex.combine([&value]() -> int& { return value; });
+    EXPECT_EQ(&ref, &value);
+    EXPECT_EQ(mutex.combine([]() { return std::string(100, 'x'); }), std::string(100, 'x'));
+
+    // The lock is free again, and usual accesses still work.
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_TRUE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+    for (auto& slot : mutex.slots) {
+        EXPECT_EQ(slot.request.load(), nullptr);
+    }
+}
+
+TEST(CombiningMutex, exception)
+{
+    CombiningMutex<> mutex;
+    EXPECT_THROW(mutex.combine([]() -> int { throw std::runtime_error("failed"); }), std::runtime_error);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    EXPECT_EQ(mutex.combine([]() { return 5; }), 5);
+}
+
+TEST(CombiningMutex, batched)
+{
+    // Operations published while the lock is held all run in the thread
+    // which gets it next.
+    enum { Threads = 3 };
+    CombiningMutex<> mutex;
+    std::vector<std::thread::id> runners;
+    mutex.lock();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&mutex, &runners]() {
+            mutex.combine([&runners]() { runners.push_back(std::this_thread::get_id()); });
+        });
+    }
+    std::size_t published = 0;
+    while (published != Threads) {
+        published = 0;
+        for (auto& slot : mutex.slots) {
+            published += slot.request.load() != nullptr;
+        }
+        std::this_thread::yield();
+    }
+    mutex.unlock();
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(runners.size(), std::size_t(Threads));
+    EXPECT_EQ(runners[0], runners[1]);
+    EXPECT_EQ(runners[1], runners[2]);
+}
+
+template<typename Mutex>
+void pushConcurrently()
+{
+    enum { Threads = 8, Times = 5000 };
+    Mutex mutex;
+    std::vector<long> values;
+    long total = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < Times; ++j) {
+                const std::size_t size = mutex.combine([&values, &total, j]() {
+                    values.push_back(j);
+                    total += j;
+                    return values.size();
+                });
+                EXPECT_GE(size, std::size_t(1));
+                if (j % 16 == i) {
+                    Memory::SharedHolder<Mutex> reader(mutex);
+                    EXPECT_GE(total, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(values.size(), std::size_t(Threads * Times));
+    EXPECT_EQ(total, long(Threads) * Times * (Times - 1) / 2);
+}
+
+TEST(CombiningMutex, concurrent)
+{
+    pushConcurrently<CombiningMutex<>>();
+    // Threads share the two slots, and lock directly while theirs is in use.
+    pushConcurrently<CombiningMutex<Memory::RWSpinLock, 2>>();
+}
+
+TEST(CombiningMutex, safeSharedPtr)
+{
+    enum { Threads = 8, Times = 2000 };
+    CombiningSafeSharedPtr<std::vector<int>> ptr(new std::vector<int>);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i]() mutable {
+            for (int j = 0; j < Times; ++j) {
+                ptr.combine([i](std::vector<int>& v) { v.push_back(i); });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(ptr->size(), std::size_t(Threads * Times));
+    const std::size_t size = ptr.combine([](const std::vector<int>& v) { return v.size(); });
+    EXPECT_EQ(size, std::size_t(Threads * Times));
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/CompactSafeWeakPtr.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::CompactSafeWeakPtr;
+using Memory::SafeSharedPtr;
+using Memory::SafeWeakPtr;
+
+namespace {
+struct Observer
+{
+    explicit Observer(int v) : value(v) { ++alive; }
+    ~Observer() { --alive; }
+    int value;
+    static int alive;
+};
+int Observer::alive = 0;
+} // namespace
+
+TEST(CompactSafeWeakPtr, makeCompact)
+{
+    auto ptr = Memory::make_compact<Observer>(3);
+    EXPECT_EQ(Observer::alive, 1);
+    EXPECT_EQ(ptr->value, 3);
+    // One control block for both the object and the lock.
+    EXPECT_FALSE(ptr.mutex.owner_before(ptr.ptr));
+    EXPECT_FALSE(ptr.ptr.owner_before(ptr.mutex));
+    EXPECT_EQ(ptr.use_count(), 1);
+    {
+        SafeSharedPtr<Observer> copy = ptr;
+        EXPECT_EQ(ptr.use_count(), 2);
+        SafeWeakPtr<Observer> weak(copy);
+        EXPECT_EQ(weak.use_count(), 2);
+        EXPECT_EQ(weak.lock()->value, 3);
+    }
+    EXPECT_EQ(ptr.use_count(), 1);
+    ptr.reset();
+    EXPECT_EQ(Observer::alive, 0);
+}
+
+TEST(CompactSafeWeakPtr, allocateCompact)
+{
+    std::allocator<Observer> alloc;
+    auto ptr = Memory::allocate_compact<Observer>(alloc, 4);
+    EXPECT_EQ(Observer::alive, 1);
+    EXPECT_EQ(ptr->value, 4);
+    EXPECT_FALSE(ptr.mutex.owner_before(ptr.ptr));
+    EXPECT_FALSE(ptr.ptr.owner_before(ptr.mutex));
+    CompactSafeWeakPtr<Observer> weak(ptr);
+    EXPECT_EQ(weak.lock()->value, 4);
+    ptr.reset();
+    EXPECT_EQ(Observer::alive, 0);
+    EXPECT_TRUE(weak.expired());
+}
+
+TEST(CompactSafeWeakPtr, lock)
+{
+    CompactSafeWeakPtr<Observer> empty;
+    EXPECT_TRUE(empty.expired());
+    EXPECT_FALSE(empty.lock());
+
+    auto ptr = Memory::make_compact<Observer>(5);
+    CompactSafeWeakPtr<Observer> weak(ptr);
+    EXPECT_LE(sizeof(weak), sizeof(std::weak_ptr<Observer>) + sizeof(void*));
+    EXPECT_FALSE(weak.expired());
+    EXPECT_EQ(weak.use_count(), 1);
+    {
+        auto strong = weak.lock();
+        EXPECT_EQ(strong.get(), ptr.get());
+        EXPECT_EQ(strong.mutex.get(), ptr.mutex.get());
+        EXPECT_EQ(weak.use_count(), 2);
+        strong->value = 6;
+    }
+    EXPECT_EQ(ptr->value, 6);
+    EXPECT_FALSE(weak.owner_before(ptr));
+
+    ptr.reset();
+    EXPECT_EQ(Observer::alive, 0);
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(weak.lock());
+
+    SafeSharedPtr<Observer> separate(new Observer(1));
+    EXPECT_THROW(weak = separate, std::invalid_argument);
+    EXPECT_NO_THROW(weak = SafeSharedPtr<Observer>());
+}
+
+TEST(CompactSafeWeakPtr, concurrentLock)
+{
+    enum { Threads = 4, Times = 20000 };
+    auto ptr = Memory::make_compact<Observer>(0);
+    const CompactSafeWeakPtr<Observer> weak(ptr);
+    std::atomic<int> locked(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&weak, &locked]() {
+            for (int j = 0; j < Times; ++j) {
+                if (auto strong = weak.lock()) {
+                    strong->value += 1;
+                    ++locked;
+                }
+            }
+        });
+    }
+    ptr.reset();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_TRUE(weak.expired());
+    EXPECT_EQ(Observer::alive, 0);
+    EXPECT_LE(locked, Threads * Times);
+}
+
+TEST(SafeWeakPtr, lockExpiring)
+{
+    // lock() racing with the last owner must never throw.
+    for (int i = 0; i < 200; ++i) {
+        SafeSharedPtr<Observer> ptr(new Observer(i));
+        SafeWeakPtr<Observer> weak(ptr);
+        std::thread thread([&ptr]() { ptr.reset(); });
+        for (int j = 0; j < 100; ++j) {
+            auto strong = weak.lock();
+            if (strong) {
+                EXPECT_EQ(strong.ptr->value, i);
+            }
+        }
+        thread.join();
+        EXPECT_FALSE(weak.lock());
+    }
+}
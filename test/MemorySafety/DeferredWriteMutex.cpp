@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/CompactSafeWeakPtr.hpp>
+#include <Utilities/MemorySafety/DeferredWriteMutex.hpp>
+#include <Utilities/MemorySafety/StripedLockPolicy.hpp>
+
+namespace {
+struct Striped
+{
+    ~Striped()
+    { *out = value; }
+
+    int value;
+    int* out;
+};
+} // namespace
+
+UTILITIES_NAMESPACE_BEGIN
+namespace Memory {
+template<>
+struct SafeLockPolicy<Striped, DeferredWriteMutex<>>
+    : StripedLockPolicy<DeferredWriteMutex<>, 16, Striped>
+{};
+} // namespace Memory
+UTILITIES_NAMESPACE_END
+
+UTILITIES_USING_NAMESPACE;
+using Memory::DeferredSafeSharedPtr;
+using Memory::DeferredWriteMutex;
+
+TEST(DeferredWriteMutex, postWhileFree)
+{
+    DeferredWriteMutex<> mutex;
+    std::vector<int> values;
+    mutex.post([&values]() { values.push_back(1); });
+    // Applied at once, the lock being free.
+    EXPECT_FALSE(mutex.pending());
+    EXPECT_EQ(values, std::vector<int>{1});
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(DeferredWriteMutex, postNeverWaits)
+{
+    DeferredWriteMutex<> mutex;
+    std::vector<int> values;
+    mutex.lock();
+    // Returns while the lock is held by this thread.
+    std::thread([&mutex, &values]() {
+        for (int i = 0; i < 100; ++i) {
+            mutex.post([&values, i]() { values.push_back(i); });
+        }
+    }).join();
+    EXPECT_TRUE(mutex.pending());
+    EXPECT_TRUE(values.empty());
+    mutex.unlock();
+
+    mutex.flush();
+    EXPECT_FALSE(mutex.pending());
+    ASSERT_EQ(values.size(), std::size_t(100));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(values[i], i);
+    }
+}
+
+TEST(DeferredWriteMutex, drainedByLockHolders)
+{
+    DeferredWriteMutex<> mutex;
+    int value = 0;
+    mutex.lock_shared();
+    mutex.post([&value]() { ++value; });
+    EXPECT_TRUE(mutex.pending());
+    // Busy writer lock: readers cannot drain without waiting.
+    EXPECT_FALSE(mutex.try_lock_shared());
+    mutex.unlock_shared();
+
+    // A reader sees the write posted before it.
+    mutex.lock_shared();
+    EXPECT_EQ(value, 1);
+    mutex.post([&value]() { ++value; });
+    mutex.unlock_shared();
+    // A writer too.
+    mutex.lock();
+    EXPECT_EQ(value, 2);
+    mutex.unlock();
+
+    mutex.lock_shared();
+    mutex.post([&value]() { ++value; });
+    mutex.unlock_shared();
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_EQ(value, 3);
+    mutex.unlock_shared();
+}
+
+TEST(DeferredWriteMutex, destructorRunsPending)
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        DeferredWriteMutex<> mutex;
+        mutex.lock();
+        std::thread([&mutex, counter]() {
+            mutex.post([counter]() { ++*counter; });
+        }).join();
+        mutex.unlock();
+        EXPECT_EQ(*counter, 0);
+    }
+    EXPECT_EQ(*counter, 1);
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(DeferredWriteMutex, concurrent)
+{
+    enum { Threads = 8, Times = 5000 };
+    DeferredWriteMutex<> mutex;
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&mutex, &value, i]() {
+            for (int j = 0; j < Times; ++j) {
+                mutex.post([&value]() { ++value; });
+                if (j % 64 == i) {
+                    Memory::SharedHolder<DeferredWriteMutex<>> reader(mutex);
+                    EXPECT_GE(value, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    mutex.flush();
+    EXPECT_EQ(value, long(Threads) * Times);
+}
+
+TEST(DeferredWriteMutex, safeSharedPtr)
+{
+    enum { Threads = 8, Times = 2000 };
+    DeferredSafeSharedPtr<std::vector<int>> ptr(new std::vector<int>);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i]() mutable {
+            for (int j = 0; j < Times; ++j) {
+                ptr.post_write([i](std::vector<int>& v) { v.push_back(i); });
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const auto& reader = ptr;
+    EXPECT_EQ(reader->size(), std::size_t(Threads * Times));
+
+    // Dropping the last handle with a write pending runs it first.
+    struct Counter
+    {
+        ~Counter()
+        { *out = value; }
+
+        int value;
+        int* out;
+    };
+    int last = -1;
+    {
+        DeferredSafeSharedPtr<Counter> counter(new Counter{0, &last});
+        counter.lock();
+        std::thread([counter]() mutable {
+            counter.post_write([](Counter& c) { ++c.value; });
+        }).join();
+        counter.unlock();
+        EXPECT_EQ(last, -1);
+    }
+    EXPECT_EQ(last, 1);
+}
+
+TEST(DeferredWriteMutex, compactLastHandle)
+{
+    struct Counter
+    {
+        ~Counter()
+        { *out = value; }
+
+        int value;
+        int* out;
+    };
+    using Mutex = DeferredWriteMutex<>;
+    int last = -1;
+    {
+        auto counter = Memory::make_compact<Counter, Mutex, Memory::SharedHolder<Mutex>, Memory::UniqueHolder<Mutex>>(
+            Counter{0, &last});
+        // Set by the temporary.
+        last = -1;
+        counter.lock();
+        counter.post_write([](Counter& c) { ++c.value; });
+        counter.post_write([](Counter& c) { ++c.value; });
+        counter.unlock();
+        EXPECT_EQ(last, -1);
+    }
+    // The queue does not keep its own owner alive, and runs before the
+    // object is destroyed.
+    EXPECT_EQ(last, 2);
+}
+
+TEST(DeferredWriteMutex, stripedLastHandle)
+{
+    using Policy = Memory::SafeLockPolicy<Striped, DeferredWriteMutex<>>;
+    int last = -1;
+    DeferredWriteMutex<>* stripe;
+    {
+        DeferredSafeSharedPtr<Striped> striped(new Striped{0, &last});
+        stripe = &Policy::lock_of(striped.get());
+        striped.lock();
+        striped.post_write([](Striped& s) { ++s.value; });
+        striped.unlock();
+        EXPECT_TRUE(stripe->pending());
+    }
+    // The stripe outlives the object, the queued write keeps it alive.
+    EXPECT_EQ(last, -1);
+    stripe->flush();
+    EXPECT_EQ(last, 1);
+}
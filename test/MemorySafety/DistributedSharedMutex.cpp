@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/DistributedSharedMutex.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::DistributedSafeSharedPtr;
+using Memory::DistributedSharedMutex;
+
+TEST(DistributedSharedMutex, exclusion)
+{
+    DistributedSharedMutex<4> mutex;
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    // A failed writer leaves the way open to readers.
+    EXPECT_FALSE(mutex.writer);
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+
+    EXPECT_TRUE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock());
+    EXPECT_FALSE(mutex.try_lock_shared());
+    EXPECT_EQ(mutex.readers(), 0);
+    mutex.unlock();
+
+    mutex.lock();
+    mutex.unlock();
+    mutex.lock_shared();
+    mutex.unlock_shared();
+}
+
+TEST(DistributedSharedMutex, slotsPerThread)
+{
+    DistributedSharedMutex<64> mutex;
+    mutex.lock_shared();
+    std::size_t other = 0;
+    std::thread([&mutex, &other]() {
+        mutex.lock_shared();
+        other = mutex.slot();
+    }).join();
+    EXPECT_NE(other, mutex.slot());
+    EXPECT_EQ(mutex.slots[mutex.slot()].readers, 1);
+    EXPECT_EQ(mutex.readers(), 2);
+    EXPECT_FALSE(mutex.try_lock());
+
+    // Released here although acquired by the other thread.
+    mutex.unlock_shared();
+    mutex.unlock_shared();
+    EXPECT_EQ(mutex.readers(), 0);
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+}
+
+TEST(DistributedSharedMutex, writerWaitsReaders)
+{
+    DistributedSharedMutex<8> mutex;
+    std::atomic<bool> locked(false);
+    mutex.lock_shared();
+    std::thread writer([&]() {
+        mutex.lock();
+        locked = true;
+        mutex.unlock();
+    });
+    while (!mutex.writer) {
+        std::this_thread::yield();
+    }
+    // The pending writer holds back new readers.
+    EXPECT_FALSE(mutex.try_lock_shared());
+    EXPECT_FALSE(locked);
+    mutex.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(locked);
+}
+
+TEST(DistributedSharedMutex, safeSharedPtr)
+{
+    enum { Threads = 8, Times = 5000 };
+    DistributedSafeSharedPtr<long> ptr(new long(0));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i]() mutable {
+            for (int j = 0; j < Times; ++j) {
+                if (j % 8 == i % 8) {
+                    *ptr += 1;
+                } else {
+                    const auto& reader = ptr;
+                    EXPECT_GE(*reader, 0);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(*ptr, long(Threads) * Times / 8);
+}
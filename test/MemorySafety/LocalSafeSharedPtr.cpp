@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/LocalSafeSharedPtr.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::LocalSafeSharedPtr;
+using Memory::SafeSharedPtr;
+
+struct Counter
+{
+    int value = 0;
+    void add() { ++value; }
+    int get() const { return value; }
+};
+
+TEST(LocalSafeSharedPtr, localCopies)
+{
+    LocalSafeSharedPtr<Counter> empty;
+    EXPECT_FALSE(empty);
+    EXPECT_EQ(empty.local_count(), 0u);
+    EXPECT_EQ(empty.use_count(), 0);
+    EXPECT_FALSE(empty.to_shared());
+
+    auto local = Memory::make_local<Counter>();
+    EXPECT_TRUE(local);
+    EXPECT_EQ(local.use_count(), 1);
+    {
+        LocalSafeSharedPtr<Counter> copy1 = local;
+        LocalSafeSharedPtr<Counter> copy2(copy1);
+        EXPECT_EQ(local.local_count(), 3u);
+        // Local copies share one SafeSharedPtr reference.
+        EXPECT_EQ(local.use_count(), 1);
+        EXPECT_EQ(copy2.get(), local.get());
+
+        LocalSafeSharedPtr<Counter> moved(std::move(copy2));
+        EXPECT_FALSE(copy2);
+        EXPECT_EQ(local.local_count(), 3u);
+        moved.reset();
+        EXPECT_EQ(local.local_count(), 2u);
+    }
+    EXPECT_EQ(local.local_count(), 1u);
+
+    local->add();
+    const LocalSafeSharedPtr<Counter>& reader = local;
+    EXPECT_EQ(reader->get(), 1);
+    EXPECT_EQ(local.shared()->value, 1);
+}
+
+TEST(LocalSafeSharedPtr, lastCopyReleases)
+{
+    SafeSharedPtr<Counter> shared(new Counter);
+    {
+        LocalSafeSharedPtr<Counter> local(shared);
+        LocalSafeSharedPtr<Counter> other;
+        other = local;
+        EXPECT_EQ(shared.use_count(), 2);
+        local.reset();
+        EXPECT_EQ(shared.use_count(), 2);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(LocalSafeSharedPtr, crossThreads)
+{
+    enum { Threads = 4, Times = 10000 };
+    auto local = Memory::make_local<Counter>();
+    const SafeSharedPtr<Counter> shared = local.to_shared();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([shared]() {
+            LocalSafeSharedPtr<Counter> mine(shared);
+            for (int j = 0; j < Times; ++j) {
+                LocalSafeSharedPtr<Counter> copy = mine;
+                copy->add();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(local->get(), Threads * Times);
+    EXPECT_EQ(local.use_count(), 2);
+}
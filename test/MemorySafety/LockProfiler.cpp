@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+#include <Utilities/MemorySafety/LockProfiler.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::LockMode;
+using Memory::LockProfiler;
+using Memory::LockStats;
+using Memory::ProfiledLock;
+using Memory::RWSpinLock;
+
+struct ProfilerSite
+{
+    static const char* name() { return "ProfilerSite"; }
+};
+
+TEST(LockProfiler, counters)
+{
+    ProfiledLock<RWSpinLock> lock("counters");
+    EXPECT_EQ(lock.stats().name(), "counters");
+    {
+        Memory::UniqueHolder<ProfiledLock<RWSpinLock>> writer(lock);
+    }
+    {
+        Memory::SharedHolder<ProfiledLock<RWSpinLock>> reader1(lock);
+        Memory::SharedHolder<ProfiledLock<RWSpinLock>> reader2(lock);
+        EXPECT_FALSE(lock.try_lock());
+    }
+    const LockStats::Counters& exclusive = lock.stats().counters(LockMode::Exclusive);
+    const LockStats::Counters& shared = lock.stats().counters(LockMode::Shared);
+    EXPECT_EQ(exclusive.acquisitions.load(), 1u);
+    EXPECT_EQ(exclusive.contended.load(), 0u);
+    EXPECT_EQ(exclusive.hold.total(), 1u);
+    EXPECT_EQ(shared.acquisitions.load(), 2u);
+    EXPECT_EQ(shared.hold.total(), 2u);
+
+    ProfiledLock<RWSpinLock> unnamed;
+    EXPECT_EQ(unnamed.stats().name().find("ProfiledLock@"), 0u);
+}
+
+TEST(LockProfiler, contention)
+{
+    ProfiledLock<RWSpinLock> spin;
+    ProfiledLock<std::mutex> blocking;
+    std::atomic<bool> waiting(false);
+    spin.lock();
+    blocking.lock();
+    std::thread thread([&] {
+        waiting = true;
+        spin.lock_shared();
+        spin.unlock_shared();
+        blocking.lock();
+        blocking.unlock();
+    });
+    while (!waiting) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    spin.unlock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    blocking.unlock();
+    thread.join();
+
+    const LockStats::Counters& shared = spin.stats().counters(LockMode::Shared);
+    EXPECT_EQ(shared.contended.load(), 1u);
+    EXPECT_GT(shared.spins.load(), 0u);
+    EXPECT_GE(shared.wait.percentile(1.0), 1000u * 1000u);
+    EXPECT_GE(spin.stats().counters(LockMode::Exclusive).hold.percentile(1.0), 1000u * 1000u);
+
+    const LockStats::Counters& exclusive = blocking.stats().counters(LockMode::Exclusive);
+    EXPECT_EQ(exclusive.acquisitions.load(), 2u);
+    EXPECT_EQ(exclusive.contended.load(), 1u);
+    EXPECT_EQ(exclusive.spins.load(), 0u);
+}
+
+TEST(LockProfiler, site)
+{
+    using Ptr = Memory::ProfiledSafeSharedPtr<int, RWSpinLock, ProfilerSite>;
+    Ptr first = Memory::make_profiled<int, RWSpinLock, ProfilerSite>(1);
+    Ptr second(new int(2));
+    *first = 3;
+    const Ptr& reader = second;
+    EXPECT_EQ(*reader, 2);
+
+    LockStats& stats = LockProfiler::site<ProfilerSite>();
+    EXPECT_EQ(stats.counters(LockMode::Exclusive).acquisitions.load(), 1u);
+    EXPECT_EQ(stats.counters(LockMode::Shared).acquisitions.load(), 1u);
+
+    std::ostringstream os;
+    LockProfiler::instance().dump(os);
+    EXPECT_NE(os.str().find("ProfilerSite\n  shared    acquisitions 1"), std::string::npos);
+    EXPECT_NE(os.str().find("  exclusive acquisitions 1"), std::string::npos);
+}
+
+TEST(LockProfiler, chromeTrace)
+{
+    LockProfiler& profiler = LockProfiler::instance();
+    profiler.reset();
+    profiler.start_tracing(3);
+    ProfiledLock<RWSpinLock> lock("trace \"quoted\"");
+    for (int i = 0; i < 5; ++i) {
+        lock.lock();
+        lock.unlock();
+    }
+    profiler.stop_tracing();
+    lock.lock_shared();
+    lock.unlock_shared();
+
+    EXPECT_EQ(profiler.trace_events().size(), 3u);
+    EXPECT_EQ(profiler.dropped_events(), 2u);
+    std::ostringstream os;
+    profiler.write_chrome_trace(os);
+    const std::string json = os.str();
+    EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+    EXPECT_NE(json.find("\"name\":\"trace \\\"quoted\\\"\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"mode\":\"exclusive\""), std::string::npos);
+    EXPECT_EQ(json.find("\"mode\":\"shared\""), std::string::npos);
+    EXPECT_NE(json.find("\"dropped\":2"), std::string::npos);
+    profiler.reset();
+    EXPECT_EQ(profiler.trace_events().size(), 0u);
+    EXPECT_EQ(lock.stats().counters(LockMode::Exclusive).acquisitions.load(), 0u);
+}
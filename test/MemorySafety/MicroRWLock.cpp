@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/MicroRWLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::MicroRWLock;
+using Memory::MicroRWLockBits;
+using Memory::PackedLockPtr;
+
+namespace {
+struct alignas(16) Node
+{
+    int value = 0;
+    PackedLockPtr<Node> next;
+};
+} // namespace
+
+TEST(MicroRWLock, modes)
+{
+    static_assert(sizeof(MicroRWLock) == 1, "MicroRWLock is one byte");
+    MicroRWLock lock;
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_shared();
+    lock.unlock_shared();
+    EXPECT_EQ(lock.bits(), 0);
+    {
+        MicroRWLock::WriteHolder writer(lock);
+        EXPECT_FALSE(lock.try_lock_shared());
+        EXPECT_FALSE(lock.try_lock());
+    }
+    EXPECT_EQ(lock.bits(), 0);
+}
+
+TEST(MicroRWLock, sharedWord)
+{
+    // Lock in bits 4-7, caller's flags around it.
+    using Lock = MicroRWLockBits<uint16_t, 4, 4>;
+    EXPECT_EQ(Lock::max_readers(), 7u);
+    std::atomic<uint16_t> word(0xF00F);
+    for (int i = 0; i < 7; ++i) {
+        EXPECT_TRUE(Lock::try_lock_shared(word));
+    }
+    // Reader count exhausted.
+    EXPECT_FALSE(Lock::try_lock_shared(word));
+    word.fetch_xor(0x0100);
+    for (int i = 0; i < 7; ++i) {
+        Lock::unlock_shared(word);
+    }
+    EXPECT_EQ(word.load(), 0xF10F);
+    Lock::lock(word);
+    EXPECT_EQ(word.load(), 0xF11F);
+    EXPECT_FALSE(Lock::try_lock_shared(word));
+    Lock::unlock(word);
+    EXPECT_EQ(word.load(), 0xF10F);
+}
+
+TEST(MicroRWLock, packedPointer)
+{
+    static_assert(sizeof(PackedLockPtr<Node>) == sizeof(void*), "PackedLockPtr is one word");
+    EXPECT_EQ(PackedLockPtr<Node>::max_readers(), 7u);
+    Node first, second;
+    first.next.reset(&second);
+    {
+        PackedLockPtr<Node>::ReadHolder reader(first.next);
+        EXPECT_EQ(first.next.get(), &second);
+        EXPECT_FALSE(first.next.try_lock());
+    }
+    {
+        PackedLockPtr<Node>::WriteHolder writer(first.next);
+        first.next.reset(nullptr);
+        EXPECT_FALSE(first.next);
+        EXPECT_FALSE(first.next.try_lock_shared());
+    }
+    EXPECT_TRUE(first.next.try_lock());
+    first.next.unlock();
+}
+
+TEST(MicroRWLock, concurrent)
+{
+    enum { Threads = 16, Times = 2000 };
+    MicroRWLock lock;
+    Node head, a, b;
+    head.next.reset(&a);
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < Times; ++j) {
+                if ((i + j) % 2 == 0) {
+                    MicroRWLock::WriteHolder writer(lock);
+                    ++value;
+                    PackedLockPtr<Node>::WriteHolder link(head.next);
+                    head.next->value += 1;
+                    head.next.reset(head.next.get() == &a ? &b : &a);
+                } else {
+                    MicroRWLock::ReadHolder reader(lock);
+                    EXPECT_GE(value, 0);
+                    PackedLockPtr<Node>::ReadHolder link(head.next);
+                    EXPECT_TRUE(head.next.get() == &a || head.next.get() == &b);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(value, Threads * Times / 2);
+    EXPECT_EQ(a.value + b.value, Threads * Times / 2);
+    EXPECT_EQ(lock.bits(), 0);
+}
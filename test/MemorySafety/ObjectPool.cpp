@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/ObjectPool.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::ObjectPool;
+using Memory::make_pooled;
+
+namespace {
+std::atomic<int> alive(0);
+
+struct Order
+{
+    Order(int id, double price)
+        : id(id), price(price)
+    { ++alive; }
+
+    ~Order()
+    { --alive; }
+
+    int id;
+    double price;
+};
+
+using Pool = ObjectPool<Order, Memory::RWSpinLock, Memory::RWSpinLock::ReadHolder, Memory::RWSpinLock::WriteHolder>;
+} // namespace
+
+TEST(ObjectPool, recycles)
+{
+    Pool pool;
+    auto first = make_pooled<Order>(pool, 1, 2.5);
+    EXPECT_EQ(first->id, 1);
+    EXPECT_EQ(first->price, 2.5);
+    EXPECT_EQ(alive, 1);
+    const Order* address = first.get();
+    first.reset();
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(pool.cached(), std::size_t(1));
+
+    // Same chunk, object and lock constructed anew.
+    auto second = make_pooled<Order>(pool, 2, 3.0);
+    EXPECT_EQ(second.get(), address);
+    EXPECT_EQ(second->id, 2);
+    EXPECT_EQ(pool.cached(), std::size_t(0));
+    EXPECT_TRUE(second.try_write());
+
+    // Lock and object share the chunk.
+    Memory::CompactSafeWeakPtr<Order, Memory::RWSpinLock, Memory::RWSpinLock::ReadHolder,
+                               Memory::RWSpinLock::WriteHolder> weak(second);
+    second.reset();
+    EXPECT_EQ(alive, 0);
+    // Kept by the weak handle until it goes.
+    EXPECT_EQ(pool.cached(), std::size_t(0));
+    weak.reset();
+    EXPECT_EQ(pool.cached(), std::size_t(1));
+
+    pool.clear();
+    EXPECT_EQ(pool.cached(), std::size_t(0));
+}
+
+TEST(ObjectPool, bounded)
+{
+    Pool pool(2, 4);
+    EXPECT_EQ(pool.capacity(), std::size_t(2));
+    EXPECT_EQ(pool.thread_capacity(), std::size_t(4));
+    std::vector<Pool::pointer> orders;
+    for (int i = 0; i < 10; ++i) {
+        orders.push_back(make_pooled<Order>(pool, i, 0.0));
+    }
+    orders.clear();
+    EXPECT_EQ(alive, 0);
+    // Full thread cache and shared list, the rest was freed.
+    EXPECT_EQ(pool.cached(), std::size_t(6));
+}
+
+TEST(ObjectPool, otherThreads)
+{
+    Pool pool(1024, 4);
+    std::vector<Pool::pointer> orders;
+    std::set<const Order*> addresses;
+    for (int i = 0; i < 8; ++i) {
+        orders.push_back(make_pooled<Order>(pool, i, 0.0));
+        addresses.insert(orders.back().get());
+    }
+    // Dropped by another thread, which spills half of its full cache to the
+    // shared list twice, and frees the rest when it exits.
+    std::thread([&orders]() { orders.clear(); }).join();
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(pool.cached(), std::size_t(4));
+    // Taken back from there.
+    auto order = make_pooled<Order>(pool, 1, 1.0);
+    EXPECT_EQ(addresses.count(order.get()), std::size_t(1));
+    EXPECT_EQ(pool.cached(), std::size_t(3));
+}
+
+TEST(ObjectPool, creatingThreadExits)
+{
+    Pool pool(1024, 4);
+    std::vector<Pool::pointer> orders;
+    for (int i = 0; i < 8; ++i) {
+        orders.push_back(make_pooled<Order>(pool, i, 0.0));
+    }
+    std::thread([&orders]() { orders.clear(); }).join();
+    EXPECT_EQ(pool.cached(), std::size_t(4));
+    // Takes chunks from the shared list without ever giving one back, and
+    // frees those left in its cache when it exits.
+    Pool::pointer order;
+    std::thread([&pool, &order]() {
+        order = make_pooled<Order>(pool, 1, 1.0);
+        EXPECT_EQ(pool.cached(), std::size_t(3));
+    }).join();
+    EXPECT_EQ(order->id, 1);
+    EXPECT_EQ(pool.cached(), std::size_t(2));
+    order.reset();
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(ObjectPool, defaultPolicy)
+{
+    ObjectPool<std::vector<int>> pool;
+    auto values = make_pooled<std::vector<int>>(pool, 3, 7);
+    values->push_back(8);
+    const auto& reader = values;
+    EXPECT_EQ(reader->size(), std::size_t(4));
+    values.reset();
+    EXPECT_EQ(pool.cached(), std::size_t(1));
+}
+
+TEST(ObjectPool, concurrent)
+{
+    enum { Threads = 8, Times = 5000 };
+    Pool pool(64, 8);
+    Pool::pointer shared = make_pooled<Order>(pool, 0, 0.0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&pool, shared, i]() mutable {
+            std::vector<Pool::pointer> mine;
+            for (int j = 0; j < Times; ++j) {
+                mine.push_back(make_pooled<Order>(pool, i, double(j)));
+                EXPECT_EQ(mine.back()->id, i);
+                if (mine.size() > std::size_t(j % 7)) {
+                    mine.clear();
+                }
+                ++shared->id;
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(shared->id, Threads * Times);
+    shared.reset();
+    EXPECT_EQ(alive, 0);
+    EXPECT_LE(pool.cached(), pool.capacity() + pool.thread_capacity());
+}
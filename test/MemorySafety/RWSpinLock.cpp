@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::BackoffRWSpinLock;
+using Memory::FutexRWSpinLock;
+using Memory::RWSpinLock;
+using Memory::WriterPreferringRWSpinLock;
+
+// Bit of FutexRWSpinLock flagging parked waiters.
+enum : int32_t { Parked = 4 };
+// Bit of WriterPreferringRWSpinLock flagging pending writers, and its reader.
+enum : int32_t { Pending = 4, PreferringReader = 8 };
+
+template<typename Lock>
+class RWSpinLockTest : public ::testing::Test
+{};
+
+using Locks = ::testing::Types<RWSpinLock,
+                               FutexRWSpinLock,
+                               BackoffRWSpinLock,
+                               WriterPreferringRWSpinLock,
+                               Memory::RWSpinLockT<Memory::FutexWaitPolicy, true>>;
+TYPED_TEST_CASE(RWSpinLockTest, Locks);
+
+TYPED_TEST(RWSpinLockTest, modes)
+{
+    TypeParam lock;
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    EXPECT_TRUE(lock.try_lock_upgrade());
+    EXPECT_FALSE(lock.try_lock_shared());
+    lock.unlock_shared();
+    lock.unlock_upgrade_and_lock();
+    EXPECT_FALSE(lock.try_lock_upgrade());
+    lock.unlock_and_lock_shared();
+    EXPECT_TRUE(lock.try_lock_shared());
+    lock.unlock_shared();
+    lock.unlock_shared();
+    EXPECT_EQ(lock.bits(), 0);
+
+    typename TypeParam::WriteHolder writer(lock);
+    EXPECT_FALSE(lock.try_lock_shared());
+}
+
+TYPED_TEST(RWSpinLockTest, concurrent)
+{
+    enum { Threads = 16, Times = 2000 };
+    TypeParam lock;
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&lock, &value, i]() {
+            for (int j = 0; j < Times; ++j) {
+                switch ((i + j) % 4) {
+                case 0: {
+                    typename TypeParam::WriteHolder writer(lock);
+                    ++value;
+                    break;
+                }
+                case 1: {
+                    typename TypeParam::UpgradedHolder upgraded(lock);
+                    typename TypeParam::WriteHolder writer(std::move(upgraded));
+                    ++value;
+                    break;
+                }
+                default: {
+                    typename TypeParam::ReadHolder reader(lock);
+                    EXPECT_GE(value, 0);
+                }
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(value, long(Threads) * Times / 2);
+    EXPECT_EQ(lock.bits(), 0);
+}
+
+TEST(FutexRWSpinLock, parksAndWakes)
+{
+    FutexRWSpinLock lock;
+    std::atomic<int> acquired(0);
+    lock.lock();
+    std::thread reader([&]() {
+        lock.lock_shared();
+        ++acquired;
+        lock.unlock_shared();
+    });
+    std::thread writer([&]() {
+        lock.lock();
+        ++acquired;
+        lock.unlock();
+    });
+    // Both give up spinning and flag themselves as parked.
+    while (!(lock.bits() & Parked)) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(acquired, 0);
+    lock.unlock();
+    reader.join();
+    writer.join();
+    EXPECT_EQ(acquired, 2);
+    EXPECT_EQ(lock.bits() & ~Parked, 0);
+}
+
+TEST(FutexRWSpinLock, readersWakeWriter)
+{
+    FutexRWSpinLock lock;
+    std::atomic<bool> done(false);
+    lock.lock_shared();
+    lock.lock_shared();
+    std::thread writer([&]() {
+        lock.lock();
+        done = true;
+        lock.unlock();
+    });
+    while (!(lock.bits() & Parked)) {
+        std::this_thread::yield();
+    }
+    lock.unlock_shared();
+    EXPECT_FALSE(done);
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(done);
+}
+
+#if defined(__linux__)
+TEST(FutexRWSpinLock, parkedReadersSleep)
+{
+    enum { Readers = 4 };
+    FutexRWSpinLock lock;
+    lock.lock();
+    std::vector<std::thread> readers;
+    for (int i = 0; i < Readers; ++i) {
+        readers.emplace_back([&lock]() {
+            lock.lock_shared();
+            lock.unlock_shared();
+        });
+    }
+    while (!(lock.bits() & Parked)) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Failed attempts of readers woken by each other would keep the process busy.
+    const std::clock_t start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const double cpu = double(std::clock() - start) / CLOCKS_PER_SEC;
+    EXPECT_LT(cpu, 0.1);
+    lock.unlock();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(lock.bits() & ~Parked, 0);
+}
+#endif
+
+TEST(BackoffRWSpinLock, adaptiveBudget)
+{
+    // Stateless policies cost no space.
+    EXPECT_EQ(sizeof(RWSpinLock), sizeof(int32_t));
+
+    BackoffRWSpinLock lock;
+    auto& policy = lock.policy();
+    policy.configure(8, 64, 16);
+    EXPECT_EQ(policy.spin_limit(), 8u);
+    for (int i = 0; i < 100; ++i) {
+        policy.acquired(1000);
+    }
+    EXPECT_EQ(policy.spin_limit(), 64u);
+    for (int i = 0; i < 100; ++i) {
+        policy.acquired(1);
+    }
+    EXPECT_EQ(policy.spin_limit(), 8u);
+
+    // Pauses end as soon as the lock looks free.
+    int polls = 0;
+    policy.pause(5, [&polls]() { return ++polls < 3; });
+    EXPECT_EQ(polls, 3);
+}
+
+TEST(WriterPreferringRWSpinLock, pendingBlocksReaders)
+{
+    WriterPreferringRWSpinLock lock;
+    std::atomic<bool> done(false);
+    lock.lock_shared();
+    std::thread writer([&]() {
+        lock.lock();
+        done = true;
+        lock.unlock();
+    });
+    while (!(lock.bits() & Pending)) {
+        std::this_thread::yield();
+    }
+    // New readers are held back, the one inside keeps its lock.
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_FALSE(done);
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(done);
+    EXPECT_EQ(lock.bits(), 0);
+}
+
+TEST(WriterPreferringRWSpinLock, withdrawOnTimeout)
+{
+    WriterPreferringRWSpinLock lock;
+    lock.lock_shared();
+    EXPECT_FALSE(lock.try_lock_for(std::chrono::milliseconds(20)));
+    // The writer gave up, readers are welcome again.
+    EXPECT_EQ(lock.bits(), PreferringReader);
+    EXPECT_TRUE(lock.try_lock_shared());
+    lock.unlock_shared();
+    lock.unlock_shared();
+    EXPECT_EQ(lock.bits(), 0);
+}
+
+TEST(WriterPreferringRWSpinLock, writerNotStarved)
+{
+    // Readers overlap each other, so the lock is never free of readers.
+    WriterPreferringRWSpinLock lock;
+    std::atomic<bool> stop(false);
+    std::atomic<bool> wrote(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                WriterPreferringRWSpinLock::ReadHolder reader(lock);
+                std::this_thread::yield();
+            }
+        });
+    }
+    std::thread writer([&]() {
+        WriterPreferringRWSpinLock::WriteHolder holder(lock);
+        wrote = true;
+    });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!wrote.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(wrote.load());
+    stop = true;
+    writer.join();
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(lock.bits(), 0);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/RWSpinLock64.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::RWSpinLock64;
+
+TEST(RWSpinLock64, modes)
+{
+    RWSpinLock64 lock;
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    EXPECT_TRUE(lock.try_lock_upgrade());
+    EXPECT_FALSE(lock.try_lock_upgrade());
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_unlock_upgrade_and_lock());
+    lock.unlock_shared();
+    lock.unlock_upgrade_and_lock();
+    EXPECT_TRUE(lock.state().writer);
+    EXPECT_FALSE(lock.state().upgraded);
+    lock.unlock_and_lock_upgrade();
+    EXPECT_TRUE(lock.state().upgraded);
+    lock.unlock_upgrade_and_lock_shared();
+    EXPECT_EQ(lock.state().readers, 1u);
+    lock.unlock_shared();
+    EXPECT_EQ(lock.bits(), 0u);
+
+    {
+        RWSpinLock64::WriteHolder writer(lock);
+        EXPECT_FALSE(lock.try_lock_shared());
+        EXPECT_FALSE(lock.try_lock_upgrade());
+    }
+    EXPECT_EQ(lock.bits(), 0u);
+}
+
+TEST(RWSpinLock64, waiterCounts)
+{
+    RWSpinLock64 lock;
+    lock.lock();
+#ifndef NDEBUG
+    EXPECT_EQ(lock.state().owner, std::this_thread::get_id());
+#endif
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 2; ++i) {
+        waiters.emplace_back([&lock]() {
+            RWSpinLock64::WriteHolder writer(lock);
+        });
+    }
+    waiters.emplace_back([&lock]() {
+        lock.lock_upgrade();
+        lock.unlock_upgrade();
+    });
+    while (lock.state().waitingWriters != 2 || lock.state().waitingUpgraders != 1) {
+        std::this_thread::yield();
+    }
+    // A timed writer counts while it waits only.
+    EXPECT_FALSE(lock.try_lock_for(std::chrono::milliseconds(5)));
+    EXPECT_EQ(lock.state().waitingWriters, 2u);
+
+    lock.unlock();
+    for (auto& t : waiters) {
+        t.join();
+    }
+    const auto state = lock.state();
+    EXPECT_FALSE(state.writer);
+    EXPECT_FALSE(state.upgraded);
+    EXPECT_EQ(state.readers, 0u);
+    EXPECT_EQ(state.waitingWriters, 0u);
+    EXPECT_EQ(state.waitingUpgraders, 0u);
+    EXPECT_EQ(state.owner, std::thread::id());
+}
+
+TEST(RWSpinLock64, waitingWriterHoldsBackReaders)
+{
+    RWSpinLock64 lock;
+    std::atomic<bool> done(false);
+    lock.lock_shared();
+    std::thread writer([&]() {
+        lock.lock();
+        done = true;
+        lock.unlock();
+    });
+    while (lock.state().waitingWriters == 0) {
+        std::this_thread::yield();
+    }
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_FALSE(done);
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(done);
+
+    // Readers ignore waiting writers without preference.
+    Memory::RWSpinLock64T<Memory::YieldWaitPolicy, false> plain;
+    plain.lock_shared();
+    std::thread other([&]() {
+        plain.lock();
+        plain.unlock();
+    });
+    while (plain.state().waitingWriters == 0) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(plain.try_lock_shared());
+    plain.unlock_shared();
+    plain.unlock_shared();
+    other.join();
+}
+
+TEST(RWSpinLock64, readerOverflow)
+{
+    RWSpinLock64 lock;
+    // Readers at the limit, without taking 2^29 locks.
+    lock.bits_.store(uint64_t(RWSpinLock64::MaxReaders) << 34);
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_EQ(lock.state().readers, RWSpinLock64::MaxReaders);
+    lock.bits_.store(uint64_t(RWSpinLock64::MaxReaders - 1) << 34);
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_EQ(lock.state().readers, RWSpinLock64::MaxReaders);
+}
+
+TEST(RWSpinLock64, concurrent)
+{
+    enum { Threads = 16, Times = 2000 };
+    Memory::RWSpinLock64T<Memory::BackoffWaitPolicy> lock;
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&lock, &value, i]() {
+            for (int j = 0; j < Times; ++j) {
+                switch ((i + j) % 4) {
+                case 0:
+                    lock.lock();
+                    ++value;
+                    lock.unlock();
+                    break;
+                case 1:
+                    lock.lock_upgrade();
+                    lock.unlock_upgrade_and_lock();
+                    ++value;
+                    lock.unlock();
+                    break;
+                default:
+                    lock.lock_shared();
+                    EXPECT_GE(value, 0);
+                    lock.unlock_shared();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(value, long(Threads) * Times / 2);
+    EXPECT_EQ(lock.bits(), 0u);
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/RWTicketSpinLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::RWTicketSpinLock32;
+using Memory::RWTicketSpinLock64;
+
+template<typename Lock>
+class RWTicketSpinLockTest : public ::testing::Test
+{};
+
+using Locks = ::testing::Types<RWTicketSpinLock32, RWTicketSpinLock64, Memory::RWTicketSpinLockT<32, false>>;
+TYPED_TEST_CASE(RWTicketSpinLockTest, Locks);
+
+TYPED_TEST(RWTicketSpinLockTest, modes)
+{
+    TypeParam lock;
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_shared();
+    lock.unlock_shared();
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_and_lock_shared();
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_shared();
+    lock.unlock_shared();
+
+    {
+        typename TypeParam::WriteHolder writer(lock);
+        EXPECT_FALSE(lock.try_lock_shared());
+        typename TypeParam::ReadHolder reader(std::move(writer));
+        EXPECT_TRUE(lock.try_lock_shared());
+        lock.unlock_shared();
+    }
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TYPED_TEST(RWTicketSpinLockTest, wrapAround)
+{
+    // Runs the counters around several times.
+    TypeParam lock;
+    for (int i = 0; i < 3 * 65536 + 7; ++i) {
+        if (i % 3 == 0) {
+            typename TypeParam::WriteHolder writer(lock);
+        } else {
+            typename TypeParam::ReadHolder reader(lock);
+        }
+    }
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock_shared());
+    lock.unlock_shared();
+}
+
+TYPED_TEST(RWTicketSpinLockTest, concurrent)
+{
+    enum { Threads = 16, Times = 2000 };
+    TypeParam lock;
+    long value = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([&lock, &value, i]() {
+            for (int j = 0; j < Times; ++j) {
+                if ((i + j) % 2 == 0) {
+                    typename TypeParam::WriteHolder writer(lock);
+                    ++value;
+                } else {
+                    typename TypeParam::ReadHolder reader(lock);
+                    EXPECT_GE(value, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(value, Threads * Times / 2);
+}
+
+TEST(RWTicketSpinLock, writerNotStarved)
+{
+    // Readers overlap each other, so the lock is never free; the writer gets
+    // in anyway once queued.
+    RWTicketSpinLock32 lock;
+    std::atomic<bool> done(false);
+    std::atomic<bool> wrote(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                RWTicketSpinLock32::ReadHolder reader(lock);
+                std::this_thread::yield();
+            }
+        });
+    }
+    std::thread writer([&]() {
+        RWTicketSpinLock32::WriteHolder holder(lock);
+        wrote = true;
+    });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!wrote.load() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(wrote.load());
+    done = true;
+    writer.join();
+    for (auto& t : readers) {
+        t.join();
+    }
+}
+
+TEST(RWTicketSpinLock, safeSharedPtr)
+{
+    enum { Threads = 8, Times = 5000 };
+    Memory::TicketSafeSharedPtr<long> ptr(new long(0));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Threads; ++i) {
+        threads.emplace_back([ptr, i]() mutable {
+            for (int j = 0; j < Times; ++j) {
+                if (j % 8 == i % 8) {
+                    *ptr += 1;
+                } else {
+                    const auto& reader = ptr;
+                    EXPECT_GE(*reader, 0);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(*ptr, Threads * Times / 8);
+
+    Memory::TicketSafeSharedPtr<int, 32> small(new int(1));
+    *small = 2;
+    EXPECT_EQ(*small, 2);
+}
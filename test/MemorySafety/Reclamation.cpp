@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <Utilities/MemorySafety/Reclamation.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::HazardPointer;
+using Memory::HazardPointerDomain;
+using Memory::EpochDomain;
+
+static std::atomic<int> alive(0);
+
+struct Node
+{
+    Node(int v) : value(v), check(v) { ++alive; }
+    ~Node() { check = -1; --alive; }
+    int value;
+    int check;
+};
+
+TEST(Reclamation, HazardPointerProtect)
+{
+    {
+        HazardPointerDomain domain(1000);
+        std::atomic<Node*> head(new Node(1));
+
+        HazardPointer hazard(domain);
+        Node* protectedNode = hazard.protect(head);
+        EXPECT_EQ(protectedNode->value, 1);
+
+        domain.retire(head.exchange(new Node(2)));
+        EXPECT_EQ(domain.reclaim(), 0u);
+        EXPECT_EQ(domain.retired_count(), 1u);
+        EXPECT_EQ(protectedNode->check, 1);
+
+        hazard.reset();
+        EXPECT_EQ(domain.reclaim(), 1u);
+        EXPECT_EQ(domain.retired_count(), 0u);
+        EXPECT_EQ(alive.load(), 1);
+
+        Node* node = head.load();
+        Node* stale = nullptr;
+        EXPECT_FALSE(hazard.try_protect(stale, head));
+        EXPECT_EQ(stale, node);
+        EXPECT_TRUE(hazard.try_protect(stale, head));
+
+        domain.retire(head.exchange(nullptr));
+    }
+    EXPECT_EQ(alive.load(), 0);
+}
+
+TEST(Reclamation, HazardPointerConcurrent)
+{
+    {
+        HazardPointerDomain domain(16);
+        std::atomic<Node*> head(new Node(0));
+        std::atomic<bool> stop(false);
+        std::atomic<int> corrupted(0);
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                HazardPointer hazard(domain);
+                while (!stop.load()) {
+                    Node* node = hazard.protect(head);
+                    if (node->check != node->value) {
+                        ++corrupted;
+                    }
+                    hazard.reset();
+                }
+            });
+        }
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 2; ++i) {
+            writers.emplace_back([&] {
+                for (int v = 1; v <= 20 * 1000; ++v) {
+                    domain.retire(head.exchange(new Node(v)));
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        stop = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        EXPECT_EQ(corrupted.load(), 0);
+        domain.reclaim();
+        EXPECT_EQ(domain.retired_count(), 0u);
+        delete head.load();
+    }
+    EXPECT_EQ(alive.load(), 0);
+}
+
+TEST(Reclamation, EpochPin)
+{
+    {
+        EpochDomain domain(1000);
+        EpochDomain::ThreadHandle reader = domain.register_thread();
+        EpochDomain::ThreadHandle writer = domain.register_thread();
+        std::atomic<Node*> head(new Node(1));
+
+        {
+            EpochDomain::Guard guard = reader.pin();
+            Node* node = head.load();
+            writer.retire(head.exchange(new Node(2)));
+            EXPECT_EQ(writer.collect(), 0u);
+            EXPECT_EQ(writer.collect(), 0u);
+            EXPECT_EQ(node->check, 1);
+        }
+        writer.collect();
+        writer.collect();
+        EXPECT_EQ(alive.load(), 1);
+
+        bool deleted = false;
+        writer.retire(head.exchange(nullptr), [&deleted](Node* p) {
+            delete p;
+            deleted = true;
+        });
+        EXPECT_FALSE(deleted);
+    }
+    EXPECT_EQ(alive.load(), 0);
+}
+
+TEST(Reclamation, EpochConcurrent)
+{
+    {
+        EpochDomain domain(16);
+        std::atomic<Node*> head(new Node(0));
+        std::atomic<bool> stop(false);
+        std::atomic<int> corrupted(0);
+
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                EpochDomain::ThreadHandle handle = domain.register_thread();
+                while (!stop.load()) {
+                    EpochDomain::Guard guard = handle.pin();
+                    Node* node = head.load();
+                    if (node->check != node->value) {
+                        ++corrupted;
+                    }
+                }
+            });
+        }
+        std::vector<std::thread> writers;
+        for (int i = 0; i < 2; ++i) {
+            writers.emplace_back([&] {
+                EpochDomain::ThreadHandle handle = domain.register_thread();
+                for (int v = 1; v <= 20 * 1000; ++v) {
+                    EpochDomain::Guard guard = handle.pin();
+                    handle.retire(head.exchange(new Node(v)));
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        stop = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        EXPECT_EQ(corrupted.load(), 0);
+        EXPECT_GT(domain.current_epoch(), 0u);
+        delete head.load();
+    }
+    EXPECT_EQ(alive.load(), 0);
+}
@@ -1,10 +1,12 @@
 ﻿#include <gtest/gtest.h>
 #include <thread>
+#include <chrono>
 #include <functional>
 #include <string>
 #include <sstream>
 #define private public
 #include <Utilities/MemorySafety/SafeSharedPtr.hpp>
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
 
 UTILITIES_USING_NAMESPACE;
 using Memory::SafeSharedPtr;
@@ -491,6 +493,97 @@ TEST(SafeSharedPtr, weakPtr)
     EXPECT_EQ(weak2.lock()->i, 4);
 }
 
+TEST(SafeSharedPtr, weakPtrLockPolicy)
+{
+    using SpinPtr = SafeSharedPtr<int,
+                                  Memory::RWSpinLock,
+                                  Memory::RWSpinLock::ReadHolder,
+                                  Memory::RWSpinLock::WriteHolder>;
+    using SpinWeak = SafeWeakPtr<int,
+                                 Memory::RWSpinLock,
+                                 Memory::RWSpinLock::ReadHolder,
+                                 Memory::RWSpinLock::WriteHolder>;
+    SpinPtr ptr(new int(5));
+    SpinWeak weak(ptr);
+    SpinPtr locked = weak.lock();
+    EXPECT_EQ(locked.mutex, ptr.mutex);
+    EXPECT_EQ(*locked, 5);
+
+    SpinWeak other;
+    other = weak;
+    other.swap(weak);
+    EXPECT_FALSE(weak.expired());
+    other.reset();
+    EXPECT_TRUE(other.expired());
+    EXPECT_FALSE(other.lock());
+}
+
+TEST(SafeSharedPtr, tryAccess)
+{
+    using namespace std::chrono;
+    SafeSharedPtr<int> ptr(new int(1));
+    {
+        auto&& writer = ptr.try_write();
+        ASSERT_TRUE(writer);
+        *writer = 2;
+        EXPECT_FALSE(ptr.try_read());
+        EXPECT_FALSE(ptr.try_write());
+        const auto start = steady_clock::now();
+        EXPECT_FALSE(ptr.try_read_for(milliseconds(20)));
+        EXPECT_GE(steady_clock::now() - start, milliseconds(20));
+        EXPECT_FALSE(ptr.try_write_until(steady_clock::now() + milliseconds(1)));
+    }
+    {
+        const auto& reader1 = ptr.try_read();
+        const auto& reader2 = ptr.try_read_for(milliseconds(1));
+        ASSERT_TRUE(reader1);
+        ASSERT_TRUE(reader2);
+        EXPECT_EQ(*reader1, 2);
+        EXPECT_FALSE(ptr.try_write());
+    }
+
+    std::thread holder;
+    {
+        auto writer = ptr.unique_lock();
+        holder = std::thread([&ptr] {
+            auto&& writer = ptr.try_write_for(seconds(10));
+            EXPECT_TRUE(writer);
+            *writer = 3;
+        });
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+    holder.join();
+    EXPECT_EQ(*ptr.try_read(), 3);
+
+    SafeSharedPtr<int> empty;
+    EXPECT_FALSE(empty.try_read());
+    EXPECT_FALSE(empty.try_write_for(milliseconds(1)));
+}
+
+TEST(SafeSharedPtr, tryAccessSpinLock)
+{
+    using namespace std::chrono;
+    using SpinPtr = SafeSharedPtr<int,
+                                  Memory::RWSpinLock,
+                                  Memory::RWSpinLock::ReadHolder,
+                                  Memory::RWSpinLock::WriteHolder>;
+    SpinPtr ptr(new int(1));
+    {
+        const auto& reader = ptr.try_read();
+        ASSERT_TRUE(reader);
+        EXPECT_TRUE(ptr.mutex->try_lock_shared_for(milliseconds(1)));
+        ptr.mutex->unlock_shared();
+        EXPECT_FALSE(ptr.mutex->try_lock_for(milliseconds(1)));
+        EXPECT_FALSE(ptr.try_write_for(milliseconds(1)));
+    }
+    {
+        auto&& writer = ptr.try_write_until(steady_clock::now() + milliseconds(1));
+        ASSERT_TRUE(writer);
+        EXPECT_FALSE(ptr.mutex->try_lock_shared_until(steady_clock::now() + milliseconds(1)));
+    }
+    EXPECT_EQ(ptr.mutex->bits(), 0);
+}
+
 struct Good : public Delivered, public Memory::EnableSafeSharedFromThis<Good>
 {
     Good(int x = 0) : Delivered(x) {}
@@ -546,3 +639,106 @@ TEST(SafeSharedPtr, EnableSafeSharedFromThis)
     EXPECT_EQ(ptr6.mutex.use_count(), 2);
     EXPECT_EQ(ptr6->i, 3);
 }
+
+
+struct Embedded : public Delivered, public Memory::EnableEmbeddedSafeSharedFromThis<Embedded>
+{
+    Embedded(int x = 0) : Delivered(x) {}
+};
+
+TEST(SafeSharedPtr, EnableEmbeddedSafeSharedFromThis)
+{
+    SafeSharedPtr<Embedded> ptr = Memory::make_shared<Embedded>(3);
+    // The lock lives in the object and shares its control block.
+    EXPECT_EQ(ptr.mutex.get(), &ptr.get()->__safeSharedMutex);
+    EXPECT_FALSE(ptr.mutex.owner_before(ptr.ptr));
+    EXPECT_FALSE(ptr.ptr.owner_before(ptr.mutex));
+    EXPECT_EQ(ptr.use_count(), 1);
+
+    SafeSharedPtr<Embedded> self = ptr->shared_from_this();
+    EXPECT_EQ(self.mutex.get(), ptr.mutex.get());
+    EXPECT_EQ(ptr.use_count(), 2);
+    const Embedded& constRef = *ptr.get();
+    auto constSelf = constRef.shared_from_this();
+    EXPECT_EQ(constSelf.mutex.get(), ptr.mutex.get());
+    EXPECT_EQ(constSelf->i, 3);
+    constSelf.reset();
+
+    SafeWeakPtr<Embedded> weak = self->weak_from_this();
+    self.reset();
+    EXPECT_EQ(weak.use_count(), 1);
+    EXPECT_EQ(weak.lock()->i, 3);
+
+    Embedded copy(*ptr.get());
+    EXPECT_NE(&copy.__safeSharedMutex, ptr.mutex.get());
+
+    SafeSharedPtr<Embedded> raw(new Embedded(4));
+    EXPECT_EQ(raw.mutex.get(), &raw.get()->__safeSharedMutex);
+    EXPECT_EQ(raw->i, 4);
+    ptr.reset();
+    EXPECT_TRUE(weak.expired());
+}
+
+namespace {
+int arenaBlocks = 0;
+
+/** Counts the blocks it has live, standing for an arena. */
+template<typename T>
+struct ArenaAllocator
+{
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        ++arenaBlocks;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        --arenaBlocks;
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+} // namespace
+
+struct ArenaGood : public Delivered, public Memory::EnableSafeSharedFromThis<ArenaGood>
+{
+    template<typename Alloc>
+    ArenaGood(std::allocator_arg_t, const Alloc& alloc, int x)
+        : Delivered(x),
+          Memory::EnableSafeSharedFromThis<ArenaGood>(std::allocator_arg, alloc)
+    {}
+};
+
+TEST(SafeSharedPtr, allocatorAwareLock)
+{
+    ArenaAllocator<int> alloc;
+    {
+        // Object and lock each take one block of the allocator.
+        auto ptr = Memory::allocate_shared<int>(alloc, 3);
+        EXPECT_EQ(arenaBlocks, 2);
+        EXPECT_EQ(*ptr, 3);
+
+        SafeSharedPtr<int> raw(new int(4), std::default_delete<int>(), alloc);
+        EXPECT_EQ(arenaBlocks, 4);
+        raw.reset(new int(5), std::default_delete<int>(), alloc);
+        EXPECT_EQ(arenaBlocks, 4);
+        EXPECT_EQ(*raw, 5);
+
+        auto good = Memory::allocate_shared<ArenaGood>(alloc, std::allocator_arg, alloc, 6);
+        EXPECT_EQ(arenaBlocks, 6);
+        EXPECT_EQ(good.mutex, good.get()->__safeSharedLock);
+        EXPECT_EQ(good->i, 6);
+    }
+    EXPECT_EQ(arenaBlocks, 0);
+}
@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <Utilities/MemorySafety/SeqLock.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::SeqLock;
+using Memory::SeqLocked;
+
+namespace {
+// Consistent when all fields derive from the same version.
+struct Snapshot
+{
+    uint64_t version;
+    double bid;
+    double ask;
+    uint32_t size;
+    char symbol[13];
+};
+
+Snapshot make(uint64_t version)
+{
+    Snapshot s = {};
+    s.version = version;
+    s.bid = double(version);
+    s.ask = double(version) + 0.5;
+    s.size = static_cast<uint32_t>(version * 3);
+    for (char& c : s.symbol) {
+        c = static_cast<char>('A' + version % 26);
+    }
+    return s;
+}
+
+bool consistent(const Snapshot& s)
+{
+    if (s.bid != double(s.version) || s.ask != double(s.version) + 0.5
+        || s.size != static_cast<uint32_t>(s.version * 3)) {
+        return false;
+    }
+    for (char c : s.symbol) {
+        if (c != static_cast<char>('A' + s.version % 26)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+TEST(SeqLock, sequence)
+{
+    SeqLock lock;
+    EXPECT_EQ(lock.read_begin(), 0u);
+    {
+        SeqLock::WriteHolder writer(lock);
+        EXPECT_EQ(lock.sequence(), 1u);
+        EXPECT_FALSE(lock.try_lock());
+        EXPECT_TRUE(lock.read_retry(0));
+    }
+    EXPECT_EQ(lock.sequence(), 2u);
+    EXPECT_TRUE(lock.read_retry(0));
+    EXPECT_FALSE(lock.read_retry(lock.read_begin()));
+
+    std::atomic<int> value(1);
+    int seen = 0;
+    lock.read([&]() { seen = value.load(std::memory_order_relaxed); });
+    EXPECT_EQ(seen, 1);
+}
+
+TEST(SeqLock, loadStore)
+{
+    SeqLocked<Snapshot> data(make(1));
+    EXPECT_TRUE(consistent(data.load()));
+    EXPECT_EQ(data.load().version, 1u);
+    data.store(make(2));
+    EXPECT_EQ(data.load().version, 2u);
+    EXPECT_EQ(data.sequence(), 2u);
+
+    const Snapshot after = data.update([](Snapshot& s) { s = make(s.version + 1); });
+    EXPECT_EQ(after.version, 3u);
+    Snapshot out = {};
+    EXPECT_TRUE(data.try_load(out));
+    EXPECT_EQ(out.version, 3u);
+    {
+        SeqLocked<Snapshot>::WriteHolder writer(data.lock());
+        EXPECT_FALSE(data.try_load(out));
+    }
+
+    SeqLocked<char> small;
+    EXPECT_EQ(small.load(), '\0');
+    small.store('x');
+    EXPECT_EQ(small.load(), 'x');
+}
+
+TEST(SeqLock, stressSingleWriter)
+{
+    enum { Readers = 8, Writes = 200000 };
+    SeqLocked<Snapshot> data(make(0));
+    std::atomic<bool> done(false);
+    std::atomic<long> torn(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < Readers; ++i) {
+        readers.emplace_back([&]() {
+            uint64_t last = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                const Snapshot s = data.load();
+                // Never torn, never older than a previous read.
+                if (!consistent(s) || s.version < last) {
+                    ++torn;
+                }
+                last = s.version;
+            }
+        });
+    }
+    for (uint64_t v = 1; v <= Writes; ++v) {
+        data.store(make(v));
+    }
+    done = true;
+    for (auto& t : readers) {
+        t.join();
+    }
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(data.load().version, uint64_t(Writes));
+}
+
+TEST(SeqLock, stressWriters)
+{
+    enum { Writers = 4, Readers = 4, Updates = 20000 };
+    SeqLocked<Snapshot> data(make(0));
+    std::atomic<int> writing(Writers);
+    std::atomic<long> torn(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < Writers; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < Updates; ++j) {
+                data.update([](Snapshot& s) { s = make(s.version + 1); });
+            }
+            --writing;
+        });
+    }
+    for (int i = 0; i < Readers; ++i) {
+        threads.emplace_back([&]() {
+            while (writing.load() != 0) {
+                Snapshot s;
+                if (data.try_load(s) && !consistent(s)) {
+                    ++torn;
+                }
+                if (!consistent(data.load())) {
+                    ++torn;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(data.load().version, uint64_t(Writers) * Updates);
+    EXPECT_EQ(data.sequence(), 2 * uint64_t(Writers) * Updates);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/StripedLockPolicy.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::SafeSharedPtr;
+using Memory::SafeWeakPtr;
+
+namespace {
+struct Node
+{
+    int value = 0;
+};
+struct Leaf
+{
+    int value = 0;
+};
+} // namespace
+
+UTILITIES_NAMESPACE_BEGIN
+namespace Memory {
+template<>
+struct SafeLockPolicy<Node, shared_mutex_t>
+    : StripedLockPolicy<shared_mutex_t, 8, Node>
+{};
+template<>
+struct SafeLockPolicy<Leaf, shared_mutex_t>
+    : StripedLockPolicy<shared_mutex_t>
+{};
+} // namespace Memory
+UTILITIES_NAMESPACE_END
+
+using NodeLocks = Memory::StripedLockPolicy<Memory::shared_mutex_t, 8, Node>;
+using GlobalLocks = Memory::StripedLockPolicy<Memory::shared_mutex_t>;
+
+TEST(StripedLockPolicy, sharesTableLocks)
+{
+    auto node = Memory::make_shared<Node>();
+    EXPECT_EQ(node.mutex.get(), &NodeLocks::lock_of(node.get()));
+    EXPECT_LT(NodeLocks::index_of(node.get()), 8u);
+    // The lock aliases the object's control block, nothing else is owned.
+    EXPECT_FALSE(node.mutex.owner_before(node.ptr));
+    EXPECT_FALSE(node.ptr.owner_before(node.mutex));
+    EXPECT_EQ(node.use_count(), 1);
+
+    SafeSharedPtr<Leaf> leaf(new Leaf);
+    EXPECT_EQ(leaf.mutex.get(), &GlobalLocks::lock_of(leaf.get()));
+    EXPECT_NE(static_cast<void*>(leaf.mutex.get()), static_cast<void*>(node.mutex.get()));
+
+    // Per-type tables are independent of the default per-object policy.
+    SafeSharedPtr<int> plain(new int(0));
+    EXPECT_TRUE(plain.mutex.owner_before(plain.ptr) || plain.ptr.owner_before(plain.mutex));
+
+    SafeSharedPtr<Node> empty;
+    EXPECT_TRUE(empty.mutex);
+    EXPECT_FALSE(empty);
+}
+
+TEST(StripedLockPolicy, lifetime)
+{
+    SafeWeakPtr<Node> weak;
+    {
+        auto node = Memory::make_shared<Node>();
+        node->value = 2;
+        weak = node;
+        SafeSharedPtr<Node> copy = weak.lock();
+        EXPECT_EQ(node.use_count(), 2);
+        EXPECT_EQ(copy->value, 2);
+    }
+    EXPECT_TRUE(weak.expired());
+    EXPECT_FALSE(weak.lock());
+}
+
+TEST(StripedLockPolicy, concurrentAccess)
+{
+    enum { Threads = 4, Objects = 32, Times = 2000 };
+    std::vector<SafeSharedPtr<Node>> nodes;
+    for (int i = 0; i < Objects; ++i) {
+        nodes.push_back(Memory::make_shared<Node>());
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) {
+        threads.emplace_back([&nodes]() {
+            for (int i = 0; i < Times; ++i) {
+                nodes[i % Objects]->value += 1;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    int total = 0;
+    for (auto& node : nodes) {
+        total += node->value;
+    }
+    EXPECT_EQ(total, Threads * Times);
+}
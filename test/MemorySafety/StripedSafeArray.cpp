@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#define private public
+#include <Utilities/MemorySafety/RWSpinLock.hpp>
+#include <Utilities/MemorySafety/StripedSafeArray.hpp>
+
+UTILITIES_USING_NAMESPACE;
+using Memory::RWSpinLock;
+using Memory::StripedSafeArray;
+
+TEST(StripedSafeArray, elements)
+{
+    StripedSafeArray<int> array(10, 4);
+    EXPECT_EQ(array.size(), 10u);
+    EXPECT_EQ(array.stripes(), 4u);
+    EXPECT_EQ(array.stripe_of(6), 2u);
+    array[3] = 7;
+    const StripedSafeArray<int>& view = array;
+    EXPECT_EQ(static_cast<const int&>(view[3]), 7);
+    EXPECT_EQ(array.get()[3], 7);
+
+    StripedSafeArray<int> copy = array;
+    copy[0] = 1;
+    EXPECT_EQ(array.get()[0], 1);
+}
+
+TEST(StripedSafeArray, stripesAreIndependent)
+{
+    StripedSafeArray<int, RWSpinLock> array(8, 4);
+    auto&& writer = array[1];
+    // Same stripe is held, the others are free.
+    EXPECT_FALSE(array.locks.get()[1].mutex.try_lock_shared());
+    EXPECT_TRUE(array.locks.get()[2].mutex.try_lock());
+    array.locks.get()[2].mutex.unlock();
+    writer = 3;
+}
+
+TEST(StripedSafeArray, lockRange)
+{
+    StripedSafeArray<int, RWSpinLock> array(16, 4);
+    RWSpinLock* locks[4];
+    for (int i = 0; i < 4; ++i) {
+        locks[i] = &array.locks.get()[i].mutex;
+    }
+    {
+        // Elements 3..4 live on stripes 3 and 0.
+        auto range = array.lock_range(3, 5);
+        EXPECT_EQ(range.size(), 2u);
+        range[0] = 1;
+        range.begin()[1] = 2;
+        EXPECT_FALSE(locks[3]->try_lock_shared());
+        EXPECT_FALSE(locks[0]->try_lock_shared());
+        EXPECT_TRUE(locks[1]->try_lock());
+        locks[1]->unlock();
+    }
+    EXPECT_EQ(locks[0]->bits(), 0);
+    EXPECT_EQ(locks[3]->bits(), 0);
+    {
+        const StripedSafeArray<int, RWSpinLock>& view = array;
+        auto all = view.lock_range(2, 16);
+        EXPECT_EQ(all[1] + all[2], 3);
+        for (auto* lock : locks) {
+            EXPECT_FALSE(lock->try_lock());
+            EXPECT_TRUE(lock->try_lock_shared());
+            lock->unlock_shared();
+        }
+    }
+    {
+        auto empty = array.lock_range(5, 5);
+        EXPECT_EQ(empty.size(), 0u);
+        EXPECT_TRUE(locks[1]->try_lock());
+        locks[1]->unlock();
+    }
+}
+
+TEST(StripedSafeArray, concurrentWriters)
+{
+    enum { Threads = 4, Size = 64, Rounds = 2000 };
+    StripedSafeArray<int> array(Size, 8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < Threads; ++t) {
+        threads.emplace_back([&array, t]() {
+            for (int r = 0; r < Rounds; ++r) {
+                const std::size_t first = (t * 7 + r) % (Size - 10);
+                {
+                    auto range = array.lock_range(first, first + 10);
+                    for (int& value : range) {
+                        ++value;
+                    }
+                }
+                auto&& single = array[(t + r) % Size];
+                ++static_cast<int&>(single);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    long total = 0;
+    for (int i = 0; i < Size; ++i) {
+        total += array.get()[i];
+    }
+    EXPECT_EQ(total, long(Threads) * Rounds * 11);
+}
+
+TEST(StripedSafeArray, noStripes)
+{
+    StripedSafeArray<int> empty;
+    EXPECT_EQ(empty.stripes(), 1u);
+    EXPECT_EQ(empty.lock_range(0, 0).size(), 0u);
+
+    StripedSafeArray<int> array(4, 0);
+    EXPECT_EQ(array.stripes(), 1u);
+    array[2] = 5;
+    EXPECT_EQ(array.lock_range(0, 4)[2], 5);
+}